@@ -4,10 +4,10 @@
 *        status bits SNZVC as described below:
 *
 *        S (Signed)  : Set if result is negative with overflow considered*.
-*        N (Negative): Set if result is negative, i.e. N = result[7].
+*        N (Negative): Set if result is negative, i.e. N = result[31].
 *        Z (Zero)    : Set if result is zero, i.e. Z = result == 0 ? 1 : 0.
 *        V (Overflow): Set if signed overflow occurs**.
-*        C (Carry)   : Set if result contains a carry bit, i.e. C = result[8]***.
+*        C (Carry)   : Set if result contains a carry bit, i.e. C = result[32]***.
 *
 *        * Signed flag is set if result is negative (N = 1) while
 *          overflow hasn't occured (V = 0) or result is positive (N = 0)
@@ -28,12 +28,12 @@
 *           a) During addition (+) if the operands A and B are of the
 *              same sign and the result is of the opposite sign, i.e.
 *
-*              V = (A[7] == B[7]) && (A[7] != result[7]) ? 1 : 0
+*              V = (A[31] == B[31]) && (A[31] != result[31]) ? 1 : 0
 *
 *           b) During subtraction (-) if the operands A and B are of the
 *              opposite sign and the result has the same sign as B, i.e.
 *
-*              V = (A[7] != B[7]) && (B[7] == result[7]) ? 1 : 0
+*              V = (A[31] != B[31]) && (B[31] == result[31]) ? 1 : 0
 *
 *        *** One instance when the carry bit is set is when unsigned overflow
 *            occurs, for instance when adding two numbers 255 and 1 into an
@@ -41,16 +41,60 @@
 *            since 1111 1111 + 1 = 1 0000 0000, which gets truncated to
 *            0000 0000. Since result[8] == 1, the carry bit is set.
 *            Unsigned overflow occurs for the timer circuits of microcontroller
-*            ATmega328P when counting up in Normal Mode.
+*            ATmega328P when counting up in Normal Mode. During subtraction
+*            the carry bit is set if a borrow occurs, i.e. if B > A.
+*
+*        All calculations are performed natively on 32-bit words. Carry and
+*        overflow are derived from the operands and the 32-bit result, since
+*        result[32] isn't available without promoting to 64 bits, i.e.
+*        C = result < A after addition and C = A < B after subtraction.
+*        Multiplication, division, shifts and rotations are described in
+*        alu.h.
 ********************************************************************************/
 #include "alu.h"
 
+/********************************************************************************
+* alu_divide: Returns the signed quotient of specified operands, rounded
+*             towards zero. Division by zero results in -1 and overflow
+*             (-2^31 / -1) in -2^31, since the host division is undefined
+*             in both cases.
+*
+*             - a: Dividend.
+*             - b: Divisor.
+********************************************************************************/
+uint32_t alu_divide(const uint32_t a,
+                    const uint32_t b)
+{
+   if (b == 0) return 0xFFFFFFFFUL;
+   if (a == 0x80000000UL && b == 0xFFFFFFFFUL) return a;
+   return (uint32_t)((int32_t)(a) / (int32_t)(b));
+}
+
+/********************************************************************************
+* alu_modulo: Returns the signed remainder of specified operands, with the
+*             sign of the dividend. Division by zero results in the dividend
+*             and overflow (-2^31 % -1) in 0.
+*
+*             - a: Dividend.
+*             - b: Divisor.
+********************************************************************************/
+uint32_t alu_modulo(const uint32_t a,
+                    const uint32_t b)
+{
+   if (b == 0) return a;
+   if (b == 0xFFFFFFFFUL) return 0;
+   return (uint32_t)((int32_t)(a) % (int32_t)(b));
+}
+
 /********************************************************************************
 * alu: Performs calculation with specified operands and returns the result.
 *      The status flags SNZVC of the referenced status register are updated
-*      in accordance with the result.
+*      in accordance with the result. Generic entry point for operations
+*      only known at runtime, otherwise the specialized kernels alu_add,
+*      alu_sub and alu_other should be called directly.
 *
-*      - operation: The operation to perform (OR, AND, XOR, ADD or SUB).
+*      - operation: The operation to perform (OR, AND, XOR, ADD, SUB, MUL,
+*                   MULH, DIV, MOD, LSLV, LSRV, ASR, ROL or ROR).
 *      - a        : First operand.
 *      - b        : Second operand.
 *      - sr       : Reference to status register containing SNZVC flags.
@@ -60,52 +104,19 @@ uint32_t alu(const uint32_t operation,
             const uint32_t b,
             uint8_t* sr)
 {
-   uint64_t result = 0x00;
-   *sr &= ~((1 << S) | (1 << N) | (1 << Z) | (1 << V) | (1 << C));
-
    switch (operation)
    {
-      case OR:
-      {
-         result = a | b; 
-         break;
-      }
-      case AND:
-      {
-         result = a & b;
-         break;
-      }
-      case XOR:
-      {
-         result = a ^ b;
-         break;
-      }
       case ADD:
       {
-         result = a + b;
-
-         if ((read(a, 31) == read(b, 31)) && (read(result, 31) != read(a, 31)))
-         {
-            set(*sr, V);
-         }
-         break;
+         return alu_add(a, b, sr);
       }
       case SUB:
       {
-         result = a + (256 - b); /* 256 - b is the 2-complement representation of B. */
-
-         if ((read(a, 7) == read((256 - b), 7)) && (read(result, 7) != read(a, 7)))
-         {
-            set(*sr, V);
-         }
-         break;
+         return alu_sub(a, b, sr);
+      }
+      default:
+      {
+         return alu_other(operation, a, b, sr);
       }
    }
-
-   if (read(result, 32) == 1)         set(*sr, N);
-   if ((uint32_t)(result) == 0)       set(*sr, Z);
-   if (read(result, 32) == 1)         set(*sr, C);
-   if (read(*sr, N) != read(*sr, V)) set(*sr, S);
-
-   return (uint32_t)(result);
 }
\ No newline at end of file
@@ -4,10 +4,10 @@
 *        status bits SNZVC as described below:
 *
 *        S (Signed)  : Set if result is negative with overflow considered*.
-*        N (Negative): Set if result is negative, i.e. N = result[7].
+*        N (Negative): Set if result is negative, i.e. N = result[31].
 *        Z (Zero)    : Set if result is zero, i.e. Z = result == 0 ? 1 : 0.
 *        V (Overflow): Set if signed overflow occurs**.
-*        C (Carry)   : Set if result contains a carry bit, i.e. C = result[8]***.
+*        C (Carry)   : Set if result contains a carry bit, i.e. C = result[32]***.
 *
 *        * Signed flag is set if result is negative (N = 1) while
 *          overflow hasn't occured (V = 0) or result is positive (N = 0)
@@ -28,12 +28,12 @@
 *           a) During addition (+) if the operands A and B are of the
 *              same sign and the result is of the opposite sign, i.e.
 *
-*              V = (A[7] == B[7]) && (A[7] != result[7]) ? 1 : 0
+*              V = (A[31] == B[31]) && (A[31] != result[31]) ? 1 : 0
 *
 *           b) During subtraction (-) if the operands A and B are of the
 *              opposite sign and the result has the same sign as B, i.e.
 *
-*              V = (A[7] != B[7]) && (B[7] == result[7]) ? 1 : 0
+*              V = (A[31] != B[31]) && (B[31] == result[31]) ? 1 : 0
 *
 *        *** One instance when the carry bit is set is when unsigned overflow
 *            occurs, for instance when adding two numbers 255 and 1 into an
@@ -41,7 +41,29 @@
 *            since 1111 1111 + 1 = 1 0000 0000, which gets truncated to
 *            0000 0000. Since result[8] == 1, the carry bit is set.
 *            Unsigned overflow occurs for the timer circuits of microcontroller
-*            ATmega328P when counting up in Normal Mode.
+*            ATmega328P when counting up in Normal Mode. During subtraction
+*            the carry bit is set if a borrow occurs, i.e. if B > A.
+*
+*        All calculations are performed natively on 32-bit words. Carry and
+*        overflow are derived from the operands and the 32-bit result, since
+*        result[32] isn't available without promoting to 64 bits, i.e.
+*        C = result < A after addition and C = A < B after subtraction.
+*
+*        Multiplication, division, shifts and rotations update N, Z and S as
+*        above, while V and C are updated as follows:
+*
+*        MUL : Low word of the product. C is set if the unsigned product
+*              doesn't fit in 32 bits and V if the signed product doesn't.
+*        MULH: High word of the signed 64-bit product. V and C are cleared.
+*        DIV : Signed quotient, rounded towards zero. V is set on division by
+*              zero, which results in -1, and on overflow (-2^31 / -1), which
+*              results in -2^31. C is cleared.
+*        MOD : Signed remainder, with the sign of the dividend. V is set on
+*              division by zero, which results in the dividend. C is cleared.
+*        LSLV, LSRV, ASR, ROL, ROR: The first operand shifted or rotated by
+*              the lowest 5 bits of the second. C is set to the last bit
+*              shifted out (or rotated around), cleared for a count of 0.
+*              V is cleared.
 ********************************************************************************/
 #ifndef ALU_H_
 #define ALU_H_
@@ -49,12 +71,39 @@
 /* Include directives: */
 #include "cpu.h"
 
+/* Macro definitions: */
+#define ALU_FLAGS ((1 << S) | (1 << N) | (1 << Z) | (1 << V) | (1 << C)) /* SNZVC flags. */
+
+/********************************************************************************
+* alu_divide: Returns the signed quotient of specified operands, rounded
+*             towards zero, with division by zero and overflow resolved as
+*             described above.
+*
+*             - a: Dividend.
+*             - b: Divisor.
+********************************************************************************/
+uint32_t alu_divide(const uint32_t a,
+                    const uint32_t b);
+
+/********************************************************************************
+* alu_modulo: Returns the signed remainder of specified operands, with
+*             division by zero resolved as described above.
+*
+*             - a: Dividend.
+*             - b: Divisor.
+********************************************************************************/
+uint32_t alu_modulo(const uint32_t a,
+                    const uint32_t b);
+
 /********************************************************************************
 * alu: Performs calculation with specified operands and returns the result.
 *      The status flags SNZVC of the referenced status register are updated
-*      in accordance with the result.
+*      in accordance with the result. Generic entry point for operations
+*      only known at runtime, otherwise the specialized kernels alu_add,
+*      alu_sub and alu_other should be called directly.
 *
-*      - operation: The operation to perform (OR, AND, XOR, ADD or SUB).
+*      - operation: The operation to perform (OR, AND, XOR, ADD, SUB or one
+*                   of the operations listed above).
 *      - a        : First operand.
 *      - b        : Second operand.
 *      - sr       : Reference to status register containing SNZVC flags.
@@ -64,4 +113,148 @@ uint32_t alu(const uint32_t operation,
             const uint32_t b,
             uint8_t* sr);
 
+/********************************************************************************
+* alu_flags: Returns the status flags SNZVC for a calculation with specified
+*            operands and result. The flags are placed at their positions in
+*            the status register, all other bits are cleared. Since the
+*            function is inlined, the flag calculation is specialized at
+*            compile time when the operation is a constant.
+*
+*            - operation: The performed operation (OR, AND, XOR, ADD, SUB or
+*                         one of the operations listed above).
+*            - a        : First operand.
+*            - b        : Second operand.
+*            - result   : Result of the calculation.
+********************************************************************************/
+static inline uint8_t alu_flags(const uint32_t operation,
+                                const uint32_t a,
+                                const uint32_t b,
+                                const uint32_t result)
+{
+   uint8_t sr = 0x00;
+
+   if (operation == ADD)
+   {
+      if (result < a) set(sr, C);
+      if ((a ^ result) & (b ^ result) & 0x80000000UL) set(sr, V);
+   }
+   else if (operation == SUB)
+   {
+      if (a < b) set(sr, C);
+      if ((a ^ b) & (a ^ result) & 0x80000000UL) set(sr, V);
+   }
+   else if (operation == MUL)
+   {
+      if (((uint64_t)(a) * b) >> 32) set(sr, C);
+      if ((int64_t)((int32_t)(a)) * (int32_t)(b) != (int32_t)(result)) set(sr, V);
+   }
+   else if (operation == DIV || operation == MOD)
+   {
+      if (b == 0 || (operation == DIV && a == 0x80000000UL && b == 0xFFFFFFFFUL)) set(sr, V);
+   }
+   else if (operation >= LSLV && operation <= ROR && (b & 31))
+   {
+      const uint8_t count = b & 31;
+      if (operation == LSLV && ((a >> (32 - count)) & 1)) set(sr, C);
+      if ((operation == LSRV || operation == ASR) && ((a >> (count - 1)) & 1)) set(sr, C);
+      if (operation == ROL && (result & 1)) set(sr, C);
+      if (operation == ROR && (result & 0x80000000UL)) set(sr, C);
+   }
+
+   if (result & 0x80000000UL) set(sr, N);
+   if (result == 0)           set(sr, Z);
+   if (read(sr, N) != read(sr, V)) set(sr, S);
+   return sr;
+}
+
+/********************************************************************************
+* alu_calculate: Performs calculation with specified operands and returns the
+*                result without updating any status flags. Used together with
+*                alu_flags when the status flags are evaluated lazily, i.e.
+*                only when they are actually needed.
+*
+*                - operation: The operation to perform (OR, AND, XOR, ADD, SUB
+*                             or one of the operations listed above).
+*                - a        : First operand.
+*                - b        : Second operand.
+********************************************************************************/
+static inline uint32_t alu_calculate(const uint32_t operation,
+                                     const uint32_t a,
+                                     const uint32_t b)
+{
+   if (operation == OR)       return a | b;
+   else if (operation == AND) return a & b;
+   else if (operation == XOR) return a ^ b;
+   else if (operation == ADD) return a + b;
+   else if (operation == SUB) return a - b;
+   else if (operation == MUL) return a * b;
+   else if (operation == MULH) return (uint32_t)((uint64_t)((int64_t)((int32_t)(a)) * (int32_t)(b)) >> 32);
+   else if (operation == DIV) return alu_divide(a, b);
+   else if (operation == MOD) return alu_modulo(a, b);
+   else if (operation == LSLV) return a << (b & 31);
+   else if (operation == LSRV) return a >> (b & 31);
+   else if (operation == ASR) return (a >> (b & 31)) | (a & 0x80000000UL ? ~(0xFFFFFFFFUL >> (b & 31)) : 0x00);
+   else if (operation == ROL) return (a << (b & 31)) | (a >> ((32 - (b & 31)) & 31));
+   else if (operation == ROR) return (a >> (b & 31)) | (a << ((32 - (b & 31)) & 31));
+   else return 0x00;
+}
+
+/********************************************************************************
+* alu_add: Returns the sum of specified operands and updates the status flags
+*          SNZVC of the referenced status register.
+*
+*          - a : First operand.
+*          - b : Second operand.
+*          - sr: Reference to status register containing SNZVC flags.
+********************************************************************************/
+static inline uint32_t alu_add(const uint32_t a,
+                               const uint32_t b,
+                               uint8_t* sr)
+{
+   const uint32_t result = a + b;
+   *sr = (*sr & ~ALU_FLAGS) | alu_flags(ADD, a, b, result);
+   return result;
+}
+
+/********************************************************************************
+* alu_sub: Returns the difference of specified operands and updates the status
+*          flags SNZVC of the referenced status register.
+*
+*          - a : First operand.
+*          - b : Second operand (subtrahend).
+*          - sr: Reference to status register containing SNZVC flags.
+********************************************************************************/
+static inline uint32_t alu_sub(const uint32_t a,
+                               const uint32_t b,
+                               uint8_t* sr)
+{
+   const uint32_t result = a - b;
+   *sr = (*sr & ~ALU_FLAGS) | alu_flags(SUB, a, b, result);
+   return result;
+}
+
+/********************************************************************************
+* alu_other: Performs any operation other than addition and subtraction, i.e.
+*            a bitwise operation, multiplication, division, shift or rotation,
+*            with specified operands, returns the result and updates the
+*            status flags SNZVC of the referenced status register. The V and
+*            C flags are always cleared by bitwise operations, otherwise they
+*            are updated as described above.
+*
+*            - operation: The operation to perform (OR, AND, XOR or one of the
+*                         operations listed above).
+*            - a        : First operand.
+*            - b        : Second operand.
+*            - sr       : Reference to status register containing SNZVC flags.
+********************************************************************************/
+static inline uint32_t alu_other(const uint32_t operation,
+                                 const uint32_t a,
+                                 const uint32_t b,
+                                 uint8_t* sr)
+{
+   const uint32_t result = alu_calculate(operation, a, b);
+   *sr = (*sr & ~ALU_FLAGS) | alu_flags(operation, a, b, result);
+   return result;
+}
+
 #endif /* ALU_H_ */
\ No newline at end of file
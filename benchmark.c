@@ -0,0 +1,490 @@
+/********************************************************************************
+* benchmark.c: Contains function definitions and workloads for measuring the
+*              instruction throughput of the CPU.
+********************************************************************************/
+#include "benchmark.h"
+
+/* Macro definitions: */
+#define LED1 PORTA8 /* LED 1 connected to pin 8 (PORTB0), toggled in the PCINT storm. */
+
+#define KERNEL_LOOP   4  /* Start address of the repeated instructions in a kernel. */
+#define KERNEL_REPEAT 16 /* Number of repeated instructions in a kernel. */
+#define KERNEL_JMP    (KERNEL_LOOP + KERNEL_REPEAT) /* Address of the jump back. */
+#define KERNEL_RET    (KERNEL_JMP + 1)              /* Address of the subroutine for CALL. */
+
+/********************************************************************************
+* workload: Canonical workload, stored in flash.
+********************************************************************************/
+struct workload
+{
+	const char* name;        /* Name of the workload. */
+	const uint32_t* program; /* The program in machine code (in flash). */
+	uint8_t size;            /* Number of words in the program. */
+};
+
+/********************************************************************************
+* kernel: Per-instruction kernel, where the first and second instruction are
+*         repeated alternately, or in turn with the third instruction if
+*         any. Jump and branch addresses are filled in when the kernel is
+*         loaded.
+********************************************************************************/
+struct kernel
+{
+	const char* name;     /* Name of the instruction(s). */
+	uint8_t first[3];     /* OP code and operands of the first instruction. */
+	uint8_t second[3];    /* OP code and operands of the second instruction. */
+	uint8_t third[3];     /* OP code and operands of the third instruction, NOP if none. */
+};
+
+/* Static functions: */
+static int load(const uint32_t* program,
+                const uint8_t size,
+                const bool in_flash);
+static void run(const char* name,
+                const uint32_t instructions,
+                struct benchmark_result* result);
+static inline uint32_t kernel_word(const uint8_t* instruction,
+                                   const uint16_t address);
+
+/********************************************************************************
+* alu_loop: Tight loop of arithmetic and logic instructions.
+********************************************************************************/
+static const uint32_t alu_loop[] PROGMEM =
+{
+	[0]  = ASSEMBLE(LDI, R16, 1),
+	[1]  = ASSEMBLE(LDI, R17, 3),
+	[2]  = ASSEMBLE(LDI, R20, 100),
+	[3]  = ASSEMBLE(ADD, R16, R17),
+	[4]  = ASSEMBLE(XOR, R18, R16),
+	[5]  = ASSEMBLE(LSL, R18, 0x00),
+	[6]  = ASSEMBLE(ADDI, R17, 7),
+	[7]  = ASSEMBLE(AND, R19, R16),
+	[8]  = ASSEMBLE(OR, R19, R17),
+	[9]  = ASSEMBLE(SUB, R16, R19),
+	[10] = ASSEMBLE(DEC, R20, 0x00),
+	[11] = ASSEMBLE(BRNE, 3, 0x00),
+	[12] = ASSEMBLE(JMP, 2, 0x00)
+};
+
+/********************************************************************************
+* branch_chain: Compare chain selecting one of four paths each iteration.
+********************************************************************************/
+static const uint32_t branch_chain[] PROGMEM =
+{
+	[0]  = ASSEMBLE(LDI, R16, 0),
+	[1]  = ASSEMBLE(INC, R16, 0x00),
+	[2]  = ASSEMBLE(MOV, R17, R16),
+	[3]  = ASSEMBLE(ANDI, R17, 7),
+	[4]  = ASSEMBLE(CPI, R17, 2),
+	[5]  = ASSEMBLE(BRLT, 12, 0x00),
+	[6]  = ASSEMBLE(CPI, R17, 4),
+	[7]  = ASSEMBLE(BREQ, 14, 0x00),
+	[8]  = ASSEMBLE(CPI, R17, 6),
+	[9]  = ASSEMBLE(BRGE, 16, 0x00),
+	[10] = ASSEMBLE(INC, R18, 0x00),
+	[11] = ASSEMBLE(JMP, 1, 0x00),
+	[12] = ASSEMBLE(INC, R19, 0x00),
+	[13] = ASSEMBLE(JMP, 1, 0x00),
+	[14] = ASSEMBLE(INC, R20, 0x00),
+	[15] = ASSEMBLE(JMP, 1, 0x00),
+	[16] = ASSEMBLE(INC, R21, 0x00),
+	[17] = ASSEMBLE(JMP, 1, 0x00)
+};
+
+/********************************************************************************
+* call_recursion: Recursive subroutine calls 16 levels deep on the stack.
+********************************************************************************/
+static const uint32_t call_recursion[] PROGMEM =
+{
+	[0] = ASSEMBLE(LDI, R16, 16),
+	[1] = ASSEMBLE(CALL, 3, 0x00),
+	[2] = ASSEMBLE(JMP, 0, 0x00),
+	[3] = ASSEMBLE(CPI, R16, 0),
+	[4] = ASSEMBLE(BREQ, 8, 0x00),
+	[5] = ASSEMBLE(DEC, R16, 0x00),
+	[6] = ASSEMBLE(CALL, 3, 0x00),
+	[7] = ASSEMBLE(INC, R16, 0x00),
+	[8] = ASSEMBLE(RET, 0x00, 0x00)
+};
+
+/********************************************************************************
+* memory_sweep: Writes and reads back data memory from address 64 and up.
+********************************************************************************/
+static const uint32_t memory_sweep[] PROGMEM =
+{
+	[0] = ASSEMBLE(LDI, R27, 0),
+	[1] = ASSEMBLE(LDI, R26, 64),
+	[2] = ASSEMBLE(ST, R26, R16),
+	[3] = ASSEMBLE(LD, R17, R26),
+	[4] = ASSEMBLE(ADD, R16, R17),
+	[5] = ASSEMBLE(INC, R16, 0x00),
+	[6] = ASSEMBLE(INC, R26, 0x00),
+	[7] = ASSEMBLE(CPI, R26, DATA_MEMORY_ADDRESS_WIDTH),
+	[8] = ASSEMBLE(BRLT, 2, 0x00),
+	[9] = ASSEMBLE(JMP, 1, 0x00)
+};
+
+/********************************************************************************
+* pcint_storm: Toggles LED1 continuously with pin change interrupts enabled
+*              for the same pin, so that every toggle generates an interrupt.
+********************************************************************************/
+static const uint32_t pcint_storm[] PROGMEM =
+{
+	[0]  = ASSEMBLE(JMP, 4, 0x00),
+	[1]  = ASSEMBLE(NOP, 0x00, 0x00),
+	[2]  = ASSEMBLE(JMP, 13, 0x00),
+	[3]  = ASSEMBLE(NOP, 0x00, 0x00),
+
+	[4]  = ASSEMBLE(LDI, R16, (1 << LED1)),
+	[5]  = ASSEMBLE(OUT, DDRA, R16),
+	[6]  = ASSEMBLE(OUT, PCMSKA, R16),
+	[7]  = ASSEMBLE(LDI, R24, (1 << PCIEA)),
+	[8]  = ASSEMBLE(OUT, ICR, R24),
+	[9]  = ASSEMBLE(SEI, 0x00, 0x00),
+	[10] = ASSEMBLE(OUT, PINA, R16),
+	[11] = ASSEMBLE(INC, R17, 0x00),
+	[12] = ASSEMBLE(JMP, 10, 0x00),
+
+	[13] = ASSEMBLE(IN, R18, PINA),
+	[14] = ASSEMBLE(INC, R19, 0x00),
+	[15] = ASSEMBLE(RETI, 0x00, 0x00)
+};
+
+/********************************************************************************
+* idle_loop: Starts the timer with interrupts disabled and sleeps, so that the
+*            CPU sleeps for the rest of the run, while the idle cycles are
+*            skipped from one timer event to the next.
+********************************************************************************/
+static const uint32_t idle_loop[] PROGMEM =
+{
+	[0] = ASSEMBLE(LDI, R16, (1 << CS0)),
+	[1] = ASSEMBLE(OUT, TCCR, R16),
+	[2] = ASSEMBLE(SLEEP, 0x00, 0x00),
+	[3] = ASSEMBLE(JMP, 2, 0x00)
+};
+
+/* Static variables: */
+static const struct workload workloads[] =
+{
+	{ "alu_loop",       alu_loop,       sizeof(alu_loop) / sizeof(alu_loop[0]) },
+	{ "branch_chain",   branch_chain,   sizeof(branch_chain) / sizeof(branch_chain[0]) },
+	{ "call_recursion", call_recursion, sizeof(call_recursion) / sizeof(call_recursion[0]) },
+	{ "memory_sweep",   memory_sweep,   sizeof(memory_sweep) / sizeof(memory_sweep[0]) },
+	{ "pcint_storm",    pcint_storm,    sizeof(pcint_storm) / sizeof(pcint_storm[0]) }
+};
+
+static const struct kernel kernels[] =
+{
+	{ "NOP",      { NOP, 0x00, 0x00 },  { NOP, 0x00, 0x00 } },
+	{ "LDI",      { LDI, R18, 5 },      { LDI, R18, 5 } },
+	{ "MOV",      { MOV, R18, R16 },    { MOV, R18, R16 } },
+	{ "OUT",      { OUT, 0x10, R16 },   { OUT, 0x10, R16 } },
+	{ "IN",       { IN, R18, PINA },    { IN, R18, PINA } },
+	{ "STS",      { STS, 64, R16 },     { STS, 64, R16 } },
+	{ "LDS",      { LDS, R18, 64 },     { LDS, R18, 64 } },
+	{ "CLR",      { CLR, R18, 0x00 },   { CLR, R18, 0x00 } },
+	{ "ORI",      { ORI, R18, 3 },      { ORI, R18, 3 } },
+	{ "ANDI",     { ANDI, R18, 3 },     { ANDI, R18, 3 } },
+	{ "XORI",     { XORI, R18, 3 },     { XORI, R18, 3 } },
+	{ "OR",       { OR, R18, R16 },     { OR, R18, R16 } },
+	{ "AND",      { AND, R18, R16 },    { AND, R18, R16 } },
+	{ "XOR",      { XOR, R18, R16 },    { XOR, R18, R16 } },
+	{ "ADDI",     { ADDI, R18, 3 },     { ADDI, R18, 3 } },
+	{ "SUBI",     { SUBI, R18, 3 },     { SUBI, R18, 3 } },
+	{ "ADD",      { ADD, R18, R16 },    { ADD, R18, R16 } },
+	{ "SUB",      { SUB, R18, R16 },    { SUB, R18, R16 } },
+	{ "INC",      { INC, R18, 0x00 },   { INC, R18, 0x00 } },
+	{ "DEC",      { DEC, R18, 0x00 },   { DEC, R18, 0x00 } },
+	{ "CPI",      { CPI, R16, 3 },      { CPI, R16, 3 } },
+	{ "CP",       { CP, R16, R17 },     { CP, R16, R17 } },
+	{ "JMP",      { JMP, 0x00, 0x00 },  { JMP, 0x00, 0x00 } },
+	{ "BREQ",     { BREQ, 0x00, 0x00 }, { BREQ, 0x00, 0x00 } },
+	{ "BRNE",     { BRNE, 0x00, 0x00 }, { BRNE, 0x00, 0x00 } },
+	{ "BRGE",     { BRGE, 0x00, 0x00 }, { BRGE, 0x00, 0x00 } },
+	{ "BRGT",     { BRGT, 0x00, 0x00 }, { BRGT, 0x00, 0x00 } },
+	{ "BRLE",     { BRLE, 0x00, 0x00 }, { BRLE, 0x00, 0x00 } },
+	{ "BRLT",     { BRLT, 0x00, 0x00 }, { BRLT, 0x00, 0x00 } },
+	{ "CALL/RET", { CALL, 0x00, 0x00 }, { CALL, 0x00, 0x00 } },
+	{ "PUSH/POP", { PUSH, R16, 0x00 },  { POP, R18, 0x00 } },
+	{ "LSL",      { LSL, R18, 0x00 },   { LSL, R18, 0x00 } },
+	{ "LSR",      { LSR, R18, 0x00 },   { LSR, R18, 0x00 } },
+	{ "SEI",      { SEI, 0x00, 0x00 },  { SEI, 0x00, 0x00 } },
+	{ "CLI",      { CLI, 0x00, 0x00 },  { CLI, 0x00, 0x00 } },
+	{ "STIO",     { STIO, R26, R16 },   { STIO, R26, R16 } },
+	{ "LDIO",     { LDIO, R18, R26 },   { LDIO, R18, R26 } },
+	{ "ST",       { ST, R26, R16 },     { ST, R26, R16 } },
+	{ "LD",       { LD, R18, R26 },     { LD, R18, R26 } },
+	{ "LDI/MEMCPY", { LDI, R20, 96 },   { LDI, R21, 8 },      { MEMCPY, R20, R26 } },
+	{ "LDI/MEMSET", { LDI, R20, 96 },   { LDI, R21, 8 },      { MEMSET, R20, R16 } },
+	{ "MUL",      { MUL, R18, R17 },    { MUL, R18, R17 } },
+	{ "MULH",     { MULH, R18, R17 },   { MULH, R18, R17 } },
+	{ "DIV",      { DIV, R18, R17 },    { DIV, R18, R17 } },
+	{ "MOD",      { MOD, R18, R17 },    { MOD, R18, R17 } },
+	{ "LSLV",     { LSLV, R18, R16 },   { LSLV, R18, R16 } },
+	{ "LSRV",     { LSRV, R18, R16 },   { LSRV, R18, R16 } },
+	{ "ASR",      { ASR, R18, R16 },    { ASR, R18, R16 } },
+	{ "ROL",      { ROL, R18, R16 },    { ROL, R18, R16 } },
+	{ "ROR",      { ROR, R18, R16 },    { ROR, R18, R16 } }
+};
+
+/********************************************************************************
+* benchmark_workload_count: Returns the number of canonical workloads.
+********************************************************************************/
+uint8_t benchmark_workload_count(void)
+{
+	return sizeof(workloads) / sizeof(workloads[0]);
+}
+
+/********************************************************************************
+* benchmark_run_workload: Loads specified workload into program memory and runs
+*                         it for specified number of instructions after a reset
+*                         of the control unit. The value 0 is returned after a
+*                         successful run. Otherwise if the workload doesn't
+*                         exist or program memory can't be written (when the
+*                         program is read directly from flash), error code 1
+*                         is returned.
+*
+*                         - index       : Index of the workload.
+*                         - instructions: Number of instructions to run.
+*                         - result      : Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_workload(const uint8_t index,
+                           const uint32_t instructions,
+                           struct benchmark_result* result)
+{
+	if (index >= benchmark_workload_count()) return 1;
+
+	control_unit_reset();
+	if (load(workloads[index].program, workloads[index].size, true)) return 1;
+
+	run(workloads[index].name, instructions, result);
+	return 0;
+}
+
+/********************************************************************************
+* benchmark_opcode_count: Returns the number of per-instruction kernels.
+********************************************************************************/
+uint8_t benchmark_opcode_count(void)
+{
+	return sizeof(kernels) / sizeof(kernels[0]);
+}
+
+/********************************************************************************
+* benchmark_run_opcode: Loads the kernel of specified instruction into program
+*                       memory and runs it for specified number of instructions
+*                       after a reset of the control unit. There is one kernel
+*                       per instruction, from NOP to the multiply, divide and
+*                       barrel shift instructions, except RETI and SLEEP, the
+*                       latter measured by benchmark_run_idle instead. The
+*                       kernel repeats the instruction 16 times followed by a
+*                       jump, except for CALL and PUSH, which are paired with
+*                       RET and POP, and MEMCPY and MEMSET, which each follow
+*                       two LDI that set up the destination and the length of
+*                       8 words moved by every block instruction. The value 0
+*                       is returned after a successful run. Otherwise error
+*                       code 1 is returned, see benchmark_run_workload.
+*
+*                       - index       : Index of the kernel.
+*                       - instructions: Number of instructions to run.
+*                       - result      : Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_opcode(const uint8_t index,
+                         const uint32_t instructions,
+                         struct benchmark_result* result)
+{
+	uint32_t program[KERNEL_RET + 1];
+
+	if (index >= benchmark_opcode_count()) return 1;
+
+	program[0] = ASSEMBLE(LDI, R26, 64);
+	program[1] = ASSEMBLE(LDI, R27, 0);
+	program[2] = ASSEMBLE(LDI, R16, 1);
+	program[3] = ASSEMBLE(LDI, R17, 3);
+
+	for (uint16_t i = KERNEL_LOOP; i < KERNEL_JMP; ++i)
+	{
+		const uint8_t* sequence[3] = { kernels[index].first, kernels[index].second, kernels[index].third };
+		const uint8_t count = kernels[index].third[0] == NOP ? 2 : 3;
+		program[i] = kernel_word(sequence[(i - KERNEL_LOOP) % count], i);
+	}
+
+	program[KERNEL_JMP] = ASSEMBLE(JMP, KERNEL_LOOP, 0x00);
+	program[KERNEL_RET] = ASSEMBLE(RET, 0x00, 0x00);
+
+	control_unit_reset();
+	if (load(program, KERNEL_RET + 1, false)) return 1;
+
+	run(kernels[index].name, instructions, result);
+	return 0;
+}
+
+/********************************************************************************
+* benchmark_run_idle: Loads a program that puts the CPU to sleep with the timer
+*                     running into program memory and runs it for specified
+*                     number of cycles after a reset of the control unit. The
+*                     cycles are skipped rather than executed, hence the
+*                     result holds the number of skipped idle cycles in place
+*                     of the instructions. The value 0 is returned after a
+*                     successful run. Otherwise error code 1 is returned,
+*                     see benchmark_run_workload.
+*
+*                     - cycles: Number of cycles to run.
+*                     - result: Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_idle(const uint32_t cycles,
+                       struct benchmark_result* result)
+{
+	control_unit_reset();
+	if (load(idle_loop, sizeof(idle_loop) / sizeof(idle_loop[0]), true)) return 1;
+
+	run("SLEEP", cycles, result);
+	return 0;
+}
+
+/********************************************************************************
+* benchmark_print: Prints the result of a benchmark run as the name, number of
+*                  instructions, instructions per second and clock ticks per
+*                  instruction (CPI when the clock counts CPU cycles). The
+*                  rate is limited to UINT32_MAX, since printf on the AVR
+*                  can't print wider integers.
+*
+*                  - result: Reference to the result to print.
+********************************************************************************/
+void benchmark_print(const struct benchmark_result* result)
+{
+	const uint64_t ticks = result->ticks ? result->ticks : 1;
+	const uint64_t rate = (uint64_t)(result->instructions) * benchmark_clock_frequency() / ticks;
+	const uint32_t ips = rate > UINT32_MAX ? UINT32_MAX : (uint32_t)(rate);
+	const uint32_t cpi = result->instructions ? (uint32_t)(result->ticks * 100 / result->instructions) : 0;
+
+	printf("%-16s %10lu %12lu %8lu.%02lu\n", result->name, (unsigned long)(result->instructions),
+	       (unsigned long)(ips), (unsigned long)(cpi / 100), (unsigned long)(cpi % 100));
+	return;
+}
+
+/********************************************************************************
+* benchmark_print_idle: Prints the result of benchmark_run_idle as the name,
+*                       number of skipped idle cycles and the clock ticks
+*                       spent skipping them. No rate is printed, since
+*                       skipping costs time per timer event rather than per
+*                       cycle.
+*
+*                       - result: Reference to the result to print.
+********************************************************************************/
+void benchmark_print_idle(const struct benchmark_result* result)
+{
+	printf("%-16s %10lu %12lu\n", result->name, (unsigned long)(result->instructions),
+	       (unsigned long)(result->ticks));
+	return;
+}
+
+/********************************************************************************
+* benchmark_run_all: Runs and prints all workloads followed by all
+*                    per-instruction kernels and the idle run, then restores
+*                    the ordinary program and resets the control unit. The
+*                    value 0 is returned after successful runs, otherwise
+*                    error code 1.
+*
+*                    - instructions: Number of instructions run per benchmark.
+********************************************************************************/
+int benchmark_run_all(const uint32_t instructions)
+{
+	struct benchmark_result result;
+	int status = 0;
+
+	benchmark_clock_init();
+	printf("%-16s %10s %12s %11s\n", "workload", "instr", "instr/s", "ticks/instr");
+
+	for (uint8_t i = 0; i < benchmark_workload_count() && !status; ++i)
+	{
+		status = benchmark_run_workload(i, instructions, &result);
+		if (!status) benchmark_print(&result);
+	}
+
+	printf("\n%-16s %10s %12s %11s\n", "instruction", "instr", "instr/s", "ticks/instr");
+
+	for (uint8_t i = 0; i < benchmark_opcode_count() && !status; ++i)
+	{
+		status = benchmark_run_opcode(i, instructions, &result);
+		if (!status) benchmark_print(&result);
+	}
+
+	if (!status)
+	{
+		printf("\n%-16s %10s %12s\n", "idle", "cycles", "ticks");
+		status = benchmark_run_idle(instructions, &result);
+		if (!status) benchmark_print_idle(&result);
+	}
+
+	program_memory_restore();
+	control_unit_reset();
+	return status;
+}
+
+/********************************************************************************
+* load: Loads specified program into program memory, the remaining words are
+*       cleared. The value 0 is returned after successful load, otherwise
+*       error code 1 is returned.
+*
+*       - program : The program in machine code.
+*       - size    : Number of words in the program.
+*       - in_flash: Indicates if the program is stored in flash.
+********************************************************************************/
+static int load(const uint32_t* program,
+                const uint8_t size,
+                const bool in_flash)
+{
+	for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+	{
+		uint32_t word = ASSEMBLE(NOP, 0x00, 0x00);
+		if (i < size) word = in_flash ? pgm_read_dword(&program[i]) : program[i];
+		if (program_memory_store(i, word)) return 1;
+	}
+	return 0;
+}
+
+/********************************************************************************
+* run: Runs the loaded program for specified number of instructions and
+*      stores the result.
+*
+*      - name        : Name of the benchmark.
+*      - instructions: Number of instructions to run.
+*      - result      : Reference to the result of the run.
+********************************************************************************/
+static void run(const char* name,
+                const uint32_t instructions,
+                struct benchmark_result* result)
+{
+	const uint64_t start = benchmark_clock_ticks();
+	result->name = name;
+	result->instructions = control_unit_run(instructions);
+	result->ticks = benchmark_clock_ticks() - start;
+	return;
+}
+
+/********************************************************************************
+* kernel_word: Assembles an instruction of a kernel at specified address.
+*              Jumps and branches go to the next instruction, while calls go
+*              to the subroutine at the end of the kernel.
+*
+*              - instruction: OP code and operands of the instruction.
+*              - address    : Address of the instruction in the kernel.
+********************************************************************************/
+static inline uint32_t kernel_word(const uint8_t* instruction,
+                                   const uint16_t address)
+{
+	const uint8_t op_code = instruction[0];
+
+	if (op_code == CALL)
+	{
+		return ASSEMBLE(CALL, KERNEL_RET, 0x00);
+	}
+	else if (op_code >= JMP && op_code <= BRLT)
+	{
+		return ASSEMBLE(op_code, address + 1, 0x00);
+	}
+	else
+	{
+		return ASSEMBLE(op_code, instruction[1], instruction[2]);
+	}
+}
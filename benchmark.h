@@ -0,0 +1,150 @@
+/********************************************************************************
+* benchmark.h: Contains function declarations for measuring the instruction
+*              throughput of the CPU, both on the host and on the target.
+*
+*              A set of canonical workloads (ALU loops, compare chains,
+*              CALL/RET recursion, LD/ST sweeps and PCINT interrupt storms)
+*              and one small kernel per instruction are loaded into program
+*              memory and run for a given number of instructions. SLEEP is
+*              measured separately by the idle run, since the cycles skipped
+*              while sleeping aren't executed instructions. The time
+*              is measured by a clock backend selected when linking, where
+*              benchmark_clock_avr.c counts CPU cycles with Timer 1 and
+*              host/benchmark_clock_host.c uses the time stamp counter of the
+*              host processor (or nanoseconds if not available).
+*
+*              The results are printed with printf, hence stdout must be
+*              connected to a serial port on the target to see them.
+********************************************************************************/
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+/* Include directives: */
+#include "control_unit.h"
+
+/********************************************************************************
+* benchmark_result: Result of a benchmark run.
+********************************************************************************/
+struct benchmark_result
+{
+	const char* name;      /* Name of the workload or instruction. */
+	uint32_t instructions; /* Number of retired instructions. */
+	uint64_t ticks;        /* Elapsed clock ticks. */
+};
+
+/********************************************************************************
+* benchmark_workload_count: Returns the number of canonical workloads.
+********************************************************************************/
+uint8_t benchmark_workload_count(void);
+
+/********************************************************************************
+* benchmark_run_workload: Loads specified workload into program memory and runs
+*                         it for specified number of instructions after a reset
+*                         of the control unit. The value 0 is returned after a
+*                         successful run. Otherwise if the workload doesn't
+*                         exist or program memory can't be written (when the
+*                         program is read directly from flash), error code 1
+*                         is returned.
+*
+*                         - index       : Index of the workload.
+*                         - instructions: Number of instructions to run.
+*                         - result      : Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_workload(const uint8_t index,
+                           const uint32_t instructions,
+                           struct benchmark_result* result);
+
+/********************************************************************************
+* benchmark_opcode_count: Returns the number of per-instruction kernels.
+********************************************************************************/
+uint8_t benchmark_opcode_count(void);
+
+/********************************************************************************
+* benchmark_run_opcode: Loads the kernel of specified instruction into program
+*                       memory and runs it for specified number of instructions
+*                       after a reset of the control unit. There is one kernel
+*                       per instruction, from NOP to the multiply, divide and
+*                       barrel shift instructions, except RETI and SLEEP, the
+*                       latter measured by benchmark_run_idle instead. The
+*                       kernel repeats the instruction 16 times followed by a
+*                       jump, except for CALL and PUSH, which are paired with
+*                       RET and POP, and MEMCPY and MEMSET, which each follow
+*                       two LDI that set up the destination and the length of
+*                       8 words moved by every block instruction. The value 0
+*                       is returned after a successful run. Otherwise error
+*                       code 1 is returned, see benchmark_run_workload.
+*
+*                       - index       : Index of the kernel.
+*                       - instructions: Number of instructions to run.
+*                       - result      : Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_opcode(const uint8_t index,
+                         const uint32_t instructions,
+                         struct benchmark_result* result);
+
+/********************************************************************************
+* benchmark_run_idle: Loads a program that puts the CPU to sleep with the timer
+*                     running into program memory and runs it for specified
+*                     number of cycles after a reset of the control unit. The
+*                     cycles are skipped rather than executed, hence the
+*                     result holds the number of skipped idle cycles in place
+*                     of the instructions. The value 0 is returned after a
+*                     successful run. Otherwise error code 1 is returned,
+*                     see benchmark_run_workload.
+*
+*                     - cycles: Number of cycles to run.
+*                     - result: Reference to the result of the run.
+********************************************************************************/
+int benchmark_run_idle(const uint32_t cycles,
+                       struct benchmark_result* result);
+
+/********************************************************************************
+* benchmark_print: Prints the result of a benchmark run as the name, number of
+*                  instructions, instructions per second and clock ticks per
+*                  instruction (CPI when the clock counts CPU cycles). The
+*                  rate is limited to UINT32_MAX, since printf on the AVR
+*                  can't print wider integers.
+*
+*                  - result: Reference to the result to print.
+********************************************************************************/
+void benchmark_print(const struct benchmark_result* result);
+
+/********************************************************************************
+* benchmark_print_idle: Prints the result of benchmark_run_idle as the name,
+*                       number of skipped idle cycles and the clock ticks
+*                       spent skipping them. No rate is printed, since
+*                       skipping costs time per timer event rather than per
+*                       cycle.
+*
+*                       - result: Reference to the result to print.
+********************************************************************************/
+void benchmark_print_idle(const struct benchmark_result* result);
+
+/********************************************************************************
+* benchmark_run_all: Runs and prints all workloads followed by all
+*                    per-instruction kernels and the idle run, then restores
+*                    the ordinary program and resets the control unit. The
+*                    value 0 is returned after successful runs, otherwise
+*                    error code 1.
+*
+*                    - instructions: Number of instructions run per benchmark.
+********************************************************************************/
+int benchmark_run_all(const uint32_t instructions);
+
+/********************************************************************************
+* benchmark_clock_init: Starts the clock of the clock backend.
+********************************************************************************/
+void benchmark_clock_init(void);
+
+/********************************************************************************
+* benchmark_clock_ticks: Returns the number of clock ticks since the clock was
+*                        started.
+********************************************************************************/
+uint64_t benchmark_clock_ticks(void);
+
+/********************************************************************************
+* benchmark_clock_frequency: Returns the number of clock ticks per second.
+********************************************************************************/
+uint32_t benchmark_clock_frequency(void);
+
+#endif /* BENCHMARK_H_ */
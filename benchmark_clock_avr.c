@@ -0,0 +1,67 @@
+/********************************************************************************
+* benchmark_clock_avr.c: Contains function definitions for the benchmark clock
+*                        of the ATmega328P, where Timer 1 counts CPU cycles
+*                        without prescaler. Overflows are counted in an
+*                        interrupt routine to extend the counter to 64 bits.
+********************************************************************************/
+#include "benchmark.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+/* Macro definitions: */
+#ifndef F_CPU
+#define F_CPU 16000000UL /* Clock frequency of the CPU. */
+#endif
+
+/* Static variables: */
+static volatile uint64_t overflows; /* Number of overflows of Timer 1. */
+
+/********************************************************************************
+* ISR (TIMER1_OVF_vect): Counts overflows of Timer 1.
+********************************************************************************/
+ISR (TIMER1_OVF_vect)
+{
+	overflows++;
+}
+
+/********************************************************************************
+* benchmark_clock_init: Starts Timer 1 in normal mode without prescaler and
+*                       enables the overflow interrupt.
+********************************************************************************/
+void benchmark_clock_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);
+	TIMSK1 = (1 << TOIE1);
+	sei();
+	return;
+}
+
+/********************************************************************************
+* benchmark_clock_ticks: Returns the number of CPU cycles since Timer 1 was
+*                        started. An overflow pending while the counter is read
+*                        is taken into account.
+********************************************************************************/
+uint64_t benchmark_clock_ticks(void)
+{
+	uint64_t ticks;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		const uint16_t counter = TCNT1;
+		ticks = overflows;
+		if ((TIFR1 & (1 << TOV1)) && counter < 0x8000) ticks++;
+		ticks = (ticks << 16) | counter;
+	}
+	return ticks;
+}
+
+/********************************************************************************
+* benchmark_clock_frequency: Returns the number of clock ticks per second,
+*                            i.e. the clock frequency of the CPU.
+********************************************************************************/
+uint32_t benchmark_clock_frequency(void)
+{
+	return F_CPU;
+}
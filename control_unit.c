@@ -1,458 +1,1313 @@
-#include "control_unit.h"
+#include "cpu_context.h"
 
 /* Static functions: */
-static void monitor_interrupts(void);
-static void check_for_irq(void);
-static void generate_interrupt(const uint16_t interrupt_vector);
-static inline void monitor_pcint(void);
-static void control_unit_io_reset(void);
-static void control_unit_io_update(void);
-static inline void return_from_interrupt(void);
-
-
-/* Static variables: */
-static uint64_t ir; /* Instruction register, stores next instruction to execute. */
-static uint16_t pc;  /* Program counter, stores address to next instruction to fetch. */
-static uint32_t mar;
-
-static uint8_t sr;  /* Status register, stores status bits ISNZVC. */
-
-static volatile uint16_t op_code; /* Stores OP-code, for example LDI, OUT, JMP etc. */
-static uint16_t op1;     /* Stores first operand, most often a destination. */
-static uint32_t op2;     /* Stores second operand, most often a value or read address. */
-
-static enum cpu_state state;                    /* Stores current state. */
-static uint32_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU-registers R0 - R31. */
-
-static uint32_t pina_previous; /* Stores previous input values of PINB (for monitoring). */
+static inline void fetch(struct cpu_context* context);
+static inline void decode(struct cpu_context* context);
+static inline void execute(struct cpu_context* context);
+static inline void update_flags(struct cpu_context* context);
+#if CONTROL_UNIT_BLOCK_CACHE
+static void block_cache_build(struct cpu_context* context);
+static uint32_t run_block(struct cpu_context* context, const uint32_t max_instructions);
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+static inline void check_for_timer(struct cpu_context* context);
+static uint32_t idle(struct cpu_context* context, const uint32_t max_cycles);
+static inline void check_for_irq(struct cpu_context* context);
+static void generate_interrupt(struct cpu_context* context);
+static inline void pin_change(struct cpu_context* context, const uint32_t pina);
+static void control_unit_io_reset(struct cpu_context* context);
+static void control_unit_io_update(struct cpu_context* context);
+static inline void return_from_interrupt(struct cpu_context* context);
 
 
+#if CONTROL_UNIT_BLOCK_CACHE
 /********************************************************************************
-* control_unit_reset: Resets control unit registers and corresponding program.
+* superinstruction: Fused sequences of common instructions, executed with a
+*                   single dispatch. The instructions are executed one by one
+*                   through their handlers, except for the branch after a
+*                   compare, which is decided from the compared values
+*                   instead of the status flags. The architectural state is
+*                   exactly the same as when they are executed separately.
 ********************************************************************************/
-void control_unit_reset(void)
+enum superinstruction
 {
-	ir = 0x00;
-	pc = 0x00;
-	mar = 0x00;
-	sr = 0x00;
+	SUPERINSTRUCTION_NONE,           /* Not fused, executed as a single instruction. */
+	SUPERINSTRUCTION_LDI_OUT,        /* LDI followed by OUT. */
+	SUPERINSTRUCTION_IN_ANDI,        /* IN followed by ANDI. */
+	SUPERINSTRUCTION_IN_ANDI_BRANCH, /* IN followed by ANDI and a conditional branch. */
+	SUPERINSTRUCTION_ANDI_BRANCH,    /* ANDI followed by a conditional branch. */
+	SUPERINSTRUCTION_COMPARE_BRANCH  /* CPI or CP followed by a conditional branch. */
+};
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
 
-	op_code = 0x00;
-	op1 = 0x00;
-	op2 = 0x00;
+/********************************************************************************
+* control_unit_reset_ctx: Resets control unit registers of specified context
+*                         and corresponding program.
+*
+*                         - context: Reference to the CPU context.
+********************************************************************************/
+void control_unit_reset_ctx(struct cpu_context* context)
+{
+	context->ir = 0x00;
+	context->pc = 0x00;
+	context->mar = 0x00;
+	context->sr = 0x00;
 
-	state = CPU_STATE_FETCH;
+	context->state = CPU_STATE_FETCH;
 
-	pina_previous = 0x00;
+	context->pina_previous = 0x00;
+	context->pina_resync = true;
+	context->instructions = 0;
+	context->sleeping = false;
+#if CONTROL_UNIT_LAZY_FLAGS
+	context->lazy_flags.pending = false;
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
 
 	for (uint32_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
 	{
-		reg[i] = 0x00;
+		context->reg[i] = 0x00;
 	}
 
 
-	data_memory_reset();
-	stack_reset();
-	program_memory_write();
-	control_unit_io_reset();
+	data_memory_reset_ctx(context);
+	stack_reset_ctx(context);
+	program_memory_write_ctx(context);
+	program_memory_load_data_ctx(context);
+	context->instruction = program_memory_decoded_ctx(context, context->pc);
+	interrupt_update_ctx(context);
+	timer_reset_ctx(context);
+	uart_reset_ctx(context);
+	control_unit_io_reset(context);
 	return;
 }
 
 /********************************************************************************
-* control_unit_run_next_state: Runs next state in the CPU instruction cycle:
+* control_unit_run_next_state_ctx: Runs next state in the CPU instruction cycle
+*                                  of specified context:
+*
+*                                  - context: Reference to the CPU context.
 ********************************************************************************/
-void control_unit_run_next_state(void)
+void control_unit_run_next_state_ctx(struct cpu_context* context)
 {
-	switch (state)
+	switch (context->state)
 	{
 		case CPU_STATE_FETCH:
 		{
-			ir = program_memory_read(pc); /* Fetches next instruction. */
-			mar = pc;                     /* Stores address of current instruction. */
-			pc++;                         /* Program counter points to next instruction. */
-			state = CPU_STATE_DECODE;     /* Decodes the instruction during next clock cycle. */
+			if (context->sleeping)
+			{
+				idle(context, 1);          /* Lets one cycle pass until an interrupt is generated. */
+				check_for_timer(context);
+				check_for_irq(context);
+				break;
+			}
+
+			fetch(context);                    /* Fetches next instruction. */
+			context->state = CPU_STATE_DECODE; /* Decodes the instruction during next clock cycle. */
 			break;
 		}
 		case CPU_STATE_DECODE:
 		{
-			op_code = ir >> 48;           /* Bit 23 downto 16 consists of the OP code. */
-			op1 = ir >> 32;                /* Bit 15 downto 8 consists of the first operand. */
-			op2 = ir;                     /* Bit 7 downto 0 consists of the second operand. */
-			state = CPU_STATE_EXECUTE;    /* Executes the instruction during next clock cycle. */
+			decode(context);                    /* Splits the instruction into OP code and operands. */
+			context->state = CPU_STATE_EXECUTE; /* Executes the instruction during next clock cycle. */
 			break;
 		}
 		case CPU_STATE_EXECUTE:
 		{
-			switch (op_code) /* Checks the OP code.*/
-			{
-				case NOP: /* NOP => do nothing. */
-				{
-					break;
-				}
-				case LDI: /* Loads constant into specified CPU register. */
-				{
-					reg[op1] = op2;
-					break;
-				}
-				case MOV: /* Copies value to specified CPU register. */
-				{
-					reg[op1] = reg[op2];
-					break;
-				}
-				case OUT: /* Writes value to I/O location (address 0 - 255) in data memory. */
-				{
-					if (op1 == PINA)
-					{
-						const uint32_t data = data_memory_read(PORTA);
-						data_memory_write(PORTA, data ^ reg[op2]);
-					}
-					else
-					{
-						data_memory_write(op1, reg[op2]);
-					}
-					break;
-				}
-				case IN: /* Reads value from I/O location (address 0 - 255) in data memory. */
-				{
-					reg[op1] = data_memory_read(op2);
-					break;
-				}
-				case STS: /* Stores value to data memory (address 256 - 511, hence an offset of 256). */
-				{
-					data_memory_write(op1, reg[op2]);
-					break;
-				}
-				case LDS: /* Loads value from data memory (address 256 - 511, hence an offset of 256). */
-				{
-					reg[op1] = data_memory_read(op2);
-					break;
-				}
-				case CLR: /* Clears content of CPU register. */
-				{
-					reg[op1] = 0x00;
-					break;
-				}
-				case ORI: /* Performs bitwise OR with a constant. */
-				{
-					reg[op1] = alu(OR, reg[op1], op2, &sr);
-					break;
-				}
-				case ANDI: /* Performs bitwise AND with a constant. */
-				{
-					reg[op1] = alu(AND, reg[op1], op2, &sr);
-					break;
-				}
-				case XORI: /* Performs bitwise XOR with a constant. */
-				{
-					reg[op1] = alu(XOR, reg[op1], op2, &sr);
-					break;
-				}
-				case OR: /* Performs bitwise OR with content in CPU register. */
-				{
-					reg[op1] = alu(OR, reg[op1], reg[op2], &sr);
-					break;
-				}
-				case AND: /* Performs bitwise AND with content in CPU register. */
-				{
-					reg[op1] = alu(AND, reg[op1], reg[op2], &sr);
-					break;
-				}
-				case XOR: /* Performs bitwise AND with content in CPU register. */
-				{
-					reg[op1] = alu(XOR, reg[op1], reg[op2], &sr);
-					break;
-				}
-				case ADDI: /* Performs addition with a constant. */
-				{
-					reg[op1] = alu(ADD, reg[op1], op2, &sr);
-					break;
-				}
-				case SUBI: /* Performs subtraction with a constant. */
-				{
-					reg[op1] = alu(SUB, reg[op1], op2, &sr);
-					break;
-				}
-				case ADD: /* Performs addition with a CPU register. */
-				{
-					reg[op1] = alu(ADD, reg[op1], reg[op2], &sr);
-					break;
-				}
-				case SUB: /* Performs subtraction with a CPU register. */
-				{
-					reg[op1] = alu(SUB, reg[op1], reg[op2], &sr);
-					break;
-				}
-				case INC: /* Increments content of a CPU register. */
-				{
-					reg[op1] = alu(ADD, reg[op1], 1, &sr);
-					break;
-				}
-				case DEC: /* Decrements content of a CPU register. */
-				{
-					reg[op1] = alu(SUB, reg[op1], 1, &sr);
-					break;
-				}
-				case CPI: /* Compares content between CPU register with a constant. */
-				{
-					(void)alu(SUB, reg[op1], op2, &sr); /* Return value is not stored. */
-					break;
-				}
-				case CP: /* Compares content between two CPU registers. */
-				{
-					(void)alu(SUB, reg[op1], reg[op2], &sr); /* Return value is not stored. */
-					break;
-				}
-				case JMP: /* Jumps to specified address. */
-				{
-					pc = op1;
-					break;
-				}
-				case BREQ: /* Branches to specified address i Z flag is set. */
-				{
-					if (read(sr, Z)) pc = op1;
-					break;
-				}
-				case BRNE: /* Branches to specified address if Z flag is cleared. */
-				{
-					if (!read(sr, Z)) pc = op1;
-					break;
-				}
-				case BRGE: /* Branches to specified address if S flag is cleared. */
-				{
-					if (!read(sr, S)) pc = op1;
-					break;
-				}
-				case BRGT: /* Branches to specified address if both S and Z flags are cleared. */
-				{
-					if (!read(sr, S) && !read(sr, Z)) pc = op1;
-					break;
-				}
-				case BRLE: /* Branches to specified address if S or Z flag is set. */
-				{
-					if (read(sr, S) || read(sr, Z)) pc = op1;
-					break;
-				}
-				case BRLT: /* Branches to specified address if S flag is set. */
-				{
-					if (read(sr, S)) pc = op1;
-					break;
-				}
-				case CALL: /* Stores the return address on the stack and jumps to specified address. */
-				{
-					stack_push(pc);
-					pc = op1;
-					break;
-				}
-				case RET: /* Jumps to return address stored on the stack. */
-				{
-					pc = stack_pop();
-					break;
-				}
-				case RETI: /* Pops the return address from the stack and sets the global interrupt flag. */
-				{
-					pc = stack_pop();
-					set(sr, I);
-					break;
-				}
-				case PUSH: /* Stores content of specified CPU register on the stack. */
-				{
-					stack_push(reg[op1]);
-					break;
-				}
-				case POP: /* Loads value from the stack to a CPU-register. */
-				{
-					reg[op1] = stack_pop();
-					break;
-				}
-				case LSL: /* Shifts content of CPU register on step to the left. */
-				{
-					reg[op1] = reg[op1] << 1;
-					break;
-				}
-				case LSR: /* Shifts content of CPU register on step to the right. */
-				{
-					reg[op1] = reg[op1] >> 1;
-					break;
-				}
-				case SEI: /* Sets the global interrupt flag in the status register. */
-				{
-					set(sr, I);
-					break;
-				}
-				case CLI: /* Clears the global interrupt flag in the status register. */
-				{
-					clr(sr, I);
-					break;
-				}
-				case STIO:  /* Stores value to referenced I/O location (no offset). */
-				{
-					const uint16_t address = reg[op1] | (reg[op1 + 1] << 8);
-					data_memory_write(address, reg[op2]);
-					break;
-				}
-				case LDIO: /* Loads value from referenced I/O location (no offset). */
-				{
-					const uint16_t address = reg[op2] | (reg[op2 + 1] << 8);
-					reg[op1] = data_memory_read(address);
-					break;
-				}
-				case ST: /* Stores value to referenced data location (offset = 256). */
-				{
-					const uint16_t address = reg[op1] | (reg[op1 + 1] << 8);
-					data_memory_write(address, reg[op2]);
-					break;
-				}
-				case LD: /* Loads value from referenced data location (offset = 256). */
-				{
-					const uint16_t address = reg[op2] | (reg[op2 + 1] << 8);
-					reg[op1] = data_memory_read(address);
-					break;
-				}
-				default:
-				{
-					control_unit_reset(); /* System reset if error occurs. */
-					break;
-				}
-			}
+			execute(context);      /* Executes the decoded instruction. */
+			update_flags(context); /* Keeps the status register exact between cycles. */
+			context->instructions++;
 
-			state = CPU_STATE_FETCH;    /* Fetches next instruction during next clock cycle. */
-			check_for_irq();            /* Checks for interrupt request after each execute cycle. */
+			context->state = CPU_STATE_FETCH; /* Fetches next instruction during next clock cycle. */
+			check_for_timer(context);         /* Raises timer interrupts that are due. */
+			check_for_irq(context);           /* Checks for interrupt request after each execute cycle. */
 			break;
 		}
 		default:                       /* System reset if error occurs. */
 		{
-			control_unit_reset();
+			control_unit_reset_ctx(context);
 			break;
 		}
 	}
 
-	control_unit_io_update();
-	monitor_interrupts();            /* Monitors interrupts each clock cycle. */
+	control_unit_io_update(context);
+	return;
+}
+
+/********************************************************************************
+* control_unit_run_ctx: Runs up to specified number of whole instructions in
+*                       specified context. Each instruction is fetched, decoded
+*                       and executed in one go, while I/O synchronization and
+*                       interrupt monitoring are only done at instruction
+*                       boundaries instead of after every state of the
+*                       instruction cycle. The predecoded instruction is
+*                       executed directly, hence the instruction register isn't
+*                       updated in this mode. An instruction started by
+*                       control_unit_run_next_state_ctx is completed first.
+*                       While the CPU is sleeping, the cycles until the next
+*                       event are skipped and counted as retired instructions.
+*                       The number of retired instructions is returned.
+*
+*                       - context         : Reference to the CPU context.
+*                       - max_instructions: Maximum number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run_ctx(struct cpu_context* context,
+                              const uint32_t max_instructions)
+{
+	uint32_t retired = 0;
+
+	while (context->state != CPU_STATE_FETCH && retired < max_instructions)
+	{
+		if (context->state == CPU_STATE_EXECUTE) retired++;
+		control_unit_run_next_state_ctx(context);
+	}
+
+#if CONTROL_UNIT_BLOCK_CACHE
+	if (context->block_cache_revision != program_memory_revision_ctx(context))
+	{
+		block_cache_build(context); /* Program memory has been rewritten since last build. */
+	}
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+
+	while (retired < max_instructions)
+	{
+		if (context->sleeping)
+		{
+			/* Lets a single cycle pass first, so that pin changes applied since last run wake the CPU. */
+			retired += idle(context, retired ? max_instructions - retired : 1);
+		}
+		else
+		{
+#if CONTROL_UNIT_BLOCK_CACHE
+			uint32_t budget = max_instructions - retired;
+
+			if (context->timer.deadline - context->instructions < budget)
+			{
+				/* Stops at the next timer event, so that its interrupt is generated on time. */
+				budget = context->timer.deadline > context->instructions ?
+					(uint32_t)(context->timer.deadline - context->instructions) : 1;
+			}
+			retired += run_block(context, budget);
+#else
+			context->mar = context->pc;                                              /* Stores address of current instruction. */
+			context->instruction = program_memory_decoded_ctx(context, context->pc); /* Reads the predecoded instruction directly. */
+			context->pc += context->instruction->size;                               /* Skips the extension word, if any. */
+			execute(context);
+			context->instructions++;
+			retired++;
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+		}
+
+		check_for_timer(context);
+		check_for_irq(context);
+
+		control_unit_io_update(context);
+	}
+
+	update_flags(context); /* The status register is exact when returning to the caller. */
+	return retired;
+}
+
+/********************************************************************************
+* fetch: Fetches next instruction from program memory to the instruction
+*        register and increments the program counter.
+********************************************************************************/
+static inline void fetch(struct cpu_context* context)
+{
+	context->ir = program_memory_read_ctx(context, context->pc); /* Fetches next instruction. */
+	context->mar = context->pc;                                  /* Stores address of current instruction. */
+	context->pc++;                                               /* Program counter points to next instruction. */
+	return;
+}
+
+/********************************************************************************
+* decode: Decodes the instruction stored in the instruction register. Since
+*         the program memory is predecoded when written, the OP code and
+*         operands are read from the predecoded copy of the instruction
+*         instead of being split from the instruction register. If the
+*         instruction has an extension word, the program counter is
+*         incremented past it.
+********************************************************************************/
+static inline void decode(struct cpu_context* context)
+{
+	context->instruction = program_memory_decoded_ctx(context, context->mar);
+	context->pc = context->mar + context->instruction->size;
+	return;
+}
+
+/********************************************************************************
+* calculate: Performs calculation in the ALU with specified operands and returns
+*            the result. If CONTROL_UNIT_LAZY_FLAGS is set, the operation is
+*            only recorded so that the status flags can be calculated later
+*            by update_flags, otherwise the status flags are updated directly.
+*
+*            - context  : Reference to the CPU context.
+*            - operation: The operation to perform (OR, AND, XOR, ADD, SUB, MUL,
+*                         MULH, DIV, MOD, LSLV, LSRV, ASR, ROL or ROR).
+*            - a        : First operand.
+*            - b        : Second operand.
+********************************************************************************/
+static inline uint32_t calculate(struct cpu_context* context,
+                                 const uint8_t operation,
+                                 const uint32_t a,
+                                 const uint32_t b)
+{
+#if CONTROL_UNIT_LAZY_FLAGS
+	const uint32_t result = alu_calculate(operation, a, b);
+	context->lazy_flags.operation = operation;
+	context->lazy_flags.a = a;
+	context->lazy_flags.b = b;
+	context->lazy_flags.result = result;
+	context->lazy_flags.pending = true;
+	return result;
+#else
+	if (operation == ADD) return alu_add(a, b, &context->sr);
+	else if (operation == SUB) return alu_sub(a, b, &context->sr);
+	else return alu_other(operation, a, b, &context->sr);
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+}
+
+/********************************************************************************
+* update_flags: Calculates pending status flags SNZVC from the last recorded
+*               ALU operation, so that the status register is up to date.
+*               Must be called before the status flags are read.
+********************************************************************************/
+static inline void update_flags(struct cpu_context* context)
+{
+#if CONTROL_UNIT_LAZY_FLAGS
+	struct lazy_flags* flags = &context->lazy_flags;
+
+	if (flags->pending)
+	{
+		context->sr = (context->sr & ~ALU_FLAGS) | alu_flags(flags->operation, flags->a, flags->b, flags->result);
+		flags->pending = false;
+	}
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+	return;
+}
+
+/********************************************************************************
+* execute_*: Instruction handlers, each executing one instruction with specified
+*            operands. The handlers are either called from the switch statement
+*            in execute or dispatched through the handler table, which is
+*            indexed by the predecoded OP code.
+*
+*            - op1: First operand, most often a destination.
+*            - op2: Second operand, most often a value or read address.
+********************************************************************************/
+/* NOP: Does nothing. */
+static inline void execute_nop(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
 	return;
 }
 
-static void control_unit_io_reset(void)
+/* LDI: Loads constant into specified CPU register. */
+static inline void execute_ldi(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
 {
-	
-	DDRB = 0;
-	DDRC = 0;
-	DDRD = 0;
-	
-	PORTB = 0;
-	PORTC = 0;
-	PORTD = 0;
+	context->reg[op1] = op2;
 	return;
 }
-static void control_unit_io_update(void)
+
+/* MOV: Copies value to specified CPU register. */
+static inline void execute_mov(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
 {
-	const uint32_t ddra = data_memory_read(DDRA);
-	const uint32_t porta = data_memory_read(PORTA);
-	const uint32_t pina = PIND | ((uint32_t)(PINB) << 8) | ((uint32_t)(PINC) << 16);
-	
-	data_memory_write(PINA, pina);
-	
-	DDRB = (uint8_t)(ddra >> 8);
-	DDRC = (uint8_t)(ddra >> 16);
-	DDRD = (uint8_t)(ddra);
-	
-	PORTB = (uint8_t)(porta >> 8);
-	PORTC = (uint8_t)(porta >> 16);
-	PORTD = (uint8_t)(porta);
+	context->reg[op1] = context->reg[op2];
 	return;
-	
 }
 
-static inline void cpu_registers_clear(void)
+/* OUT: Writes value to I/O location (address 0 - 255) in data memory. */
+static inline void execute_out(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
 {
-	for (uint32_t* i = reg; i < reg + CPU_REGISTER_ADDRESS_WIDTH; ++i)
+	if (op1 == PINA)
 	{
-		*i = 0x00;
+		const uint32_t data = data_memory_read_ctx(context, PORTA);
+		data_memory_write_ctx(context, PORTA, data ^ context->reg[op2]);
+	}
+	else
+	{
+		data_memory_write_ctx(context, op1, context->reg[op2]);
+	}
+	return;
+}
+
+/* IN: Reads value from I/O location (address 0 - 255) in data memory. */
+static inline void execute_in(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = data_memory_read_ctx(context, op2);
+	return;
+}
+
+/* STS: Stores value to data memory (address 256 - 511, hence an offset of 256). */
+static inline void execute_sts(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	data_memory_write_ctx(context, op1, context->reg[op2]);
+	return;
+}
+
+/* LDS: Loads value from data memory (address 256 - 511, hence an offset of 256). */
+static inline void execute_lds(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = data_memory_read_ctx(context, op2);
+	return;
+}
+
+/* CLR: Clears content of CPU register. */
+static inline void execute_clr(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = 0x00;
+	return;
+}
+
+/* ORI: Performs bitwise OR with a constant. */
+static inline void execute_ori(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, OR, context->reg[op1], op2);
+	return;
+}
+
+/* ANDI: Performs bitwise AND with a constant. */
+static inline void execute_andi(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, AND, context->reg[op1], op2);
+	return;
+}
+
+/* XORI: Performs bitwise XOR with a constant. */
+static inline void execute_xori(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, XOR, context->reg[op1], op2);
+	return;
+}
+
+/* OR: Performs bitwise OR with content in CPU register. */
+static inline void execute_or(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, OR, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* AND: Performs bitwise AND with content in CPU register. */
+static inline void execute_and(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, AND, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* XOR: Performs bitwise AND with content in CPU register. */
+static inline void execute_xor(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, XOR, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* ADDI: Performs addition with a constant. */
+static inline void execute_addi(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ADD, context->reg[op1], op2);
+	return;
+}
+
+/* SUBI: Performs subtraction with a constant. */
+static inline void execute_subi(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, SUB, context->reg[op1], op2);
+	return;
+}
+
+/* ADD: Performs addition with a CPU register. */
+static inline void execute_add(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ADD, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* SUB: Performs subtraction with a CPU register. */
+static inline void execute_sub(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, SUB, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* INC: Increments content of a CPU register. */
+static inline void execute_inc(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ADD, context->reg[op1], 1);
+	return;
+}
+
+/* DEC: Decrements content of a CPU register. */
+static inline void execute_dec(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, SUB, context->reg[op1], 1);
+	return;
+}
+
+/* CPI: Compares content between CPU register with a constant. */
+static inline void execute_cpi(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	(void)calculate(context, SUB, context->reg[op1], op2); /* Return value is not stored. */
+	return;
+}
+
+/* CP: Compares content between two CPU registers. */
+static inline void execute_cp(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	(void)calculate(context, SUB, context->reg[op1], context->reg[op2]); /* Return value is not stored. */
+	return;
+}
+
+/* MUL: Multiplies content of a CPU register with another, keeps the low word. */
+static inline void execute_mul(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, MUL, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* MULH: Multiplies content of a CPU register with another, keeps the signed high word. */
+static inline void execute_mulh(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, MULH, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* DIV: Divides content of a CPU register by another. */
+static inline void execute_div(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, DIV, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* MOD: Calculates the remainder of content of a CPU register divided by another. */
+static inline void execute_mod(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, MOD, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* JMP: Jumps to specified address. */
+static inline void execute_jmp(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->pc = op1;
+	return;
+}
+
+/* BREQ: Branches to specified address i Z flag is set. */
+static inline void execute_breq(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (read(context->sr, Z)) context->pc = op1;
+	return;
+}
+
+/* BRNE: Branches to specified address if Z flag is cleared. */
+static inline void execute_brne(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (!read(context->sr, Z)) context->pc = op1;
+	return;
+}
+
+/* BRGE: Branches to specified address if S flag is cleared. */
+static inline void execute_brge(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (!read(context->sr, S)) context->pc = op1;
+	return;
+}
+
+/* BRGT: Branches to specified address if both S and Z flags are cleared. */
+static inline void execute_brgt(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (!read(context->sr, S) && !read(context->sr, Z)) context->pc = op1;
+	return;
+}
+
+/* BRLE: Branches to specified address if S or Z flag is set. */
+static inline void execute_brle(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (read(context->sr, S) || read(context->sr, Z)) context->pc = op1;
+	return;
+}
+
+/* BRLT: Branches to specified address if S flag is set. */
+static inline void execute_brlt(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	if (read(context->sr, S)) context->pc = op1;
+	return;
+}
+
+/* CALL: Stores the return address on the stack and jumps to specified address. */
+static inline void execute_call(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	stack_push_ctx(context, context->pc);
+	context->pc = op1;
+	return;
+}
+
+/* RET: Jumps to return address stored on the stack. */
+static inline void execute_ret(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->pc = stack_pop_ctx(context);
+	return;
+}
+
+/* RETI: Pops the return address from the stack and sets the global interrupt flag. */
+static inline void execute_reti(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	update_flags(context);
+	context->pc = stack_pop_ctx(context);
+	set(context->sr, I);
+	interrupt_update_ctx(context);
+	return;
+}
+
+/* PUSH: Stores content of specified CPU register on the stack. */
+static inline void execute_push(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	stack_push_ctx(context, context->reg[op1]);
+	return;
+}
+
+/* POP: Loads value from the stack to a CPU-register. */
+static inline void execute_pop(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = stack_pop_ctx(context);
+	return;
+}
+
+/* LSL: Shifts content of CPU register on step to the left. */
+static inline void execute_lsl(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = context->reg[op1] << 1;
+	return;
+}
+
+/* LSR: Shifts content of CPU register on step to the right. */
+static inline void execute_lsr(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = context->reg[op1] >> 1;
+	return;
+}
+
+/* LSLV: Shifts content of a CPU register to the left by the count in another. */
+static inline void execute_lslv(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, LSLV, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* LSRV: Shifts content of a CPU register to the right by the count in another. */
+static inline void execute_lsrv(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, LSRV, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* ASR: Shifts content of a CPU register to the right by the count in another, keeping the sign. */
+static inline void execute_asr(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ASR, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* ROL: Rotates content of a CPU register to the left by the count in another. */
+static inline void execute_rol(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ROL, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* ROR: Rotates content of a CPU register to the right by the count in another. */
+static inline void execute_ror(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->reg[op1] = calculate(context, ROR, context->reg[op1], context->reg[op2]);
+	return;
+}
+
+/* SEI: Sets the global interrupt flag in the status register. */
+static inline void execute_sei(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	set(context->sr, I);
+	interrupt_update_ctx(context);
+	return;
+}
+
+/* CLI: Clears the global interrupt flag in the status register. */
+static inline void execute_cli(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	clr(context->sr, I);
+	context->irq_pending = 0x00;
+	return;
+}
+
+/* STIO: Stores value to referenced I/O location (no offset). */
+static inline void execute_stio(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint16_t address = context->reg[op1] | (context->reg[op1 + 1] << 8);
+	data_memory_write_ctx(context, address, context->reg[op2]);
+	return;
+}
+
+/* LDIO: Loads value from referenced I/O location (no offset). */
+static inline void execute_ldio(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint16_t address = context->reg[op2] | (context->reg[op2 + 1] << 8);
+	context->reg[op1] = data_memory_read_ctx(context, address);
+	return;
+}
+
+/* ST: Stores value to referenced data location (offset = 256). */
+static inline void execute_st(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint16_t address = context->reg[op1] | (context->reg[op1 + 1] << 8);
+	data_memory_write_ctx(context, address, context->reg[op2]);
+	return;
+}
+
+/* LD: Loads value from referenced data location (offset = 256). */
+static inline void execute_ld(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint16_t address = context->reg[op2] | (context->reg[op2 + 1] << 8);
+	context->reg[op1] = data_memory_read_ctx(context, address);
+	return;
+}
+
+/* SLEEP: Halts execution until an interrupt is generated, which returns to the next instruction. */
+static inline void execute_sleep(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	context->sleeping = true;
+	return;
+}
+
+/********************************************************************************
+* memory_chunk: Returns the number of words to handle in this execution of
+*               MEMCPY or MEMSET with specified number of words left. If
+*               words are left after the chunk, the program counter is moved
+*               back to the instruction, which is then run again for the
+*               rest once any pending interrupt has been generated. Progress
+*               is kept in the operand registers, which is why the length
+*               register ends at 0 and the destination register past the
+*               block, as does the source register of MEMCPY unless the block
+*               is copied upwards. Upward copies run from the end of the
+*               block, so that overlapping blocks are copied correctly.
+*               The whole block left is validated before each chunk, hence
+*               blocks that extend past data memory are left untouched.
+*
+*               - context: Reference to the CPU context.
+*               - length : Number of words left.
+********************************************************************************/
+static inline uint32_t memory_chunk(struct cpu_context* context, const uint32_t length)
+{
+	if (length <= CONTROL_UNIT_MEMORY_CHUNK) return length;
+	context->pc = context->mar;
+	return CONTROL_UNIT_MEMORY_CHUNK;
+}
+
+/* MEMCPY: Copies R[op1 + 1] words from the address in R[op2] to the address in R[op1], see memory_chunk. */
+static inline void execute_memcpy(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint32_t destination = context->reg[op1];
+	const uint32_t source = context->reg[op2];
+	const uint32_t length = context->reg[op1 + 1];
+	const uint32_t count = memory_chunk(context, length);
+	const uint32_t offset = destination > source ? length - count : 0;
+
+	if (!data_memory_block_valid(destination, length) || !data_memory_block_valid(source, length) ||
+	    data_memory_copy_ctx(context, destination + offset, source + offset, count))
+	{
+		context->pc = context->mar + context->instruction->size; /* Invalid block, nothing left to copy. */
+		return;
+	}
+
+	if (destination <= source)
+	{
+		context->reg[op1] += count;
+		context->reg[op2] += count;
+	}
+	context->reg[op1 + 1] -= count;
+	return;
+}
+
+/* MEMSET: Writes R[op2] to R[op1 + 1] words from the address in R[op1], see memory_chunk. */
+static inline void execute_memset(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
+{
+	const uint32_t length = context->reg[op1 + 1];
+	const uint32_t count = memory_chunk(context, length);
+
+	if (!data_memory_block_valid(context->reg[op1], length) ||
+	    data_memory_fill_ctx(context, context->reg[op1], context->reg[op2], count))
+	{
+		context->pc = context->mar + context->instruction->size; /* Invalid block, nothing left to fill. */
+		return;
 	}
+
+	context->reg[op1] += count;
+	context->reg[op1 + 1] -= count;
 	return;
 }
 
-static void monitor_interrupts(void)
+/* ILLEGAL: Unknown OP code, performs system reset. */
+static inline void execute_illegal(struct cpu_context* context, const uint16_t op1, const uint32_t op2)
 {
-	monitor_pcint();
+	control_unit_reset_ctx(context);
 	return;
 }
 
+#if CONTROL_UNIT_DISPATCH == CONTROL_UNIT_DISPATCH_TABLE
 /********************************************************************************
-* check_for_irq: Checks for interrupt requests and generates an interrupt if
-*                the I flag in status register i set, a specific interrupt flag,
-*                such as PCIF0 in PCIFR, is set and the corresponding interrupt
-*                enable bit, such as PCIE0 in PCICR, i set. Before an interrupt
-*                is generated, the corresponding flag bit is cleared to
-*                terminate the interrupt request. Otherwise the interrupt
-*                will be generated again and again). A jump is made to the
-*                corresponding interrupt vector, such as PCINT0_vect.
+* handlers: Handler table indexed by the predecoded OP code. Since unknown OP
+*           codes are predecoded to ILLEGAL, no bounds check is needed.
+********************************************************************************/
+static void (* const handlers[ILLEGAL + 1])(struct cpu_context* context, const uint16_t op1, const uint32_t op2) =
+{
+	[NOP]    = execute_nop,
+	[LDI]    = execute_ldi,
+	[MOV]    = execute_mov,
+	[OUT]    = execute_out,
+	[IN]     = execute_in,
+	[STS]    = execute_sts,
+	[LDS]    = execute_lds,
+	[CLR]    = execute_clr,
+	[ORI]    = execute_ori,
+	[ANDI]   = execute_andi,
+	[XORI]   = execute_xori,
+	[OR]     = execute_or,
+	[AND]    = execute_and,
+	[XOR]    = execute_xor,
+	[ADDI]   = execute_addi,
+	[SUBI]   = execute_subi,
+	[ADD]    = execute_add,
+	[SUB]    = execute_sub,
+	[INC]    = execute_inc,
+	[DEC]    = execute_dec,
+	[CPI]    = execute_cpi,
+	[CP]     = execute_cp,
+	[JMP]    = execute_jmp,
+	[BREQ]   = execute_breq,
+	[BRNE]   = execute_brne,
+	[BRGE]   = execute_brge,
+	[BRGT]   = execute_brgt,
+	[BRLE]   = execute_brle,
+	[BRLT]   = execute_brlt,
+	[CALL]   = execute_call,
+	[RET]    = execute_ret,
+	[RETI]   = execute_reti,
+	[PUSH]   = execute_push,
+	[POP]    = execute_pop,
+	[LSL]    = execute_lsl,
+	[LSR]    = execute_lsr,
+	[SEI]    = execute_sei,
+	[CLI]    = execute_cli,
+	[STIO]   = execute_stio,
+	[LDIO]   = execute_ldio,
+	[ST]     = execute_st,
+	[LD]     = execute_ld,
+	[SLEEP]  = execute_sleep,
+	[MEMCPY] = execute_memcpy,
+	[MEMSET] = execute_memset,
+	[MUL]    = execute_mul,
+	[MULH]   = execute_mulh,
+	[DIV]    = execute_div,
+	[MOD]    = execute_mod,
+	[LSLV]   = execute_lslv,
+	[LSRV]   = execute_lsrv,
+	[ASR]    = execute_asr,
+	[ROL]    = execute_rol,
+	[ROR]    = execute_ror,
+	[ILLEGAL] = execute_illegal
+};
+#endif /* CONTROL_UNIT_DISPATCH */
+
+/********************************************************************************
+* execute: Executes the decoded instruction, either through the switch
+*          statement or the handler table depending on CONTROL_UNIT_DISPATCH.
+********************************************************************************/
+static inline void execute(struct cpu_context* context)
+{
+	const uint16_t op1 = context->instruction->op1; /* First operand, most often a destination. */
+	const uint32_t op2 = context->instruction->op2; /* Second operand, most often a value or read address. */
+
+#if CONTROL_UNIT_DISPATCH == CONTROL_UNIT_DISPATCH_TABLE
+	handlers[context->instruction->op_code](context, op1, op2);
+#else
+	switch (context->instruction->op_code) /* Checks the OP code.*/
+	{
+		case NOP:  execute_nop(context, op1, op2); break;
+		case LDI:  execute_ldi(context, op1, op2); break;
+		case MOV:  execute_mov(context, op1, op2); break;
+		case OUT:  execute_out(context, op1, op2); break;
+		case IN:   execute_in(context, op1, op2); break;
+		case STS:  execute_sts(context, op1, op2); break;
+		case LDS:  execute_lds(context, op1, op2); break;
+		case CLR:  execute_clr(context, op1, op2); break;
+		case ORI:  execute_ori(context, op1, op2); break;
+		case ANDI: execute_andi(context, op1, op2); break;
+		case XORI: execute_xori(context, op1, op2); break;
+		case OR:   execute_or(context, op1, op2); break;
+		case AND:  execute_and(context, op1, op2); break;
+		case XOR:  execute_xor(context, op1, op2); break;
+		case ADDI: execute_addi(context, op1, op2); break;
+		case SUBI: execute_subi(context, op1, op2); break;
+		case ADD:  execute_add(context, op1, op2); break;
+		case SUB:  execute_sub(context, op1, op2); break;
+		case INC:  execute_inc(context, op1, op2); break;
+		case DEC:  execute_dec(context, op1, op2); break;
+		case CPI:  execute_cpi(context, op1, op2); break;
+		case CP:   execute_cp(context, op1, op2); break;
+		case JMP:  execute_jmp(context, op1, op2); break;
+		case BREQ: execute_breq(context, op1, op2); break;
+		case BRNE: execute_brne(context, op1, op2); break;
+		case BRGE: execute_brge(context, op1, op2); break;
+		case BRGT: execute_brgt(context, op1, op2); break;
+		case BRLE: execute_brle(context, op1, op2); break;
+		case BRLT: execute_brlt(context, op1, op2); break;
+		case CALL: execute_call(context, op1, op2); break;
+		case RET:  execute_ret(context, op1, op2); break;
+		case RETI: execute_reti(context, op1, op2); break;
+		case PUSH: execute_push(context, op1, op2); break;
+		case POP:  execute_pop(context, op1, op2); break;
+		case LSL:  execute_lsl(context, op1, op2); break;
+		case LSR:  execute_lsr(context, op1, op2); break;
+		case SEI:  execute_sei(context, op1, op2); break;
+		case CLI:  execute_cli(context, op1, op2); break;
+		case STIO: execute_stio(context, op1, op2); break;
+		case LDIO: execute_ldio(context, op1, op2); break;
+		case ST:   execute_st(context, op1, op2); break;
+		case LD:   execute_ld(context, op1, op2); break;
+		case SLEEP: execute_sleep(context, op1, op2); break;
+		case MEMCPY: execute_memcpy(context, op1, op2); break;
+		case MEMSET: execute_memset(context, op1, op2); break;
+		case MUL:  execute_mul(context, op1, op2); break;
+		case MULH: execute_mulh(context, op1, op2); break;
+		case DIV:  execute_div(context, op1, op2); break;
+		case MOD:  execute_mod(context, op1, op2); break;
+		case LSLV: execute_lslv(context, op1, op2); break;
+		case LSRV: execute_lsrv(context, op1, op2); break;
+		case ASR:  execute_asr(context, op1, op2); break;
+		case ROL:  execute_rol(context, op1, op2); break;
+		case ROR:  execute_ror(context, op1, op2); break;
+		default:   execute_illegal(context, op1, op2); break; /* System reset if error occurs. */
+	}
+#endif /* CONTROL_UNIT_DISPATCH */
+	return;
+}
+
+#if CONTROL_UNIT_BLOCK_CACHE
+/********************************************************************************
+* is_branch: Indicates if specified OP code is a conditional branch.
+*
+*            - op_code: The OP code to check.
+********************************************************************************/
+static inline bool is_branch(const uint8_t op_code)
+{
+	return op_code >= BREQ && op_code <= BRLT;
+}
+
+/********************************************************************************
+* ends_block: Indicates if specified instruction terminates a basic block, i.e.
+*             if the instruction might change the program flow. Instructions
+*             that might write to the I/O registers or change the I flag end
+*             the block as well, so that I/O synchronization and interrupt
+*             monitoring see their effect right after them, just as when
+*             the instructions are run one by one. ST and STIO write to an
+*             address only known at runtime and are hence always assumed to
+*             access the I/O registers.
+*
+*             - instruction: The predecoded instruction to check.
+********************************************************************************/
+static inline bool ends_block(const struct instruction* instruction)
+{
+	const uint8_t op_code = instruction->op_code;
+	return op_code == JMP || is_branch(op_code) || op_code == CALL ||
+		op_code == RET || op_code == RETI || op_code == SLEEP || op_code == MEMCPY ||
+		op_code == MEMSET || op_code == ILLEGAL || op_code == OUT || op_code == STIO ||
+		op_code == ST || op_code == SEI || op_code == CLI ||
+		(op_code == STS && instruction->op1 < DATA_MEMORY_IO_WIDTH);
+}
+
+/********************************************************************************
+* superinstruction_length: Returns the number of instructions fused into
+*                          specified superinstruction.
+*
+*                          - fused: The superinstruction.
 ********************************************************************************/
+static inline uint8_t superinstruction_length(const uint8_t fused)
+{
+	if (fused == SUPERINSTRUCTION_NONE) return 1;
+	else if (fused == SUPERINSTRUCTION_IN_ANDI_BRANCH) return 3;
+	else return 2;
+}
 
-static void check_for_irq(void)
+/********************************************************************************
+* block_cache_build: Splits the predecoded program into basic blocks, which are
+*                    straight-line runs of instructions ending with an
+*                    instruction that might change the program flow, and finds
+*                    sequences of instructions within each block that can be
+*                    fused into superinstructions. Since the program memory is
+*                    scanned backwards, each address holds the number of
+*                    instructions left until the end of its block, hence any
+*                    address can be used as an entry point. Extension words
+*                    are scanned as well, but are never entered.
+********************************************************************************/
+static void block_cache_build(struct cpu_context* context)
 {
-	if (read(sr, I))
+	for (uint16_t i = PROGRAM_MEMORY_ADDRESS_WIDTH; i-- > 0;)
 	{
-		const uint32_t pcifr = data_memory_read(IFR);
-		const uint32_t pcicr = data_memory_read(ICR);
+		const struct instruction* current = program_memory_decoded_ctx(context, i);
+		const uint16_t next_address = i + current->size;
+		const struct instruction* next = program_memory_decoded_ctx(context, next_address);
+		const uint16_t after_next_address = next_address + next->size;
+		const uint8_t op_code = current->op_code;
+		const uint8_t length = ends_block(current) || next_address >= PROGRAM_MEMORY_ADDRESS_WIDTH ||
+			context->block_cache[next_address].length == UINT8_MAX ? 1 : context->block_cache[next_address].length + 1;
+
+		context->block_cache[i].length = length;
+		context->block_cache[i].fused = SUPERINSTRUCTION_NONE;
 
-		if (read(pcifr, PCIFA) && read(pcicr, PCIEA))
+		if (next_address >= PROGRAM_MEMORY_ADDRESS_WIDTH) continue;
+
+		if (op_code == LDI && next->op_code == OUT)
+		{
+			context->block_cache[i].fused = SUPERINSTRUCTION_LDI_OUT;
+		}
+		else if (op_code == IN && next->op_code == ANDI)
+		{
+			const bool branch = after_next_address < PROGRAM_MEMORY_ADDRESS_WIDTH &&
+				is_branch(program_memory_decoded_ctx(context, after_next_address)->op_code);
+			context->block_cache[i].fused = branch ? SUPERINSTRUCTION_IN_ANDI_BRANCH : SUPERINSTRUCTION_IN_ANDI;
+		}
+		else if (op_code == ANDI && is_branch(next->op_code))
+		{
+			context->block_cache[i].fused = SUPERINSTRUCTION_ANDI_BRANCH;
+		}
+		else if ((op_code == CPI || op_code == CP) && is_branch(next->op_code))
 		{
-			data_memory_clear_bit(IFR, PCIFA);
-			generate_interrupt(PCINT_vect);
+			context->block_cache[i].fused = SUPERINSTRUCTION_COMPARE_BRANCH;
 		}
 	}
+
+	context->block_cache_revision = program_memory_revision_ctx(context);
 	return;
 }
 
 /********************************************************************************
-* generate_interrupt: Generates and interrupt by jumping to specified interrupt
-*                     vector. Before the jump, the return address is stored
-*                     on the stack and the I-flag in the status register is
-*                     cleared so that no new interrupts are generated while
-*                     the current interrupt is executed.
+* execute_branch: Executes specified conditional branch.
 *
-*                     - interrupt_vector: Jump address for generating interrupt.
+*                 - context: Reference to the CPU context.
+*                 - branch : The predecoded branch instruction.
 ********************************************************************************/
-static void generate_interrupt(const uint16_t interrupt_vector)
+static inline void execute_branch(struct cpu_context* context, const struct instruction* branch)
 {
-	stack_push(pc);
-	clr(sr, I);
-	pc = interrupt_vector;
+	switch (branch->op_code)
+	{
+		case BREQ: execute_breq(context, branch->op1, branch->op2); break;
+		case BRNE: execute_brne(context, branch->op1, branch->op2); break;
+		case BRGE: execute_brge(context, branch->op1, branch->op2); break;
+		case BRGT: execute_brgt(context, branch->op1, branch->op2); break;
+		case BRLE: execute_brle(context, branch->op1, branch->op2); break;
+		case BRLT: execute_brlt(context, branch->op1, branch->op2); break;
+	}
 	return;
 }
 
 /********************************************************************************
-* monitor_pcint0: Monitors pin change interrupts on I/O port B. All pins where
-*                 pin change monitoring is enabled (corresponding mask bit in
-*                 PCMSK0 i set) is monitored by comparing current input signal
-*                 with the previous one. If they don't match, the corresponding
-*                 interrupt flag PCIF0 in the PCIFR register i set to generate
-*                 an interrupt request (IRQ).
+* compare_branch_taken: Returns true if specified conditional branch is taken
+*                       after comparing specified values, i.e. after a - b.
+*                       The condition is evaluated from the values, since Z is
+*                       set exactly when a == b and S (= N ^ V) when a < b as
+*                       signed numbers, hence the status flags can be left
+*                       pending when evaluated lazily.
+*
+*                       - op_code: OP code of the branch (BREQ - BRLT).
+*                       - a      : First compared value.
+*                       - b      : Second compared value.
+********************************************************************************/
+static inline bool compare_branch_taken(const uint8_t op_code, const uint32_t a, const uint32_t b)
+{
+	switch (op_code)
+	{
+		case BREQ: return a == b;
+		case BRNE: return a != b;
+		case BRGE: return (int32_t)(a) >= (int32_t)(b);
+		case BRGT: return (int32_t)(a) > (int32_t)(b);
+		case BRLE: return (int32_t)(a) <= (int32_t)(b);
+		default:   return (int32_t)(a) < (int32_t)(b);
+	}
+}
+
+/********************************************************************************
+* execute_superinstruction: Executes specified superinstruction starting at
+*                           the address stored in mar. The program counter is
+*                           incremented past the fused instructions before they
+*                           are executed, just as when they are executed one
+*                           by one, so that taken branches aren't overwritten.
+*                           Likewise the number of retired instructions is
+*                           incremented after each of them, so that the timer
+*                           reads the same count.
+*
+*                           - context: Reference to the CPU context.
+*                           - fused  : The superinstruction to execute.
 ********************************************************************************/
-static inline void monitor_pcint(void)
+static inline void execute_superinstruction(struct cpu_context* context, const uint8_t fused)
 {
-	const uint32_t pina_current = data_memory_read(PINA);
-	const uint32_t pcmsk = data_memory_read(PCMSKA);
+	const struct instruction* first = program_memory_decoded_ctx(context, context->mar);
+	const struct instruction* second = program_memory_decoded_ctx(context, context->mar + first->size);
+
+	context->mar += first->size;   /* The last executed instruction is left as current. */
+	context->pc = context->mar + second->size;
+	context->instruction = second;
 
-	for (uint32_t i = 0; i < CPU_REGISTER_DATA_WIDTH; ++i)
+	switch (fused)
 	{
-		if (read(pcmsk, i))
+		case SUPERINSTRUCTION_LDI_OUT:
 		{
-			if (read(pina_current, i) != read(pina_previous, i))
-			{
-				data_memory_set_bit(IFR, PCIF0);
-				break;
-			}
+			execute_ldi(context, first->op1, first->op2);
+			context->instructions++;
+			execute_out(context, second->op1, second->op2);
+			context->instructions++;
+			break;
+		}
+		case SUPERINSTRUCTION_IN_ANDI:
+		{
+			execute_in(context, first->op1, first->op2);
+			context->instructions++;
+			execute_andi(context, second->op1, second->op2);
+			context->instructions++;
+			break;
+		}
+		case SUPERINSTRUCTION_IN_ANDI_BRANCH:
+		{
+			context->mar = context->pc;
+			context->instruction = program_memory_decoded_ctx(context, context->mar);
+			context->pc = context->mar + context->instruction->size;
+			execute_in(context, first->op1, first->op2);
+			context->instructions++;
+			execute_andi(context, second->op1, second->op2);
+			context->instructions++;
+			execute_branch(context, context->instruction);
+			context->instructions++;
+			break;
+		}
+		case SUPERINSTRUCTION_ANDI_BRANCH:
+		{
+			execute_andi(context, first->op1, first->op2);
+			context->instructions++;
+			execute_branch(context, second);
+			context->instructions++;
+			break;
+		}
+		case SUPERINSTRUCTION_COMPARE_BRANCH:
+		{
+			const uint32_t a = context->reg[first->op1];
+			const uint32_t b = first->op_code == CPI ? first->op2 : context->reg[first->op2];
+			(void)calculate(context, SUB, a, b); /* Only recorded if the flags are evaluated lazily. */
+			context->instructions++;
+			if (compare_branch_taken(second->op_code, a, b)) context->pc = second->op1;
+			context->instructions++;
+			break;
+		}
+	}
+	return;
+}
+
+/********************************************************************************
+* run_block: Runs the basic block starting at the address stored in the
+*            program counter, but no more than specified number of
+*            instructions. Fused instructions are executed as superinstructions
+*            if they fit within the block. The number of retired instructions
+*            is returned.
+*
+*            - context         : Reference to the CPU context.
+*            - max_instructions: Maximum number of instructions to run.
+********************************************************************************/
+static uint32_t run_block(struct cpu_context* context, const uint32_t max_instructions)
+{
+	uint32_t length = context->pc < PROGRAM_MEMORY_ADDRESS_WIDTH ? context->block_cache[context->pc].length : 1;
+	uint32_t retired = 0;
+	if (length > max_instructions) length = max_instructions;
+
+	while (retired < length)
+	{
+		const uint8_t fused = context->pc < PROGRAM_MEMORY_ADDRESS_WIDTH ? context->block_cache[context->pc].fused : SUPERINSTRUCTION_NONE;
+		context->mar = context->pc; /* Stores address of current instruction. */
+
+		if (fused != SUPERINSTRUCTION_NONE && retired + superinstruction_length(fused) <= length)
+		{
+			execute_superinstruction(context, fused);
+			retired += superinstruction_length(fused);
 		}
+		else
+		{
+			context->instruction = program_memory_decoded_ctx(context, context->pc);
+			context->pc += context->instruction->size;
+			execute(context);
+			context->instructions++;
+			retired++;
+		}
+	}
+	return retired;
+}
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+
+/********************************************************************************
+* control_unit_io_reset: Resets the I/O ports of the port backend and starts
+*                        the serial backend.
+********************************************************************************/
+static void control_unit_io_reset(struct cpu_context* context)
+{
+	port_reset_ctx(context);
+	serial_reset_ctx(context);
+	return;
+}
+
+/********************************************************************************
+* control_unit_io_update: Monitors pin change interrupts on I/O port A when the
+*                         port backend reports that the pins have changed,
+*                         and requests a UART_RX interrupt while received
+*                         bytes are waiting and RXCF isn't already set.
+*                         The port and UART registers themselves are
+*                         accessed through their I/O handlers in data
+*                         memory, so the backends are only touched when the
+*                         program accesses them.
+********************************************************************************/
+static void control_unit_io_update(struct cpu_context* context)
+{
+	if (port_changed_ctx(context) || context->pina_resync)
+	{
+		context->pina_resync = false;
+		pin_change(context, port_read_ctx(context));
+	}
+
+	if (uart_ring_count(&context->uart.rx) && !read(context->data_memory.data[IFR], RXCF))
+	{
+		interrupt_request_ctx(context, INTERRUPT_UART_RX);
+	}
+	return;
+}
+
+static inline void cpu_registers_clear(struct cpu_context* context)
+{
+	for (uint32_t* i = context->reg; i < context->reg + CPU_REGISTER_ADDRESS_WIDTH; ++i)
+	{
+		*i = 0x00;
+	}
+	return;
+}
+
+/********************************************************************************
+* check_for_timer: Updates the timer when the deadline of its next event has
+*                  been reached, so that its interrupt requests are raised.
+*                  Only a single comparison is needed between events.
+********************************************************************************/
+static inline void check_for_timer(struct cpu_context* context)
+{
+	if (context->instructions >= context->timer.deadline) timer_sync_ctx(context);
+	return;
+}
+
+/********************************************************************************
+* idle: Lets up to specified number of cycles pass while the CPU is sleeping,
+*       but no more than until the next timer event. Since nothing can wake
+*       the CPU before then, except for pin changes and received bytes,
+*       which the runner only applies between runs, the cycles are skipped
+*       in one step. A single
+*       cycle passes if an interrupt request is already pending, so that the
+*       interrupt is generated at the following check. If the timer is
+*       stopped, the port backend may wait for a pin change or a received
+*       byte first. The cycles are counted as retired instructions, so that
+*       the timer and the stimulus keep their time base. The number of
+*       cycles is returned.
+*
+*       - context   : Reference to the CPU context.
+*       - max_cycles: Maximum number of cycles to let pass.
+********************************************************************************/
+static uint32_t idle(struct cpu_context* context, const uint32_t max_cycles)
+{
+	uint32_t cycles = max_cycles;
+
+	if (context->irq_pending)
+	{
+		cycles = 1;
+	}
+	else if (context->timer.deadline == UINT64_MAX)
+	{
+		port_idle_ctx(context);
+	}
+	else if (context->timer.deadline - context->instructions < cycles)
+	{
+		cycles = (uint32_t)(context->timer.deadline - context->instructions);
+	}
+
+	if (cycles == 0) cycles = 1;
+	context->instructions += cycles;
+	return cycles;
+}
+
+/********************************************************************************
+* check_for_irq: Checks for interrupt requests and generates an interrupt if
+*                any interrupt source is both flagged in IFR and enabled in
+*                ICR while the I flag in the status register is set. These
+*                conditions are kept up to date by the interrupt controller
+*                in irq_pending, hence only a single test is needed when no
+*                interrupt is requested.
+********************************************************************************/
+static inline void check_for_irq(struct cpu_context* context)
+{
+	if (context->irq_pending) generate_interrupt(context);
+	return;
+}
+
+/********************************************************************************
+* generate_interrupt: Generates an interrupt for the pending request with
+*                     highest priority. The flag of the request is cleared to
+*                     terminate it (otherwise the interrupt would be generated
+*                     again and again), the return address is stored on the
+*                     stack and the I-flag in the status register is cleared
+*                     so that no new interrupts are generated while the
+*                     current interrupt is executed. A jump is then made to
+*                     the corresponding interrupt vector, such as PCINT_vect.
+*
+*                     - context: Reference to the CPU context.
+********************************************************************************/
+static void generate_interrupt(struct cpu_context* context)
+{
+	const uint16_t interrupt_vector = interrupt_acknowledge_ctx(context);
+
+	update_flags(context); /* The status register is exact when the interrupt is entered. */
+	stack_push_ctx(context, context->pc);
+	clr(context->sr, I);
+	context->irq_pending = 0x00;
+	context->sleeping = false; /* The interrupt wakes the CPU. */
+	context->pc = interrupt_vector;
+	return;
+}
+
+/********************************************************************************
+* pin_change: Monitors pin change interrupts on I/O port A when new input
+*             values have been read. The pins that changed are found by
+*             comparing the new input values with the previous ones. If any
+*             of them has pin change monitoring enabled (corresponding mask
+*             bit in PCMSKA is set), the interrupt flag PCIFA in the IFR
+*             register is set to generate an interrupt request (IRQ).
+*
+*             - context: Reference to the CPU context.
+*             - pina   : The new input values of I/O port A.
+********************************************************************************/
+static inline void pin_change(struct cpu_context* context, const uint32_t pina)
+{
+	if ((pina ^ context->pina_previous) & data_memory_read_ctx(context, PCMSKA))
+	{
+		data_memory_set_bit_ctx(context, IFR, PCIFA);
 	}
 
-	pina_previous = pina_current;
+	context->pina_previous = pina;
 	return;
 }
 
-static inline void return_from_interrupt(void)
+static inline void return_from_interrupt(struct cpu_context* context)
 {
-	pc = stack_pop();
-	set(sr, I);
+	context->pc = stack_pop_ctx(context);
+	set(context->sr, I);
 	return;
 }
\ No newline at end of file
@@ -10,17 +10,134 @@
 #include "program_memory.h"
 #include "data_memory.h"
 #include "stack.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "uart.h"
 #include "alu.h"
+#include "port.h"
+#include "serial.h"
+
+/* Macro definitions: */
+#define CONTROL_UNIT_DISPATCH_SWITCH 0 /* Dispatches instructions through a switch statement. */
+#define CONTROL_UNIT_DISPATCH_TABLE  1 /* Dispatches instructions through a handler table. */
+
+/********************************************************************************
+* CONTROL_UNIT_DISPATCH: Selects the dispatch engine used to execute decoded
+*                        instructions. Can be overridden at build time, for
+*                        instance -DCONTROL_UNIT_DISPATCH=1 to benchmark the
+*                        handler table against the switch statement.
+********************************************************************************/
+#ifndef CONTROL_UNIT_DISPATCH
+#define CONTROL_UNIT_DISPATCH CONTROL_UNIT_DISPATCH_SWITCH
+#endif
+
+/********************************************************************************
+* CONTROL_UNIT_BLOCK_CACHE: Runs whole basic blocks with fused superinstructions
+*                           in control_unit_run when set to 1, so that I/O
+*                           synchronization and interrupt monitoring are only
+*                           done at block exits. Blocks end after writes to
+*                           the I/O registers, SEI and CLI and are cut at the
+*                           next timer event, so the program behaves exactly
+*                           as with 0, where they are done after every
+*                           instruction instead. Disabled by default when
+*                           instructions are predecoded when read, as on the
+*                           AVR, since the cache needs one entry per address
+*                           and is built from the whole predecoded program.
+********************************************************************************/
+#ifndef CONTROL_UNIT_BLOCK_CACHE
+#if PROGRAM_MEMORY_DECODE_CACHE
+#define CONTROL_UNIT_BLOCK_CACHE 0
+#else
+#define CONTROL_UNIT_BLOCK_CACHE 1
+#endif
+#endif
+
+/********************************************************************************
+* CONTROL_UNIT_LAZY_FLAGS: Evaluates the status flags SNZVC lazily when set to
+*                          1, i.e. the last ALU operation is recorded and the
+*                          flags are only calculated when they are needed, for
+*                          instance by a conditional branch. Set to 0 to update
+*                          the flags after every ALU operation, which can be
+*                          used as reference for differential testing.
+********************************************************************************/
+#ifndef CONTROL_UNIT_LAZY_FLAGS
+#define CONTROL_UNIT_LAZY_FLAGS 1
+#endif
+
+/********************************************************************************
+* CONTROL_UNIT_MEMORY_CHUNK: Maximum number of words copied or filled by a
+*                            single execution of MEMCPY or MEMSET. Longer
+*                            blocks are handled chunk by chunk, with the
+*                            instruction run again for the rest, so that
+*                            interrupts are generated in between and the
+*                            interrupt latency stays bounded.
+********************************************************************************/
+#ifndef CONTROL_UNIT_MEMORY_CHUNK
+#define CONTROL_UNIT_MEMORY_CHUNK 32
+#endif
+
+/********************************************************************************
+* control_unit_reset_ctx: Resets control unit of specified context and
+*                         corresponding program.
+*
+*                         - context: Reference to the CPU context.
+********************************************************************************/
+void control_unit_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* control_unit_run_next_state_ctx: Runs next state in the CPU instruction cycle
+*                                  of specified context.
+*
+*                                  - context: Reference to the CPU context.
+********************************************************************************/
+void control_unit_run_next_state_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* control_unit_run_ctx: Runs up to specified number of whole instructions in
+*                       specified context, where each instruction is fetched,
+*                       decoded and executed in one go. I/O synchronization and
+*                       interrupt monitoring are only done at instruction
+*                       boundaries (or at basic block exits if
+*                       CONTROL_UNIT_BLOCK_CACHE is set), which makes this mode
+*                       much faster than stepping through the instruction cycle
+*                       with control_unit_run_next_state_ctx. The number of
+*                       retired instructions is returned.
+*
+*                       - context         : Reference to the CPU context.
+*                       - max_instructions: Maximum number of instructions to run.
+********************************************************************************/
+uint32_t control_unit_run_ctx(struct cpu_context* context,
+                              const uint32_t max_instructions);
+
+/********************************************************************************
+* control_unit_reset: Resets control unit of the default context and
+*                     corresponding program.
+********************************************************************************/
+static inline void control_unit_reset(void)
+{
+	control_unit_reset_ctx(&cpu_context_default);
+}
 
 /********************************************************************************
-* control_unit_reset: Resets control unit and corresponding program.
+* control_unit_run_next_state: Runs next state in the CPU instruction cycle of
+*                              the default context.
 ********************************************************************************/
-void control_unit_reset(void);
+static inline void control_unit_run_next_state(void)
+{
+	control_unit_run_next_state_ctx(&cpu_context_default);
+}
 
 /********************************************************************************
-* control_unit_run_next_state: Runs next state in the CPU instruction cycle.
+* control_unit_run: Runs up to specified number of whole instructions in the
+*                   default context, see control_unit_run_ctx. The number of
+*                   retired instructions is returned.
+*
+*                   - max_instructions: Maximum number of instructions to run.
 ********************************************************************************/
-void control_unit_run_next_state(void);
+static inline uint32_t control_unit_run(const uint32_t max_instructions)
+{
+	return control_unit_run_ctx(&cpu_context_default, max_instructions);
+}
 
 
 #endif /* CONTROL_UNIT_H_ */
\ No newline at end of file
@@ -7,7 +7,6 @@
 
 /* Include directives: */
 #include <stdio.h>
-#include <avr/io.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -56,20 +55,60 @@
 #define LDIO 0x27 /* Reads from referenced I/O location in data memory (address 0 - 255). */
 #define ST   0x28 /* Writes to referenced location in data memory. (address 256 - 1999). */
 #define LD   0x29 /* Reads from referenced location in data memory (address 256 - 1999). */
-
-#define RESET_vect  0x00 /* Reset vector. */
-#define PCINT_vect 0x02 /* Pin change interrupt vector (for I/O port A). */
+#define SLEEP 0x2A /* Halts execution until an interrupt is generated. */
+#define MEMCPY 0x2B /* Copies a block of words in data memory (destination, length and source in CPU registers). */
+#define MEMSET 0x2C /* Fills a block of words in data memory (destination, length and value in CPU registers). */
+#define MUL  0x2D /* Multiplies content of a CPU register with content in another, keeps the low word. */
+#define MULH 0x2E /* Multiplies content of a CPU register with content in another, keeps the signed high word. */
+#define DIV  0x2F /* Divides content of a CPU register by content in another (signed). */
+#define MOD  0x30 /* Calculates the remainder of content of a CPU register divided by content in another (signed). */
+
+#define LSLV 0x31 /* Shifts content of a CPU register left by the count in another. */
+#define LSRV 0x32 /* Shifts content of a CPU register right by the count in another. */
+#define ASR  0x33 /* Shifts content of a CPU register right by the count in another, keeping the sign. */
+#define ROL  0x34 /* Rotates content of a CPU register left by the count in another. */
+#define ROR  0x35 /* Rotates content of a CPU register right by the count in another. */
+
+#define ILLEGAL 0x36 /* Not an instruction, unknown OP codes are predecoded to this value. */
+
+#define RESET_vect       0x00 /* Reset vector. */
+#define PCINT_vect       0x02 /* Pin change interrupt vector (for I/O port A). */
+#define TIMER_OVF_vect   0x04 /* Timer overflow interrupt vector. */
+#define TIMER_COMPA_vect 0x06 /* Timer compare match A interrupt vector. */
+#define SWI_vect         0x08 /* Software interrupt vector. */
+#define UART_RX_vect     0x0A /* UART receive complete interrupt vector. */
 
 #define DDRA  0x00 /* Data direction register for I/O port A. */
 #define PORTA 0x01 /* Data register for I/O port A. */
 #define PINA  0x02 /* Pin input register for I/O port A. */
 
-#define ICR 0x03 /* Pin change interrupt control register for all I/O ports. */
-#define IFR 0x04 /* Pin change interrupt flag register for all I/O ports. */
+#define ICR 0x03 /* Interrupt control register, holds the enable bit of each interrupt source. */
+#define IFR 0x04 /* Interrupt flag register, holds the flag bit of each interrupt source. */
 
 #define PCMSKA 0x05 /* Pin change interrupt mask register for I/O port A. */
 #define PCIEA 0 /* Pin change interrupt enable bit for I/O port A. */
 #define PCIFA 0 /* Pin change interrupt flag bit for I/O port A. */
+#define TOIE  1 /* Timer overflow interrupt enable bit. */
+#define TOV   1 /* Timer overflow interrupt flag bit. */
+#define OCIEA 2 /* Timer compare match A interrupt enable bit. */
+#define OCFA  2 /* Timer compare match A interrupt flag bit. */
+#define SWIE  3 /* Software interrupt enable bit. */
+#define SWIF  3 /* Software interrupt flag bit, set by the program to request the interrupt. */
+#define RXCIE 4 /* UART receive complete interrupt enable bit. */
+#define RXCF  4 /* UART receive complete interrupt flag bit. */
+
+#define TCCR 0x06 /* Timer control register, holds the clock select bits and the CTC bit. */
+#define TCNT 0x07 /* Timer counter register. */
+#define OCRA 0x08 /* Timer output compare register A. */
+#define CS0  0    /* Timer clock select bit 0. */
+#define CS1  1    /* Timer clock select bit 1. */
+#define CS2  2    /* Timer clock select bit 2. */
+#define CTC  3    /* Clears the timer counter on compare match A when set. */
+
+#define UDR  0x09 /* UART data register, written to transmit a byte and read to take a received byte. */
+#define USR  0x0A /* UART status register (read only). */
+#define RXC  0    /* Set while received bytes are waiting in UDR. */
+#define UDRE 1    /* Set while there's room to write another byte to UDR. */
 
 #define PORTA0 0 /* Bit number for pin 0 at I/O port D. */
 #define PORTA1 1 /* Bit number for pin 1 at I/O port D. */
@@ -146,7 +185,7 @@
 *      - reg: Reference to the register.
 *      - bit: The bit to be set in the referenced register.
 ********************************************************************************/
-#define set(reg, bit)  reg |= (1 << bit)
+#define set(reg, bit)  reg |= (1UL << (bit))
 
 /********************************************************************************
 * clr: Clears bit in specified register without affecting other bits.
@@ -154,18 +193,19 @@
 *      - reg: Reference to the register.
 *      - bit: The bit to be cleared in the referenced register.
 ********************************************************************************/
-#define clr(reg, bit)  reg &= ~(1 << (bit))
+#define clr(reg, bit)  reg &= ~(1UL << (bit))
 
 /********************************************************************************
 * read: Reads bit from specified register. The return value is 1 is the bit is
-*       high, otherwise 0 if the bit is low.
+*       high, otherwise 0 if the bit is low. The mask is an unsigned long, so
+*       that all 32 bits can be read also where int is 16 bits wide.
 *
 *       - reg: Reference to the register.
 *       - bit: The bit to be read in the referenced register.
 ********************************************************************************/
 static inline bool read(const uint32_t reg, const uint8_t bit)
 {
-	return (bool)(reg & (1 << bit));
+	return (bool)(reg & (1UL << bit));
 }
 
 /********************************************************************************
@@ -178,4 +218,14 @@ enum cpu_state
    CPU_STATE_EXECUTE /* Executes the decoded instruction. */
 };
 
+/********************************************************************************
+* cpu_context: Complete state of a CPU instance (registers, program memory,
+*              data memory and stack), see cpu_context.h. Functions with the
+*              suffix _ctx operate on the specified context, while the
+*              corresponding functions without the suffix operate on the
+*              default context cpu_context_default.
+********************************************************************************/
+struct cpu_context;
+extern struct cpu_context cpu_context_default; /* Context of the ordinary CPU instance. */
+
 #endif /* CPU_H_ */
\ No newline at end of file
@@ -0,0 +1,58 @@
+/********************************************************************************
+* cpu_context.c: Contains the default CPU context, which is used by all
+*                functions without the suffix _ctx, and initialization of
+*                additional contexts.
+********************************************************************************/
+#include "cpu_context.h"
+
+#ifdef __AVR__
+/********************************************************************************
+* The default context and its program memory are the bulk of the 2 kB SRAM of
+* the ATmega328P. At least 256 bytes must be left for the other static
+* variables and the call stack. With the AVR defaults they take 1762 bytes:
+* 1204 for the data memory, 133 for the stack, 128 for the registers, 50 for
+* the instruction cache, 36 for the UART rings, 77 for the remaining members
+* and 134 for the program memory.
+********************************************************************************/
+_Static_assert(sizeof(struct cpu_context) + sizeof(struct program_memory) <= 2048 - 256,
+               "The default CPU context doesn't fit in the SRAM of the ATmega328P!");
+#endif /* __AVR__ */
+
+/* Static variables: */
+static struct program_memory program_memory_default; /* Program memory of the default context. */
+
+/* Global variables: */
+struct cpu_context cpu_context_default = /* Context of the ordinary CPU instance. */
+{
+	.program_memory = &program_memory_default
+};
+
+/********************************************************************************
+* cpu_context_init: Initializes specified context to run the program stored in
+*                   the referenced program memory, with the I/O ports
+*                   simulated by the referenced port backend state. The
+*                   control unit must be reset before the context is run.
+*                   The context uses the default state of the serial
+*                   backend until its member serial is set.
+*
+*                   - context       : Reference to the CPU context.
+*                   - program_memory: Reference to the program memory to run.
+*                   - port          : State of the port backend, 0 for the
+*                                     default state shared by all contexts.
+********************************************************************************/
+void cpu_context_init(struct cpu_context* context,
+                      struct program_memory* program_memory,
+                      void* port)
+{
+	context->program_memory = program_memory;
+	context->port = port;
+	context->serial = 0;
+	context->state = CPU_STATE_FETCH;
+#if PROGRAM_MEMORY_DECODE_CACHE
+	context->program_cache.revision = program_memory->revision - 1; /* Invalidates the cache before first read. */
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+#if CONTROL_UNIT_BLOCK_CACHE
+	context->block_cache_revision = program_memory->revision - 1; /* Forces a build before first run. */
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+	return;
+}
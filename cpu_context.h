@@ -0,0 +1,105 @@
+/********************************************************************************
+* cpu_context.h: Contains the definition of the CPU context, which holds the
+*                complete state of a CPU instance. Several contexts can be run
+*                independently of each other, since the control unit, program
+*                memory, data memory and stack don't keep any state of their
+*                own.
+********************************************************************************/
+#ifndef CPU_CONTEXT_H_
+#define CPU_CONTEXT_H_
+
+/* Include directives: */
+#include "control_unit.h"
+
+#if CONTROL_UNIT_LAZY_FLAGS
+/********************************************************************************
+* lazy_flags: Record of the last ALU operation, from which the status flags
+*             SNZVC are calculated when they are needed.
+********************************************************************************/
+struct lazy_flags
+{
+	uint8_t operation; /* The performed operation (OR, AND, XOR, ADD or SUB). */
+	uint32_t a;        /* First operand. */
+	uint32_t b;        /* Second operand. */
+	uint32_t result;   /* Result of the calculation. */
+	bool pending;      /* Indicates if the flags haven't been calculated yet. */
+};
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+
+struct cpu_snapshot;
+
+#if CONTROL_UNIT_BLOCK_CACHE
+/********************************************************************************
+* block_entry: Basic block cache entry for an address in program memory.
+********************************************************************************/
+struct block_entry
+{
+	uint8_t length; /* Number of instructions left until the end of the block. */
+	uint8_t fused;  /* Superinstruction starting at this address. */
+};
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+
+/********************************************************************************
+* cpu_context: Complete state of a CPU instance.
+********************************************************************************/
+struct cpu_context
+{
+	uint32_t ir;  /* Instruction register, stores next instruction to execute. */
+	uint16_t pc;  /* Program counter, stores address to next instruction to fetch. */
+	uint32_t mar; /* Memory address register, stores address of current instruction. */
+	uint8_t sr;   /* Status register, stores status bits ISNZVC. */
+
+	const struct instruction* instruction; /* Decoded instruction, stores OP code and operands. */
+
+	enum cpu_state state;                    /* Stores current state. */
+	uint32_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU-registers R0 - R31. */
+
+	uint32_t irq_pending;   /* Flagged and enabled interrupt sources, 0 while the I flag is cleared. */
+	uint64_t instructions;  /* Number of instructions retired since reset, clocks the timer. */
+	bool sleeping;          /* Indicates if execution is halted by SLEEP until an interrupt. */
+	struct timer timer;     /* State of the timer peripheral. */
+	struct uart uart;       /* State of the UART peripheral. */
+	uint32_t pina_previous; /* Stores previous input values of PINA (for monitoring). */
+	bool pina_resync;       /* Forces PINA to be read from the port backend at the next I/O update. */
+
+#if CONTROL_UNIT_LAZY_FLAGS
+	struct lazy_flags lazy_flags; /* Last ALU operation, if flags are pending. */
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+
+#if CONTROL_UNIT_BLOCK_CACHE
+	struct block_entry block_cache[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* Basic block cache. */
+	uint16_t block_cache_revision; /* Program memory revision the block cache was built from. */
+#endif /* CONTROL_UNIT_BLOCK_CACHE */
+
+#if PROGRAM_MEMORY_DECODE_CACHE
+	struct program_memory_cache program_cache; /* Instruction cache of this context. */
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+
+	struct program_memory* program_memory; /* Program memory, may be shared with other contexts. */
+	struct data_memory data_memory;        /* Data memory with the I/O registers. */
+	struct stack stack;                    /* Stack for return addresses. */
+	void* port;                            /* State of the port backend, 0 for the default state. */
+	void* serial;                          /* State of the serial backend, 0 for the default state. */
+
+	const struct cpu_snapshot* snapshot; /* Snapshot the dirty ranges refer to, if any. */
+	uint32_t snapshot_revision;          /* Revision of the snapshot the dirty ranges refer to. */
+};
+
+/********************************************************************************
+* cpu_context_init: Initializes specified context to run the program stored in
+*                   the referenced program memory, with the I/O ports
+*                   simulated by the referenced port backend state. The
+*                   program memory is only referenced, so several contexts
+*                   can share the same program without copying it. The
+*                   control unit must be reset before the context is run.
+*
+*                   - context       : Reference to the CPU context.
+*                   - program_memory: Reference to the program memory to run.
+*                   - port          : State of the port backend, 0 for the
+*                                     default state shared by all contexts.
+********************************************************************************/
+void cpu_context_init(struct cpu_context* context,
+                      struct program_memory* program_memory,
+                      void* port);
+
+#endif /* CPU_CONTEXT_H_ */
\ No newline at end of file
@@ -0,0 +1,190 @@
+/********************************************************************************
+* cpu_snapshot.c: Contains function definitions for saving and restoring the
+*                 complete machine state of a CPU context.
+********************************************************************************/
+#include "cpu_snapshot.h"
+#include "port.h"
+#include <string.h>
+
+/* Static functions: */
+static inline bool tracked(const struct cpu_context* context,
+                           const struct cpu_snapshot* snapshot);
+static void clear_dirty(struct cpu_context* context,
+                        const struct cpu_snapshot* snapshot);
+static void copy_data(const struct cpu_context* context,
+                      uint32_t* destination,
+                      const uint32_t* source,
+                      const bool incremental);
+
+/********************************************************************************
+* cpu_snapshot_save_ctx: Saves the machine state of specified context to the
+*                        referenced snapshot. If the context was last saved to
+*                        or restored from the same revision of the snapshot,
+*                        only the dirty pages of the data memory and the
+*                        dirty range of the stack are copied, otherwise all
+*                        of it.
+*
+*                        - context : Reference to the CPU context.
+*                        - snapshot: Reference to the snapshot.
+********************************************************************************/
+void cpu_snapshot_save_ctx(struct cpu_context* context,
+                           struct cpu_snapshot* snapshot)
+{
+   const struct stack* stack = &context->stack;
+   const bool incremental = tracked(context, snapshot);
+   const uint16_t stack_low = incremental ? stack->dirty_low : 0;
+
+   snapshot->ir = context->ir;
+   snapshot->pc = context->pc;
+   snapshot->mar = context->mar;
+   snapshot->sr = context->sr;
+   snapshot->state = context->state;
+   snapshot->pina_previous = context->pina_previous;
+   snapshot->instructions = context->instructions;
+   snapshot->sleeping = context->sleeping;
+   snapshot->timer = context->timer;
+#if CONTROL_UNIT_LAZY_FLAGS
+   snapshot->lazy_flags = context->lazy_flags;
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+
+   for (uint8_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+   {
+      snapshot->reg[i] = context->reg[i];
+   }
+
+   copy_data(context, snapshot->data, context->data_memory.data, incremental);
+
+   for (uint16_t i = stack_low; i < STACK_ADDRESS_WIDTH; ++i)
+   {
+      snapshot->stack[i] = stack->data[i];
+   }
+
+   snapshot->sp = stack->sp;
+   snapshot->stack_empty = stack->empty;
+   snapshot->revision++;
+   clear_dirty(context, snapshot);
+   return;
+}
+
+/********************************************************************************
+* cpu_snapshot_restore_ctx: Restores the machine state of specified context
+*                           from the referenced snapshot. If the context was
+*                           last saved to or restored from the same revision
+*                           of the snapshot, only the dirty pages of the data
+*                           memory and the dirty range of the stack are
+*                           copied, otherwise all of it.
+*                           The decoded instruction is read again from program
+*                           memory and the restored data direction and output
+*                           values are written to the port backend.
+*
+*                           - context : Reference to the CPU context.
+*                           - snapshot: Reference to the snapshot.
+********************************************************************************/
+void cpu_snapshot_restore_ctx(struct cpu_context* context,
+                              const struct cpu_snapshot* snapshot)
+{
+   struct data_memory* data_memory = &context->data_memory;
+   struct stack* stack = &context->stack;
+   const bool incremental = tracked(context, snapshot);
+   const uint16_t stack_low = incremental ? stack->dirty_low : 0;
+
+   context->ir = snapshot->ir;
+   context->pc = snapshot->pc;
+   context->mar = snapshot->mar;
+   context->sr = snapshot->sr;
+   context->state = snapshot->state;
+   context->pina_previous = snapshot->pina_previous;
+   context->instructions = snapshot->instructions;
+   context->sleeping = snapshot->sleeping;
+   context->timer = snapshot->timer;
+   context->pina_resync = true;
+#if CONTROL_UNIT_LAZY_FLAGS
+   context->lazy_flags = snapshot->lazy_flags;
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+
+   for (uint8_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+   {
+      context->reg[i] = snapshot->reg[i];
+   }
+
+   copy_data(context, data_memory->data, snapshot->data, incremental);
+
+   for (uint16_t i = stack_low; i < STACK_ADDRESS_WIDTH; ++i)
+   {
+      stack->data[i] = snapshot->stack[i];
+   }
+
+   stack->sp = snapshot->sp;
+   stack->empty = snapshot->stack_empty;
+   context->instruction = program_memory_decoded_ctx(context, context->mar);
+   interrupt_update_ctx(context);
+   port_write_ctx(context, data_memory->data[DDRA], data_memory->data[PORTA]);
+   clear_dirty(context, snapshot);
+   return;
+}
+
+/********************************************************************************
+* tracked: Indicates if the dirty ranges of specified context refer to the
+*          current revision of specified snapshot, i.e. if all words outside
+*          the dirty pages and ranges are equal to the snapshot.
+*
+*          - context : Reference to the CPU context.
+*          - snapshot: Reference to the snapshot.
+********************************************************************************/
+static inline bool tracked(const struct cpu_context* context,
+                           const struct cpu_snapshot* snapshot)
+{
+   return context->snapshot == snapshot && context->snapshot_revision == snapshot->revision;
+}
+
+/********************************************************************************
+* clear_dirty: Clears the dirty pages and ranges of specified context, which
+*              from now on refer to the current revision of specified
+*              snapshot.
+*
+*              - context : Reference to the CPU context.
+*              - snapshot: Reference to the snapshot.
+********************************************************************************/
+static void clear_dirty(struct cpu_context* context,
+                        const struct cpu_snapshot* snapshot)
+{
+   data_memory_clear_dirty_ctx(context);
+   context->stack.dirty_low = STACK_ADDRESS_WIDTH;
+   context->snapshot = snapshot;
+   context->snapshot_revision = snapshot->revision;
+   return;
+}
+
+/********************************************************************************
+* copy_data: Copies data memory words of specified context between the context
+*            and a snapshot. Only the dirty pages are copied if incremental is
+*            set, otherwise the entire data memory.
+*
+*            - context    : Reference to the CPU context.
+*            - destination: Reference to the words to copy to.
+*            - source     : Reference to the words to copy from.
+*            - incremental: Indicates if only the dirty pages are copied.
+********************************************************************************/
+static void copy_data(const struct cpu_context* context,
+                      uint32_t* destination,
+                      const uint32_t* source,
+                      const bool incremental)
+{
+   if (incremental)
+   {
+      uint16_t pages[DATA_MEMORY_PAGES];
+      const uint16_t count = data_memory_dirty_pages_ctx(context, pages);
+
+      for (uint16_t i = 0; i < count; ++i)
+      {
+         const uint16_t address = data_memory_page_address(pages[i]);
+         memcpy(destination + address, source + address,
+                data_memory_page_length(pages[i]) * sizeof(uint32_t));
+      }
+   }
+   else
+   {
+      memcpy(destination, source, DATA_MEMORY_ADDRESS_WIDTH * sizeof(uint32_t));
+   }
+   return;
+}
@@ -0,0 +1,102 @@
+/********************************************************************************
+* cpu_snapshot.h: Contains function declarations for saving and restoring the
+*                 complete machine state of a CPU context, for instance to
+*                 boot the program once and then run many input scenarios
+*                 from the same checkpoint.
+*
+*                 The data memory records which pages and the stack which
+*                 words have been written since the context was last saved
+*                 to or restored from a snapshot. When the context is saved
+*                 to or restored from the same snapshot again, only those
+*                 are copied, hence restoring after a short run is cheap.
+*                 Otherwise, for instance when a snapshot is restored into
+*                 another context for the first time, everything is copied.
+*
+*                 The program memory and the state of the port and serial
+*                 backends, such as the position in a stimulus file or the
+*                 bytes buffered by the UART, aren't part of the snapshot.
+*                 The restored data direction and output values of I/O port
+*                 A are written to the port backend on restore.
+********************************************************************************/
+#ifndef CPU_SNAPSHOT_H_
+#define CPU_SNAPSHOT_H_
+
+/* Include directives: */
+#include "cpu_context.h"
+
+/********************************************************************************
+* cpu_snapshot: Saved machine state of a CPU context.
+********************************************************************************/
+struct cpu_snapshot
+{
+   uint32_t ir;          /* Instruction register. */
+   uint16_t pc;          /* Program counter. */
+   uint32_t mar;         /* Memory address register. */
+   uint8_t sr;           /* Status register. */
+   enum cpu_state state; /* Current state of the instruction cycle. */
+
+   uint32_t reg[CPU_REGISTER_ADDRESS_WIDTH]; /* CPU-registers R0 - R31. */
+   uint32_t pina_previous;                   /* Previous input values of PINA. */
+   uint64_t instructions;                    /* Instructions retired since reset. */
+   bool sleeping;                            /* Indicates if execution is halted by SLEEP. */
+   struct timer timer;                       /* State of the timer peripheral. */
+
+#if CONTROL_UNIT_LAZY_FLAGS
+   struct lazy_flags lazy_flags; /* Last ALU operation, if flags are pending. */
+#endif /* CONTROL_UNIT_LAZY_FLAGS */
+
+   uint32_t data[DATA_MEMORY_ADDRESS_WIDTH]; /* Content of the data memory. */
+   uint32_t stack[STACK_ADDRESS_WIDTH];      /* Content of the stack. */
+   uint16_t sp;                              /* Stack pointer. */
+   bool stack_empty;                         /* Indicates if the stack is empty. */
+
+   uint32_t revision; /* Incremented every time the snapshot is saved. */
+};
+
+/********************************************************************************
+* cpu_snapshot_save_ctx: Saves the machine state of specified context to the
+*                        referenced snapshot. If the context was last saved to
+*                        or restored from the same snapshot, only the words
+*                        written since then are copied.
+*
+*                        - context : Reference to the CPU context.
+*                        - snapshot: Reference to the snapshot.
+********************************************************************************/
+void cpu_snapshot_save_ctx(struct cpu_context* context,
+                           struct cpu_snapshot* snapshot);
+
+/********************************************************************************
+* cpu_snapshot_restore_ctx: Restores the machine state of specified context
+*                           from the referenced snapshot. If the context was
+*                           last saved to or restored from the same snapshot,
+*                           only the words written since then are copied.
+*
+*                           - context : Reference to the CPU context.
+*                           - snapshot: Reference to the snapshot.
+********************************************************************************/
+void cpu_snapshot_restore_ctx(struct cpu_context* context,
+                              const struct cpu_snapshot* snapshot);
+
+/********************************************************************************
+* cpu_snapshot_save: Saves the machine state of the default context to the
+*                    referenced snapshot, see cpu_snapshot_save_ctx.
+*
+*                    - snapshot: Reference to the snapshot.
+********************************************************************************/
+static inline void cpu_snapshot_save(struct cpu_snapshot* snapshot)
+{
+   cpu_snapshot_save_ctx(&cpu_context_default, snapshot);
+}
+
+/********************************************************************************
+* cpu_snapshot_restore: Restores the machine state of the default context from
+*                       the referenced snapshot, see cpu_snapshot_restore_ctx.
+*
+*                       - snapshot: Reference to the snapshot.
+********************************************************************************/
+static inline void cpu_snapshot_restore(const struct cpu_snapshot* snapshot)
+{
+   cpu_snapshot_restore_ctx(&cpu_context_default, snapshot);
+}
+
+#endif /* CPU_SNAPSHOT_H_ */
@@ -2,40 +2,117 @@
 * data_memory.c: Contains function definitions for implementation of a 
 *                2 kB memory.
 ********************************************************************************/
-#include "data_memory.h"
+#include "cpu_context.h"
+#include <string.h>
 
 /********************************************************************************
-* data: Data memory with storage capacity for 2000 bytes.
+* io_handler: Handlers of a memory-mapped I/O register. The write handler is
+*             called in place of the plain store and must store the value
+*             itself, so that it can act both before and after the store. The
+*             read handler returns the value of the register in place of the
+*             stored content and may modify the context, for instance to
+*             consume a received byte. Either handler can be 0 for plain
+*             memory access.
 ********************************************************************************/
-static uint32_t data[DATA_MEMORY_ADDRESS_WIDTH]; 
+typedef uint32_t (*io_read_handler)(struct cpu_context* context, const uint16_t address);
+typedef void (*io_write_handler)(struct cpu_context* context, const uint16_t address, const uint32_t value);
+
+struct io_handler
+{
+   io_read_handler read;
+   io_write_handler write;
+};
+
+/* Static functions: */
+static uint32_t read_port(struct cpu_context* context, const uint16_t address);
+static void write_port(struct cpu_context* context, const uint16_t address, const uint32_t value);
+static void write_interrupt(struct cpu_context* context, const uint16_t address, const uint32_t value);
+static uint32_t read_timer(struct cpu_context* context, const uint16_t address);
+static void write_timer(struct cpu_context* context, const uint16_t address, const uint32_t value);
+static uint32_t read_uart(struct cpu_context* context, const uint16_t address);
+static void write_uart(struct cpu_context* context, const uint16_t address, const uint32_t value);
+static inline io_read_handler read_handler(const uint16_t address);
+static inline io_write_handler write_handler(const uint16_t address);
+static inline void mark_dirty(struct data_memory* self, const uint32_t address, const uint32_t count);
+#if DATA_MEMORY_DIRTY_TRACKING
+static void list_pages(const uint32_t* bitmap, uint16_t* pages, uint16_t* count);
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
 
 /********************************************************************************
-* data_memory_reset: Clears entire data memory.
+* io_handlers: Handlers of the memory-mapped I/O registers, indexed by
+*              address. Peripherals are added by registering their handlers
+*              here. Registers without handlers are plain memory. The table
+*              is stored in flash on the AVR, see read_handler and
+*              write_handler.
 ********************************************************************************/
-void data_memory_reset(void)
+static const struct io_handler io_handlers[DATA_MEMORY_IO_WIDTH] PROGMEM =
+{
+   [DDRA]  = { 0, write_port },
+   [PORTA] = { 0, write_port },
+   [PINA]  = { read_port, 0 },
+   [ICR]   = { 0, write_interrupt },
+   [IFR]   = { 0, write_interrupt },
+   [TCCR]  = { 0, write_timer },
+   [TCNT]  = { read_timer, write_timer },
+   [OCRA]  = { 0, write_timer },
+   [UDR]   = { read_uart, write_uart },
+   [USR]   = { read_uart, 0 }
+};
+
+/********************************************************************************
+* data_memory_reset_ctx: Clears entire data memory of specified context.
+*
+*                        - context: Reference to the CPU context.
+********************************************************************************/
+void data_memory_reset_ctx(struct cpu_context* context)
 {
    for (uint16_t i = 0; i < DATA_MEMORY_ADDRESS_WIDTH; ++i)
    {
-      data[i] = 0x00;
+      context->data_memory.data[i] = 0x00;
+   }
+
+#if DATA_MEMORY_DIRTY_TRACKING
+   for (uint16_t i = 0; i < DATA_MEMORY_DIRTY_WORDS; ++i)
+   {
+      context->data_memory.dirty[i] = 0xFFFFFFFF;
    }
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
    return;
 }
 
 /********************************************************************************
-* data_memory_write: Writes an 8-bit value to specified address in data memory.
-*                    The value 0 is returned after successful write. Otherwise
-*                    if invalid address is specified, no write is done and
-*                    error code 1 is returned.
+* data_memory_write_ctx: Writes a 32-bit value to specified address in data
+*                        memory of specified context. The value 0 is returned
+*                        after successful write. Otherwise if invalid address
+*                        is specified, no write is done and error code 1 is
+*                        returned.
 *
-*                    - address: Write location in data memory.
-*                    - value  : The 8-bit value to write to data memory.
+*                        - context: Reference to the CPU context.
+*                        - address: Write location in data memory.
+*                        - value  : The 32-bit value to write to data memory.
 ********************************************************************************/
-int data_memory_write(const uint16_t address,
-                      const uint32_t value)
+int data_memory_write_ctx(struct cpu_context* context,
+                          const uint16_t address,
+                          const uint32_t value)
 {
+   struct data_memory* self = &context->data_memory;
+
    if (address < DATA_MEMORY_ADDRESS_WIDTH)
    {
-      data[address] = value;
+      const io_write_handler handler = address < DATA_MEMORY_IO_WIDTH ? write_handler(address) : 0;
+
+      if (handler)
+      {
+         handler(context, address, value);
+      }
+      else
+      {
+         self->data[address] = value;
+      }
+#if DATA_MEMORY_DIRTY_TRACKING
+      const uint16_t page = address / DATA_MEMORY_PAGE_SIZE;
+      self->dirty[page / 32] |= (uint32_t)(1) << (page % 32);
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
       return 0;
    }
    else
@@ -45,19 +122,409 @@ int data_memory_write(const uint16_t address,
 }
 
 /********************************************************************************
-* data_memory_read: Returns content from specified read location in data memory.
-*                   If an invalid address is specified, the value 0 is returned.
+* data_memory_copy_ctx: Copies specified number of words from the source to
+*                       the destination address in data memory of specified
+*                       context, with the same result as copying the source
+*                       block to a temporary buffer first. Blocks outside the
+*                       I/O registers are moved with a single memmove and
+*                       their pages marked as dirty, while blocks touching
+*                       the I/O registers are copied word by word through
+*                       the I/O handlers, in the order that doesn't overwrite
+*                       source words before they're read. The value 0 is
+*                       returned after successful copy. Otherwise if either
+*                       block extends past data memory, nothing is copied
+*                       and error code 1 is returned.
 *
-*                   - address: Read location in data memory.
+*                       - context    : Reference to the CPU context.
+*                       - destination: First address of the destination block.
+*                       - source     : First address of the source block.
+*                       - count      : Number of words to copy.
 ********************************************************************************/
-uint32_t data_memory_read(const uint16_t address)
+int data_memory_copy_ctx(struct cpu_context* context,
+                         const uint32_t destination,
+                         const uint32_t source,
+                         const uint32_t count)
 {
-   if (address < DATA_MEMORY_ADDRESS_WIDTH)
+   struct data_memory* self = &context->data_memory;
+
+   if (!data_memory_block_valid(destination, count) || !data_memory_block_valid(source, count)) return 1;
+   if (count == 0 || destination == source) return 0;
+
+   if (destination >= DATA_MEMORY_IO_WIDTH && source >= DATA_MEMORY_IO_WIDTH)
+   {
+      memmove(&self->data[destination], &self->data[source], count * sizeof(uint32_t));
+      mark_dirty(self, destination, count);
+   }
+   else if (destination < source)
+   {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+         data_memory_write_ctx(context, (uint16_t)(destination + i), data_memory_read_ctx(context, (uint16_t)(source + i)));
+      }
+   }
+   else
+   {
+      for (uint32_t i = count; i > 0; --i)
+      {
+         data_memory_write_ctx(context, (uint16_t)(destination + i - 1), data_memory_read_ctx(context, (uint16_t)(source + i - 1)));
+      }
+   }
+   return 0;
+}
+
+/********************************************************************************
+* data_memory_fill_ctx: Writes specified value to specified number of words
+*                       from the destination address in data memory of
+*                       specified context. Blocks outside the I/O registers
+*                       are filled in a single loop and their pages marked
+*                       as dirty, while blocks touching the I/O registers are
+*                       filled word by word through the I/O handlers. The
+*                       value 0 is returned after successful fill. Otherwise
+*                       if the block extends past data memory, nothing is
+*                       written and error code 1 is returned.
+*
+*                       - context    : Reference to the CPU context.
+*                       - destination: First address of the block.
+*                       - value      : The 32-bit value to write.
+*                       - count      : Number of words to fill.
+********************************************************************************/
+int data_memory_fill_ctx(struct cpu_context* context,
+                         const uint32_t destination,
+                         const uint32_t value,
+                         const uint32_t count)
+{
+   struct data_memory* self = &context->data_memory;
+
+   if (!data_memory_block_valid(destination, count)) return 1;
+
+   if (destination >= DATA_MEMORY_IO_WIDTH)
+   {
+      for (uint32_t* i = &self->data[destination]; i < &self->data[destination + count]; ++i)
+      {
+         *i = value;
+      }
+      mark_dirty(self, destination, count);
+   }
+   else
+   {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+         data_memory_write_ctx(context, (uint16_t)(destination + i), value);
+      }
+   }
+   return 0;
+}
+
+/********************************************************************************
+* data_memory_page_dirty_ctx: Indicates if specified page of the data memory
+*                             of specified context has been written since the
+*                             dirty pages were last cleared.
+*
+*                             - context: Reference to the CPU context.
+*                             - page   : The page to check.
+********************************************************************************/
+bool data_memory_page_dirty_ctx(const struct cpu_context* context,
+                                const uint16_t page)
+{
+   if (page >= DATA_MEMORY_PAGES) return false;
+#if DATA_MEMORY_DIRTY_TRACKING
+   return (context->data_memory.dirty[page / 32] >> (page % 32)) & 1;
+#else
+   return true;
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+}
+
+/********************************************************************************
+* data_memory_dirty_pages_ctx: Stores the numbers of the dirty pages of the
+*                              data memory of specified context in ascending
+*                              order in referenced array. The number of dirty
+*                              pages is returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - pages  : Reference to array for the page numbers.
+********************************************************************************/
+uint16_t data_memory_dirty_pages_ctx(const struct cpu_context* context,
+                                     uint16_t* pages)
+{
+   uint16_t count = 0;
+#if DATA_MEMORY_DIRTY_TRACKING
+   list_pages(context->data_memory.dirty, pages, &count);
+#else
+   for (uint16_t i = 0; i < DATA_MEMORY_PAGES; ++i)
+   {
+      pages[count++] = i;
+   }
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+   return count;
+}
+
+/********************************************************************************
+* data_memory_clear_dirty_ctx: Marks all pages of the data memory of specified
+*                              context as clean.
+*
+*                              - context: Reference to the CPU context.
+********************************************************************************/
+void data_memory_clear_dirty_ctx(struct cpu_context* context)
+{
+#if DATA_MEMORY_DIRTY_TRACKING
+   for (uint16_t i = 0; i < DATA_MEMORY_DIRTY_WORDS; ++i)
+   {
+      context->data_memory.dirty[i] = 0x00;
+   }
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+   return;
+}
+
+/********************************************************************************
+* data_memory_diff: Compares two data memory images page by page and stores
+*                   the numbers of the pages that differ in ascending order in
+*                   referenced array. Only the pages that are dirty in either
+*                   image are compared. The number of differing pages is
+*                   returned.
+*
+*                   - a    : Reference to the first image.
+*                   - b    : Reference to the second image.
+*                   - pages: Reference to array for the page numbers.
+********************************************************************************/
+uint16_t data_memory_diff(const struct data_memory* a,
+                          const struct data_memory* b,
+                          uint16_t* pages)
+{
+   uint16_t candidates[DATA_MEMORY_PAGES];
+   uint16_t count = 0;
+   uint16_t differing = 0;
+
+#if DATA_MEMORY_DIRTY_TRACKING
+   uint32_t dirty[DATA_MEMORY_DIRTY_WORDS];
+
+   for (uint16_t i = 0; i < DATA_MEMORY_DIRTY_WORDS; ++i)
+   {
+      dirty[i] = a->dirty[i] | b->dirty[i];
+   }
+
+   list_pages(dirty, candidates, &count);
+#else
+   for (uint16_t i = 0; i < DATA_MEMORY_PAGES; ++i)
+   {
+      candidates[count++] = i;
+   }
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+
+   for (uint16_t i = 0; i < count; ++i)
+   {
+      const uint16_t address = data_memory_page_address(candidates[i]);
+      const size_t size = data_memory_page_length(candidates[i]) * sizeof(uint32_t);
+
+      if (memcmp(a->data + address, b->data + address, size) != 0)
+      {
+         pages[differing++] = candidates[i];
+      }
+   }
+
+   return differing;
+}
+
+/********************************************************************************
+* data_memory_read_ctx: Returns content from specified read location in data
+*                       memory of specified context. If an invalid address is
+*                       specified, the value 0 is returned.
+*
+*                       - context: Reference to the CPU context.
+*                       - address: Read location in data memory.
+********************************************************************************/
+uint32_t data_memory_read_ctx(struct cpu_context* context,
+                              const uint16_t address)
+{
+   const io_read_handler handler = address < DATA_MEMORY_IO_WIDTH ? read_handler(address) : 0;
+
+   if (handler)
+   {
+      return handler(context, address);
+   }
+   else if (address < DATA_MEMORY_ADDRESS_WIDTH)
    {
-      return data[address];
+      return context->data_memory.data[address];
    }
    else
    {
       return 0x00;
    }
-}
\ No newline at end of file
+}
+
+/********************************************************************************
+* read_port: Returns the input values of I/O port A read from the port backend.
+*
+*            - context: Reference to the CPU context.
+*            - address: Address of the register (PINA).
+********************************************************************************/
+static uint32_t read_port(struct cpu_context* context, const uint16_t address)
+{
+   return port_read_ctx(context);
+}
+
+/********************************************************************************
+* write_port: Stores the data direction or output values of I/O port A and
+*             writes both registers through to the port backend.
+*
+*             - context: Reference to the CPU context.
+*             - address: Address of the register (DDRA or PORTA).
+*             - value  : The value to write.
+********************************************************************************/
+static void write_port(struct cpu_context* context, const uint16_t address, const uint32_t value)
+{
+   uint32_t* data = context->data_memory.data;
+   data[address] = value;
+   port_write_ctx(context, data[DDRA], data[PORTA]);
+   return;
+}
+
+/********************************************************************************
+* write_interrupt: Stores the enable or flag bits of the interrupt sources and
+*                  updates the pending interrupt requests.
+*
+*                  - context: Reference to the CPU context.
+*                  - address: Address of the register (ICR or IFR).
+*                  - value  : The value to write.
+********************************************************************************/
+static void write_interrupt(struct cpu_context* context, const uint16_t address, const uint32_t value)
+{
+   context->data_memory.data[address] = value;
+   interrupt_update_ctx(context);
+   return;
+}
+
+/********************************************************************************
+* read_timer: Returns the current count of the timer.
+*
+*             - context: Reference to the CPU context.
+*             - address: Address of the register (TCNT).
+********************************************************************************/
+static uint32_t read_timer(struct cpu_context* context, const uint16_t address)
+{
+   return timer_count_ctx(context);
+}
+
+/********************************************************************************
+* write_timer: Counts the timer up to now with the previous settings, stores
+*              the value and applies it to the timer.
+*
+*              - context: Reference to the CPU context.
+*              - address: Address of the register (TCCR, TCNT or OCRA).
+*              - value  : The value to write.
+********************************************************************************/
+static void write_timer(struct cpu_context* context, const uint16_t address, const uint32_t value)
+{
+   timer_sync_ctx(context);
+   context->data_memory.data[address] = value;
+   timer_write_ctx(context, address);
+   return;
+}
+
+/********************************************************************************
+* read_uart: Returns the status of the UART, or takes the next received byte
+*            when UDR is read. Taking a byte consumes it like on real
+*            hardware, hence the context is modified despite the read.
+*
+*            - context: Reference to the CPU context.
+*            - address: Address of the register (UDR or USR).
+********************************************************************************/
+static uint32_t read_uart(struct cpu_context* context, const uint16_t address)
+{
+   if (address == UDR) return uart_receive_ctx(context);
+   return uart_status_ctx(context);
+}
+
+/********************************************************************************
+* write_uart: Stores the value and queues its lowest byte for transmission.
+*
+*             - context: Reference to the CPU context.
+*             - address: Address of the register (UDR).
+*             - value  : The value to write.
+********************************************************************************/
+static void write_uart(struct cpu_context* context, const uint16_t address, const uint32_t value)
+{
+   context->data_memory.data[address] = value;
+   uart_transmit_ctx(context, (uint8_t)(value));
+   return;
+}
+
+/********************************************************************************
+* read_handler: Returns the read handler of the I/O register at specified
+*               address, or 0 if the register has none. The handler table is
+*               read from flash on the AVR.
+*
+*               - address: Address of the register.
+********************************************************************************/
+static inline io_read_handler read_handler(const uint16_t address)
+{
+#ifdef __AVR__
+   return (io_read_handler)(pgm_read_ptr(&io_handlers[address].read));
+#else
+   return io_handlers[address].read;
+#endif /* __AVR__ */
+}
+
+/********************************************************************************
+* write_handler: Returns the write handler of the I/O register at specified
+*                address, or 0 if the register has none. The handler table is
+*                read from flash on the AVR.
+*
+*                - address: Address of the register.
+********************************************************************************/
+static inline io_write_handler write_handler(const uint16_t address)
+{
+#ifdef __AVR__
+   return (io_write_handler)(pgm_read_ptr(&io_handlers[address].write));
+#else
+   return io_handlers[address].write;
+#endif /* __AVR__ */
+}
+
+/********************************************************************************
+* mark_dirty: Marks the pages of the block of specified number of words
+*             starting at specified address as dirty. The block must be
+*             within data memory and hold at least one word.
+*
+*             - self   : Reference to the data memory.
+*             - address: First address of the block.
+*             - count  : Number of words in the block.
+********************************************************************************/
+static inline void mark_dirty(struct data_memory* self, const uint32_t address, const uint32_t count)
+{
+#if DATA_MEMORY_DIRTY_TRACKING
+   for (uint32_t page = address / DATA_MEMORY_PAGE_SIZE; page <= (address + count - 1) / DATA_MEMORY_PAGE_SIZE; ++page)
+   {
+      self->dirty[page / 32] |= (uint32_t)(1) << (page % 32);
+   }
+#else
+   (void)self;
+   (void)address;
+   (void)count;
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+   return;
+}
+
+#if DATA_MEMORY_DIRTY_TRACKING
+/********************************************************************************
+* list_pages: Appends the numbers of the pages set in specified bitmap to the
+*             referenced array in ascending order and updates the count.
+*             Words without any set bit are skipped as a whole.
+*
+*             - bitmap: Reference to the page bitmap.
+*             - pages : Reference to array for the page numbers.
+*             - count : Reference to the number of stored pages.
+********************************************************************************/
+static void list_pages(const uint32_t* bitmap, uint16_t* pages, uint16_t* count)
+{
+   for (uint16_t i = 0; i < DATA_MEMORY_DIRTY_WORDS; ++i)
+   {
+      uint32_t bits = bitmap[i];
+
+      for (uint16_t page = i * 32; bits && page < DATA_MEMORY_PAGES; ++page, bits >>= 1)
+      {
+         if (bits & 1) pages[(*count)++] = page;
+      }
+   }
+   return;
+}
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
@@ -11,54 +11,333 @@
 /* Macro definitions: */
 #define DATA_MEMORY_ADDRESS_WIDTH 300   /* 300 unique addresses in data memory. */
 #define DATA_MEMORY_DATA_WIDTH    32    /* 32 bits storage capacity per address. */
+#define DATA_MEMORY_IO_WIDTH      0x20  /* Addresses 0x00 - 0x1F are reserved for I/O registers. */
 
 /********************************************************************************
-* data_memory_reset: Clears entire data memory.
+* DATA_MEMORY_DIRTY_TRACKING: Records which pages of the data memory have been
+*                             written since the dirty pages were last cleared
+*                             when set to 1, so that snapshots, comparisons
+*                             and mirrors only need to copy the pages that
+*                             changed. Set to 0 to remove the bookkeeping from
+*                             data_memory_write_ctx, in which case every page
+*                             is always reported as dirty.
 ********************************************************************************/
-void data_memory_reset(void);
+#ifndef DATA_MEMORY_DIRTY_TRACKING
+#define DATA_MEMORY_DIRTY_TRACKING 1
+#endif
 
 /********************************************************************************
-* data_memory_write: Writes an 8-bit value to specified address in data memory.
-*                    The value 0 is returned after successful write. Otherwise
-*                    if invalid address is specified, no write is done and
-*                    error code 1 is returned.
+* DATA_MEMORY_PAGE_SIZE: Number of words per page of the data memory, which is
+*                        the granularity of the dirty tracking and the diff.
+*                        Must be a power of two.
+********************************************************************************/
+#ifndef DATA_MEMORY_PAGE_SIZE
+#define DATA_MEMORY_PAGE_SIZE 16
+#endif
+
+#if (DATA_MEMORY_PAGE_SIZE & (DATA_MEMORY_PAGE_SIZE - 1)) != 0
+#error "DATA_MEMORY_PAGE_SIZE must be a power of two!"
+#endif
+
+#define DATA_MEMORY_PAGES ((DATA_MEMORY_ADDRESS_WIDTH + DATA_MEMORY_PAGE_SIZE - 1) / DATA_MEMORY_PAGE_SIZE) /* Number of pages. */
+#define DATA_MEMORY_DIRTY_WORDS ((DATA_MEMORY_PAGES + 31) / 32) /* Number of words in the dirty bitmap. */
+
+/********************************************************************************
+* data_memory: Data memory of a CPU context.
+********************************************************************************/
+struct data_memory
+{
+	uint32_t data[DATA_MEMORY_ADDRESS_WIDTH]; /* Data memory with storage capacity for 300 words. */
+#if DATA_MEMORY_DIRTY_TRACKING
+	uint32_t dirty[DATA_MEMORY_DIRTY_WORDS];  /* One bit per page written since last cleared. */
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+};
+
+/********************************************************************************
+* data_memory_block_valid: Indicates if the block of specified number of words
+*                          starting at specified address lies within data
+*                          memory.
+*
+*                          - address: First address of the block.
+*                          - count  : Number of words in the block.
+********************************************************************************/
+static inline bool data_memory_block_valid(const uint32_t address, const uint32_t count)
+{
+   return address <= DATA_MEMORY_ADDRESS_WIDTH && count <= DATA_MEMORY_ADDRESS_WIDTH - address;
+}
+
+/********************************************************************************
+* data_memory_reset_ctx: Clears entire data memory of specified context.
+*
+*                        - context: Reference to the CPU context.
+********************************************************************************/
+void data_memory_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* data_memory_write_ctx: Writes a 32-bit value to specified address in data
+*                        memory of specified context. Writes to I/O registers
+*                        are passed to the write handler of the register, if
+*                        any, which updates the peripheral. The value 0 is
+*                        returned after successful write. Otherwise if invalid
+*                        address is specified, no write is done and error
+*                        code 1 is returned.
 * 
-*                    - address: Write location in data memory.
-*                    - value  : The 8-bit value to write to data memory.
+*                        - context: Reference to the CPU context.
+*                        - address: Write location in data memory.
+*                        - value  : The 32-bit value to write to data memory.
+********************************************************************************/
+int data_memory_write_ctx(struct cpu_context* context,
+                          const uint16_t address,
+                          const uint32_t value);
+
+/********************************************************************************
+* data_memory_copy_ctx: Copies specified number of words from the source to
+*                       the destination address in data memory of specified
+*                       context. The blocks may overlap. Blocks outside the
+*                       I/O registers are copied in one go, otherwise word by
+*                       word through the I/O handlers. The value 0 is
+*                       returned after successful copy. Otherwise if either
+*                       block extends past data memory, nothing is copied
+*                       and error code 1 is returned.
+*
+*                       - context    : Reference to the CPU context.
+*                       - destination: First address of the destination block.
+*                       - source     : First address of the source block.
+*                       - count      : Number of words to copy.
+********************************************************************************/
+int data_memory_copy_ctx(struct cpu_context* context,
+                         const uint32_t destination,
+                         const uint32_t source,
+                         const uint32_t count);
+
+/********************************************************************************
+* data_memory_fill_ctx: Writes specified value to specified number of words
+*                       from the destination address in data memory of
+*                       specified context. Blocks outside the I/O registers
+*                       are filled in one go, otherwise word by word through
+*                       the I/O handlers. The value 0 is returned after
+*                       successful fill. Otherwise if the block extends past
+*                       data memory, nothing is written and error code 1 is
+*                       returned.
+*
+*                       - context    : Reference to the CPU context.
+*                       - destination: First address of the block.
+*                       - value      : The 32-bit value to write.
+*                       - count      : Number of words to fill.
+********************************************************************************/
+int data_memory_fill_ctx(struct cpu_context* context,
+                         const uint32_t destination,
+                         const uint32_t value,
+                         const uint32_t count);
+
+/********************************************************************************
+* data_memory_page_dirty_ctx: Indicates if specified page of the data memory
+*                             of specified context has been written since the
+*                             dirty pages were last cleared. Pages are always
+*                             dirty if DATA_MEMORY_DIRTY_TRACKING is 0.
+*
+*                             - context: Reference to the CPU context.
+*                             - page   : The page to check.
+********************************************************************************/
+bool data_memory_page_dirty_ctx(const struct cpu_context* context,
+                                const uint16_t page);
+
+/********************************************************************************
+* data_memory_dirty_pages_ctx: Stores the numbers of the dirty pages of the
+*                              data memory of specified context in ascending
+*                              order in referenced array, which must have room
+*                              for DATA_MEMORY_PAGES entries. The number of
+*                              dirty pages is returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - pages  : Reference to array for the page numbers.
+********************************************************************************/
+uint16_t data_memory_dirty_pages_ctx(const struct cpu_context* context,
+                                     uint16_t* pages);
+
+/********************************************************************************
+* data_memory_clear_dirty_ctx: Marks all pages of the data memory of specified
+*                              context as clean.
+*
+*                              - context: Reference to the CPU context.
+********************************************************************************/
+void data_memory_clear_dirty_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* data_memory_diff: Compares two data memory images page by page and stores
+*                   the numbers of the pages that differ in ascending order in
+*                   referenced array, which must have room for
+*                   DATA_MEMORY_PAGES entries. The number of differing pages is
+*                   returned. Only the pages that are dirty in either image are
+*                   compared, so the images must have been equal when their
+*                   dirty pages were last cleared, for instance both restored
+*                   from the same snapshot. Every page is compared if
+*                   DATA_MEMORY_DIRTY_TRACKING is 0.
+*
+*                   - a    : Reference to the first image.
+*                   - b    : Reference to the second image.
+*                   - pages: Reference to array for the page numbers.
+********************************************************************************/
+uint16_t data_memory_diff(const struct data_memory* a,
+                          const struct data_memory* b,
+                          uint16_t* pages);
+
+/********************************************************************************
+* data_memory_page_address: Returns the first address of specified page.
+*
+*                           - page: The page number.
+********************************************************************************/
+static inline uint16_t data_memory_page_address(const uint16_t page)
+{
+	return page * DATA_MEMORY_PAGE_SIZE;
+}
+
+/********************************************************************************
+* data_memory_page_length: Returns the number of words in specified page,
+*                          which is less than DATA_MEMORY_PAGE_SIZE for the
+*                          last page if the page size doesn't divide the
+*                          address width.
+*
+*                          - page: The page number.
 ********************************************************************************/
-int data_memory_write(const uint16_t address,
-                      const uint32_t value);
+static inline uint16_t data_memory_page_length(const uint16_t page)
+{
+	const uint16_t address = data_memory_page_address(page);
+	return address + DATA_MEMORY_PAGE_SIZE <= DATA_MEMORY_ADDRESS_WIDTH ?
+	       DATA_MEMORY_PAGE_SIZE : DATA_MEMORY_ADDRESS_WIDTH - address;
+}
 
 /********************************************************************************
-* data_memory_read: Returns content from specified read location in data memory.
-*                   If an invalid address is specified, the value 0 is returned.
+* data_memory_read_ctx: Returns content from specified read location in data
+*                       memory of specified context. Reads of I/O registers
+*                       with a read handler return the current value of the
+*                       peripheral instead of the stored content, which may
+*                       modify the context, for instance reading UDR takes
+*                       the next received byte. If an invalid address is
+*                       specified, the value 0 is returned.
 * 
-*                   - address: Read location in data memory.
+*                       - context: Reference to the CPU context.
+*                       - address: Read location in data memory.
+********************************************************************************/
+uint32_t data_memory_read_ctx(struct cpu_context* context,
+                              const uint16_t address);
+
+/********************************************************************************
+* data_memory_set_bit_ctx: Sets bit in specified data memory register of
+*                          specified context. The value 0 is returned after
+*                          successful write. Otherwise if an invalid address is
+*                          specified, no write is done and error code 1 is
+*                          returned.
+*
+*                          - context: Reference to the CPU context.
+*                          - address: Write location in data memory.
+*                          - bit    : Bit to set in data memory register.
+********************************************************************************/
+static inline int data_memory_set_bit_ctx(struct cpu_context* context,
+                                          const uint16_t address,
+                                          const uint32_t bit)
+{
+	const uint32_t data = data_memory_read_ctx(context, address);
+	return data_memory_write_ctx(context, address, data | (1UL << bit));
+}
+
+/********************************************************************************
+* data_memory_clear_bit_ctx: Clears bit in specified data memory register of
+*                            specified context. The value 0 is returned after
+*                            successful write. Otherwise if an invalid address
+*                            is specified, no write is done and error code 1 is
+*                            returned.
+*
+*                            - context: Reference to the CPU context.
+*                            - address: Write location in data memory.
+*                            - bit    : Bit to clear in data memory register.
+********************************************************************************/
+static inline int data_memory_clear_bit_ctx(struct cpu_context* context,
+                                            const uint16_t address,
+                                            const uint32_t bit)
+{
+	const uint32_t data = data_memory_read_ctx(context, address);
+	return data_memory_write_ctx(context, address, data & ~(1UL << bit));
+}
+
+/********************************************************************************
+* data_memory_reset: Clears entire data memory of the default context.
+********************************************************************************/
+static inline void data_memory_reset(void)
+{
+	data_memory_reset_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* data_memory_write: Writes a 32-bit value to specified address in data memory
+*                    of the default context, see data_memory_write_ctx.
+*
+*                    - address: Write location in data memory.
+*                    - value  : The 32-bit value to write to data memory.
 ********************************************************************************/
-uint32_t data_memory_read(const uint16_t address);
+static inline int data_memory_write(const uint16_t address,
+                                    const uint32_t value)
+{
+	return data_memory_write_ctx(&cpu_context_default, address, value);
+}
+
+/********************************************************************************
+* data_memory_copy: Copies specified number of words within data memory of the
+*                   default context, see data_memory_copy_ctx.
+*
+*                   - destination: First address of the destination block.
+*                   - source     : First address of the source block.
+*                   - count      : Number of words to copy.
+********************************************************************************/
+static inline int data_memory_copy(const uint32_t destination,
+                                   const uint32_t source,
+                                   const uint32_t count)
+{
+	return data_memory_copy_ctx(&cpu_context_default, destination, source, count);
+}
 
+/********************************************************************************
+* data_memory_fill: Fills specified number of words in data memory of the
+*                   default context, see data_memory_fill_ctx.
+*
+*                   - destination: First address of the block.
+*                   - value      : The 32-bit value to write.
+*                   - count      : Number of words to fill.
+********************************************************************************/
+static inline int data_memory_fill(const uint32_t destination,
+                                   const uint32_t value,
+                                   const uint32_t count)
+{
+	return data_memory_fill_ctx(&cpu_context_default, destination, value, count);
+}
+
+/********************************************************************************
+* data_memory_read: Returns content from specified read location in data memory
+*                   of the default context, see data_memory_read_ctx.
+*
+*                   - address: Read location in data memory.
+********************************************************************************/
+static inline uint32_t data_memory_read(const uint16_t address)
+{
+	return data_memory_read_ctx(&cpu_context_default, address);
+}
 
 /********************************************************************************
-* data_memory_set_bit: Sets bit in specified data memory register. The value 0
-*                      is returned after successful write. Otherwise if an
-*                      invalid address is specified, no write is done and
-*                      error code 1 is returned.
+* data_memory_set_bit: Sets bit in specified data memory register of the
+*                      default context, see data_memory_set_bit_ctx.
 *
-*                     - address: Write location in data memory.
-*                     - bit    : Bit to set in data memory register.
+*                      - address: Write location in data memory.
+*                      - bit    : Bit to set in data memory register.
 ********************************************************************************/
 static inline int data_memory_set_bit(const uint16_t address,
                                       const uint32_t bit)
 {
-	const uint32_t data = data_memory_read(address);
-	return data_memory_write(address, data | (1 << bit));
+	return data_memory_set_bit_ctx(&cpu_context_default, address, bit);
 }
 
 /********************************************************************************
-* data_memory_clear_bit: Clears bit in specified data memory register. The value
-*                        0 is returned after successful write. Otherwise if
-*                        an invalid address is specified, no write is done and
-*                        error code 1 is returned.
+* data_memory_clear_bit: Clears bit in specified data memory register of the
+*                        default context, see data_memory_clear_bit_ctx.
 *
 *                        - address: Write location in data memory.
 *                        - bit    : Bit to clear in data memory register.
@@ -66,8 +345,7 @@ static inline int data_memory_set_bit(const uint16_t address,
 static inline int data_memory_clear_bit(const uint16_t address,
                                         const uint32_t bit)
 {
-	const uint32_t data = data_memory_read(address);
-	return data_memory_write(address, data & ~(1 << bit));
+	return data_memory_clear_bit_ctx(&cpu_context_default, address, bit);
 }
 
-#endif /* DATA_MEMORY_H_ */
\ No newline at end of file
+#endif /* DATA_MEMORY_H_ */
@@ -0,0 +1,791 @@
+/********************************************************************************
+* assembler.c: Contains function definitions for the host assembler, which
+*              translates assembly source to a program image in two passes.
+*              The first pass defines the labels and constants and sizes the
+*              instructions, while the second pass evaluates the operands
+*              and emits the code, the vector table and the initial data.
+********************************************************************************/
+#include "cpu_context.h"
+#include "assembler.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <string.h>
+
+/* Macro definitions: */
+#define ASSEMBLER_NAME_SIZE 32   /* Maximum length of a symbol name, including the terminator. */
+#define ASSEMBLER_LINE_SIZE 256  /* Maximum length of a source line, including the terminator. */
+#define ASSEMBLER_CODE_SIZE PROGRAM_MEMORY_ADDRESS_WIDTH /* Maximum size of a program, including the vector table. */
+
+#define NAME(symbol) { #symbol, symbol } /* Entry in a table of names from cpu.h. */
+
+/********************************************************************************
+* name: Name of an OP code or a constant in cpu.h.
+********************************************************************************/
+struct name
+{
+	const char* name; /* The name, for instance "LDI" or "PORTA". */
+	uint32_t value;   /* The value of the name. */
+};
+
+/********************************************************************************
+* symbol: Label or constant defined in the source.
+********************************************************************************/
+struct symbol
+{
+	char name[ASSEMBLER_NAME_SIZE]; /* Name of the symbol. */
+	uint32_t value;                 /* Address of the label or value of the constant. */
+};
+
+/********************************************************************************
+* assembler: State of the assembler during both passes.
+********************************************************************************/
+struct assembler
+{
+	struct symbol* symbols;     /* Labels and constants defined so far. */
+	size_t symbol_count;        /* Number of defined symbols. */
+	size_t symbol_capacity;     /* Number of symbols with allocated room. */
+	uint32_t* data;             /* Initial data, emitted in the second pass. */
+	size_t data_size;           /* Number of words of initial data. */
+	size_t data_capacity;       /* Number of data words with allocated room. */
+	uint32_t code[ASSEMBLER_CODE_SIZE];      /* Code, emitted in the second pass. */
+	uint32_t vectors[PROGRAM_IMAGE_VECTORS]; /* Handler address of each interrupt vector. */
+	uint16_t vector_count;      /* Number of used entries in the vector table. */
+	uint32_t address;           /* Program memory address of the next instruction. */
+	uint32_t entry;             /* Address run after reset. */
+	uint32_t data_address;      /* Data memory address of the initial data. */
+	bool has_entry;             /* Indicates if the entry address has been set. */
+	bool has_data_address;      /* Indicates if the data address has been set. */
+	bool code_started;          /* Indicates if a label or an instruction has been read. */
+	bool unresolved;            /* Set when an expression refers to an undefined symbol. */
+	uint8_t pass;               /* Current pass, 1 or 2. */
+	unsigned line;              /* Number of the current source line. */
+	char* message;              /* Buffer for the error message. */
+	size_t message_size;        /* Size of the error message buffer. */
+};
+
+/* Static functions: */
+static int assemble_pass(struct assembler* self, const char* source);
+static int assemble_line(struct assembler* self, char* line);
+static int label(struct assembler* self, const char* name);
+static int directive(struct assembler* self, const char* name, const char* operands);
+static int instruction(struct assembler* self, const char* mnemonic, const char* operands);
+static int operands_list(struct assembler* self, const char** cursor, uint32_t* values,
+                         const uint8_t max_count, uint8_t* count);
+static int expression(struct assembler* self, const char** cursor, uint32_t* value);
+static int shift(struct assembler* self, const char** cursor, uint32_t* value);
+static int factor(struct assembler* self, const char** cursor, uint32_t* value);
+static int identifier(const char** cursor, char* name);
+static int define(struct assembler* self, const char* name, const uint32_t value);
+static bool lookup(const struct assembler* self, const char* name, uint32_t* value);
+static bool lookup_name(const struct name* names, const size_t count, const char* name, uint32_t* value);
+static int append_data(struct assembler* self, const uint32_t value);
+static int build_image(struct assembler* self, uint32_t** image, size_t* size);
+static int error(struct assembler* self, const char* format, ...);
+static inline const char* skip_space(const char* s);
+
+/* Static variables: */
+static const struct name mnemonics[] =
+{
+	NAME(NOP), NAME(LDI), NAME(MOV), NAME(OUT), NAME(IN), NAME(STS), NAME(LDS), NAME(CLR),
+	NAME(ORI), NAME(ANDI), NAME(XORI), NAME(OR), NAME(AND), NAME(XOR), NAME(ADDI), NAME(SUBI),
+	NAME(ADD), NAME(SUB), NAME(INC), NAME(DEC), NAME(CPI), NAME(CP), NAME(JMP), NAME(BREQ),
+	NAME(BRNE), NAME(BRGE), NAME(BRGT), NAME(BRLE), NAME(BRLT), NAME(CALL), NAME(RET), NAME(RETI),
+	NAME(PUSH), NAME(POP), NAME(LSL), NAME(LSR), NAME(SEI), NAME(CLI), NAME(STIO), NAME(LDIO),
+	NAME(ST), NAME(LD), NAME(SLEEP), NAME(MEMCPY), NAME(MEMSET), NAME(MUL), NAME(MULH),
+	NAME(DIV), NAME(MOD), NAME(LSLV), NAME(LSRV), NAME(ASR), NAME(ROL), NAME(ROR)
+};
+
+static const struct name constants[] =
+{
+	NAME(R0), NAME(R1), NAME(R2), NAME(R3), NAME(R4), NAME(R5), NAME(R6), NAME(R7),
+	NAME(R8), NAME(R9), NAME(R10), NAME(R11), NAME(R12), NAME(R13), NAME(R14), NAME(R15),
+	NAME(R16), NAME(R17), NAME(R18), NAME(R19), NAME(R20), NAME(R21), NAME(R22), NAME(R23),
+	NAME(R24), NAME(R25), NAME(R26), NAME(R27), NAME(R28), NAME(R29), NAME(R30), NAME(R31),
+
+	NAME(RESET_vect), NAME(PCINT_vect), NAME(TIMER_OVF_vect), NAME(TIMER_COMPA_vect), NAME(SWI_vect),
+	NAME(UART_RX_vect),
+
+	NAME(DDRA), NAME(PORTA), NAME(PINA), NAME(ICR), NAME(IFR), NAME(PCMSKA),
+	NAME(PCIEA), NAME(PCIFA), NAME(TOIE), NAME(TOV), NAME(OCIEA), NAME(OCFA), NAME(SWIE), NAME(SWIF),
+	NAME(RXCIE), NAME(RXCF),
+	NAME(TCCR), NAME(TCNT), NAME(OCRA), NAME(CS0), NAME(CS1), NAME(CS2), NAME(CTC),
+	NAME(UDR), NAME(USR), NAME(RXC), NAME(UDRE),
+
+	NAME(PORTA0), NAME(PORTA1), NAME(PORTA2), NAME(PORTA3), NAME(PORTA4),
+	NAME(PORTA5), NAME(PORTA6), NAME(PORTA7), NAME(PORTA8), NAME(PORTA9),
+	NAME(PORTA10), NAME(PORTA11), NAME(PORTA12), NAME(PORTA13), NAME(PORTA14),
+	NAME(PORTA15), NAME(PORTA16), NAME(PORTA17), NAME(PORTA18), NAME(PORTA19)
+};
+
+/********************************************************************************
+* assembler_assemble: Assembles specified source to a program image, which is
+*                     allocated on the heap and must be freed by the caller.
+*                     The value 0 is returned after successful assembly.
+*                     Otherwise an error message is stored in the referenced
+*                     buffer and error code 1 is returned.
+*
+*                     - source      : The assembly source, null terminated.
+*                     - image       : Reference to the image pointer.
+*                     - size        : Reference to the image size.
+*                     - message     : Buffer for the error message.
+*                     - message_size: Size of the error message buffer.
+********************************************************************************/
+int assembler_assemble(const char* source,
+                       uint32_t** image,
+                       size_t* size,
+                       char* message,
+                       const size_t message_size)
+{
+	struct assembler* self = (struct assembler*)calloc(1, sizeof(struct assembler));
+	int status = 1;
+
+	if (!self)
+	{
+		snprintf(message, message_size, "out of memory");
+		return 1;
+	}
+
+	self->message = message;
+	self->message_size = message_size;
+
+	for (uint16_t i = 0; i < PROGRAM_IMAGE_VECTORS; ++i)
+	{
+		self->vectors[i] = PROGRAM_IMAGE_NO_VECTOR;
+	}
+
+	if (!assemble_pass(self, source))
+	{
+		self->pass = 2;
+		if (!assemble_pass(self, source)) status = build_image(self, image, size);
+	}
+
+	free(self->symbols);
+	free(self->data);
+	free(self);
+	return status;
+}
+
+/********************************************************************************
+* assemble_pass: Runs the next pass over specified source line by line. The
+*                value 0 is returned after a successful pass, otherwise error
+*                code 1 is returned.
+*
+*                - self  : Reference to the assembler.
+*                - source: The assembly source.
+********************************************************************************/
+static int assemble_pass(struct assembler* self, const char* source)
+{
+	const char* s = source;
+
+	if (self->pass == 0) self->pass = 1;
+	self->address = program_image_code_address(self->vector_count);
+	self->line = 0;
+
+	while (*s)
+	{
+		const char* end = strchr(s, '\n');
+		const size_t length = end ? (size_t)(end - s) : strlen(s);
+		char line[ASSEMBLER_LINE_SIZE];
+
+		self->line++;
+		if (length >= sizeof(line)) return error(self, "line too long");
+
+		memcpy(line, s, length);
+		line[length] = '\0';
+		if (assemble_line(self, line)) return 1;
+		s += end ? length + 1 : length;
+	}
+
+	self->line = 0;
+	if (self->pass == 2 && self->address == program_image_code_address(self->vector_count))
+	{
+		return error(self, "no instructions");
+	}
+	return 0;
+}
+
+/********************************************************************************
+* assemble_line: Assembles specified source line, which is modified. The value
+*                0 is returned after success, otherwise error code 1 is
+*                returned.
+*
+*                - self: Reference to the assembler.
+*                - line: The source line.
+********************************************************************************/
+static int assemble_line(struct assembler* self, char* line)
+{
+	char* comment = strchr(line, ';');
+	const char* s;
+	char name[ASSEMBLER_NAME_SIZE];
+
+	if (comment) *comment = '\0';
+	s = skip_space(line);
+
+	if (!identifier(&s, name) && *skip_space(s) == ':')
+	{
+		if (label(self, name)) return 1;
+		s = skip_space(s) + 1;
+	}
+	else
+	{
+		s = skip_space(line);
+	}
+
+	s = skip_space(s);
+	if (*s == '\0') return 0;
+
+	if (*s == '.')
+	{
+		s++;
+		if (identifier(&s, name)) return error(self, "syntax error");
+		return directive(self, name, s);
+	}
+
+	if (identifier(&s, name)) return error(self, "syntax error");
+	return instruction(self, name, s);
+}
+
+/********************************************************************************
+* label: Defines a label at the current address in the first pass. In the
+*        second pass the address is checked instead, since it's shifted if
+*        a forward reference turned out too wide for the instruction word.
+*        The value 0 is returned after success, otherwise error code 1 is
+*        returned.
+*
+*        - self: Reference to the assembler.
+*        - name: Name of the label.
+********************************************************************************/
+static int label(struct assembler* self, const char* name)
+{
+	uint32_t address = 0;
+
+	self->code_started = true;
+	if (self->pass == 1) return define(self, name, self->address);
+
+	lookup(self, name, &address);
+	if (address != self->address) return error(self, "forward reference too wide for instruction word before %s", name);
+	return 0;
+}
+
+/********************************************************************************
+* directive: Runs specified directive. The value 0 is returned after success,
+*            otherwise error code 1 is returned.
+*
+*            - self    : Reference to the assembler.
+*            - name    : Name of the directive without the leading dot.
+*            - operands: The operands following the name.
+********************************************************************************/
+static int directive(struct assembler* self, const char* name, const char* operands)
+{
+	const char* s = skip_space(operands);
+	uint32_t values[1];
+	uint8_t count;
+
+	if (strcmp(name, "equ") == 0)
+	{
+		char symbol[ASSEMBLER_NAME_SIZE];
+
+		if (identifier(&s, symbol)) return error(self, "expected constant name");
+		s = skip_space(s);
+		if (*s++ != ',' || operands_list(self, &s, values, 1, &count) || count != 1) return error(self, "expected constant value");
+		if (self->unresolved) return error(self, "constant %s refers to undefined symbol", symbol);
+		return self->pass == 1 ? define(self, symbol, values[0]) : 0;
+	}
+	else if (strcmp(name, "vector") == 0)
+	{
+		uint32_t vector;
+
+		self->unresolved = false;
+		if (expression(self, &s, &vector)) return 1;
+		if (self->unresolved || vector % 2 || vector < PCINT_vect || vector > 2 * PROGRAM_IMAGE_VECTORS)
+		{
+			return error(self, "invalid interrupt vector");
+		}
+
+		vector = vector / 2 - 1;
+		s = skip_space(s);
+		if (*s++ != ',' || operands_list(self, &s, values, 1, &count) || count != 1) return error(self, "expected handler address");
+
+		if (self->pass == 1)
+		{
+			if (self->code_started) return error(self, "vectors must be declared before the code");
+			if (self->vectors[vector] != PROGRAM_IMAGE_NO_VECTOR) return error(self, "vector already declared");
+			self->vectors[vector] = 0; /* Resolved in the second pass. */
+			if (vector + 1 > self->vector_count) self->vector_count = (uint16_t)(vector + 1);
+			self->address = program_image_code_address(self->vector_count);
+		}
+		else
+		{
+			self->vectors[vector] = values[0];
+		}
+		return 0;
+	}
+	else if (strcmp(name, "entry") == 0)
+	{
+		if (operands_list(self, &s, values, 1, &count) || count != 1) return error(self, "expected entry address");
+		if (self->pass == 2)
+		{
+			if (self->has_entry) return error(self, "entry already declared");
+			self->entry = values[0];
+			self->has_entry = true;
+		}
+		return 0;
+	}
+	else if (strcmp(name, "data") == 0)
+	{
+		if (operands_list(self, &s, values, 1, &count) || count != 1) return error(self, "expected data address");
+		if (self->pass == 2)
+		{
+			if (self->has_data_address) return error(self, "data address already declared");
+			self->data_address = values[0];
+			self->has_data_address = true;
+		}
+		return 0;
+	}
+	else if (strcmp(name, "word") == 0)
+	{
+		while (1)
+		{
+			if (expression(self, &s, &values[0])) return 1;
+			if (self->pass == 2 && append_data(self, values[0])) return 1;
+			s = skip_space(s);
+			if (*s != ',') break;
+			s++;
+		}
+		return *s == '\0' ? 0 : error(self, "syntax error");
+	}
+	else
+	{
+		return error(self, "unknown directive .%s", name);
+	}
+}
+
+/********************************************************************************
+* instruction: Assembles specified instruction, which occupies an extension
+*              word if the second operand doesn't fit in the instruction
+*              word. The value 0 is returned after success, otherwise error
+*              code 1 is returned.
+*
+*              - self    : Reference to the assembler.
+*              - mnemonic: The mnemonic of the instruction, case insensitive.
+*              - operands: The operands following the mnemonic.
+********************************************************************************/
+static int instruction(struct assembler* self, const char* mnemonic, const char* operands)
+{
+	char upper[ASSEMBLER_NAME_SIZE];
+	uint32_t op_code;
+	uint32_t values[2] = { 0, 0 };
+	uint8_t count;
+	const char* s = operands;
+
+	for (uint8_t i = 0; i < sizeof(upper); ++i)
+	{
+		upper[i] = (char)(toupper((unsigned char)(mnemonic[i])));
+		if (mnemonic[i] == '\0') break;
+	}
+
+	if (!lookup_name(mnemonics, sizeof(mnemonics) / sizeof(mnemonics[0]), upper, &op_code))
+	{
+		return error(self, "unknown instruction %s", mnemonic);
+	}
+
+	if (operands_list(self, &s, values, 2, &count)) return 1;
+	if (self->pass == 2 && values[0] > 0xFFF) return error(self, "first operand out of range");
+	if (self->pass == 2 && (op_code == MEMCPY || op_code == MEMSET) && values[0] >= CPU_REGISTER_ADDRESS_WIDTH - 1)
+	{
+		return error(self, "%s needs the register after the first operand for the length", upper);
+	}
+
+	self->code_started = true;
+	if (self->address + (values[1] > INSTRUCTION_OP2_MAX ? 2 : 1) > ASSEMBLER_CODE_SIZE)
+	{
+		return error(self, "program too large for %u words of program memory", (unsigned)(ASSEMBLER_CODE_SIZE));
+	}
+
+	if (values[1] > INSTRUCTION_OP2_MAX)
+	{
+		if (self->pass == 2)
+		{
+			self->code[self->address] = ASSEMBLE_EXTENDED(op_code, values[0]);
+			self->code[self->address + 1] = values[1];
+		}
+		self->address += 2;
+	}
+	else
+	{
+		if (self->pass == 2) self->code[self->address] = ASSEMBLE(op_code, values[0], values[1]);
+		self->address++;
+	}
+	return 0;
+}
+
+/********************************************************************************
+* operands_list: Evaluates up to specified number of comma separated operands,
+*                which must be followed by the end of the line. Missing
+*                operands are left as they are. The value 0 is returned after
+*                success, otherwise error code 1 is returned.
+*
+*                - self     : Reference to the assembler.
+*                - cursor   : Reference to the read position, updated.
+*                - values   : Array for the operand values.
+*                - max_count: Maximum number of operands.
+*                - count    : Reference to the number of read operands.
+********************************************************************************/
+static int operands_list(struct assembler* self, const char** cursor, uint32_t* values,
+                         const uint8_t max_count, uint8_t* count)
+{
+	const char* s = skip_space(*cursor);
+
+	*count = 0;
+	self->unresolved = false;
+	if (*s == '\0') return 0;
+
+	while (1)
+	{
+		if (*count == max_count) return error(self, "too many operands");
+		if (expression(self, &s, &values[(*count)++])) return 1;
+		s = skip_space(s);
+		if (*s != ',') break;
+		s++;
+	}
+
+	if (*s != '\0') return error(self, "syntax error");
+	*cursor = s;
+	return 0;
+}
+
+/********************************************************************************
+* expression: Evaluates the expression at the read position, where the
+*             operators |, &, ^, + and - are evaluated from left to right.
+*             The value 0 is returned after success, otherwise error code 1
+*             is returned.
+*
+*             - self  : Reference to the assembler.
+*             - cursor: Reference to the read position, updated.
+*             - value : Reference to the result.
+********************************************************************************/
+static int expression(struct assembler* self, const char** cursor, uint32_t* value)
+{
+	if (shift(self, cursor, value)) return 1;
+
+	while (1)
+	{
+		const char* s = skip_space(*cursor);
+		const char operation = *s;
+		uint32_t operand;
+
+		if (operation != '|' && operation != '&' && operation != '^' && operation != '+' && operation != '-') return 0;
+
+		*cursor = s + 1;
+		if (shift(self, cursor, &operand)) return 1;
+
+		if (operation == '|') *value |= operand;
+		else if (operation == '&') *value &= operand;
+		else if (operation == '^') *value ^= operand;
+		else if (operation == '+') *value += operand;
+		else *value -= operand;
+	}
+}
+
+/********************************************************************************
+* shift: Evaluates the shifts << and >> at the read position, from left to
+*        right. The value 0 is returned after success, otherwise error code 1
+*        is returned.
+*
+*        - self  : Reference to the assembler.
+*        - cursor: Reference to the read position, updated.
+*        - value : Reference to the result.
+********************************************************************************/
+static int shift(struct assembler* self, const char** cursor, uint32_t* value)
+{
+	if (factor(self, cursor, value)) return 1;
+
+	while (1)
+	{
+		const char* s = skip_space(*cursor);
+		uint32_t operand;
+
+		if ((s[0] != '<' && s[0] != '>') || s[1] != s[0]) return 0;
+
+		*cursor = s + 2;
+		if (factor(self, cursor, &operand)) return 1;
+		if (operand > 31) return error(self, "shift count out of range");
+		*value = s[0] == '<' ? *value << operand : *value >> operand;
+	}
+}
+
+/********************************************************************************
+* factor: Evaluates the number, name, negation, complement or parenthesized
+*         expression at the read position. Undefined names evaluate to 0 in
+*         the first pass, since they might be labels defined later on. The
+*         value 0 is returned after success, otherwise error code 1 is
+*         returned.
+*
+*         - self  : Reference to the assembler.
+*         - cursor: Reference to the read position, updated.
+*         - value : Reference to the result.
+********************************************************************************/
+static int factor(struct assembler* self, const char** cursor, uint32_t* value)
+{
+	const char* s = skip_space(*cursor);
+	char name[ASSEMBLER_NAME_SIZE];
+
+	if (*s == '(')
+	{
+		*cursor = s + 1;
+		if (expression(self, cursor, value)) return 1;
+		s = skip_space(*cursor);
+		if (*s != ')') return error(self, "expected )");
+		*cursor = s + 1;
+		return 0;
+	}
+	else if (*s == '-' || *s == '~')
+	{
+		*cursor = s + 1;
+		if (factor(self, cursor, value)) return 1;
+		*value = *s == '-' ? (uint32_t)(0) - *value : ~*value;
+		return 0;
+	}
+	else if (isdigit((unsigned char)(*s)))
+	{
+		const bool binary = s[0] == '0' && (s[1] == 'b' || s[1] == 'B');
+		char* end;
+		const unsigned long long number = strtoull(binary ? s + 2 : s, &end, binary ? 2 : 0);
+
+		if (number > UINT32_MAX || isalnum((unsigned char)(*end)) || *end == '_') return error(self, "invalid number");
+		*value = (uint32_t)(number);
+		*cursor = end;
+		return 0;
+	}
+	else if (!identifier(&s, name))
+	{
+		*cursor = s;
+		if (lookup(self, name, value)) return 0;
+
+		if (self->pass == 1)
+		{
+			*value = 0;
+			self->unresolved = true;
+			return 0;
+		}
+		return error(self, "undefined symbol %s", name);
+	}
+	else
+	{
+		return error(self, "expected operand");
+	}
+}
+
+/********************************************************************************
+* identifier: Reads the name at the read position, which starts with a letter
+*             or underscore followed by letters, digits and underscores. The
+*             value 0 is returned after success, otherwise error code 1 is
+*             returned and the read position is left as it is.
+*
+*             - cursor: Reference to the read position, updated.
+*             - name  : Buffer for the name (ASSEMBLER_NAME_SIZE characters).
+********************************************************************************/
+static int identifier(const char** cursor, char* name)
+{
+	const char* s = *cursor;
+	size_t length = 0;
+
+	if (!isalpha((unsigned char)(*s)) && *s != '_') return 1;
+
+	while (isalnum((unsigned char)(s[length])) || s[length] == '_')
+	{
+		if (length == ASSEMBLER_NAME_SIZE - 1) return 1;
+		name[length] = s[length];
+		length++;
+	}
+
+	name[length] = '\0';
+	*cursor = s + length;
+	return 0;
+}
+
+/********************************************************************************
+* define: Defines a label or constant with specified name and value. The value
+*         0 is returned after success. Otherwise if the name is already in
+*         use, error code 1 is returned.
+*
+*         - self : Reference to the assembler.
+*         - name : Name of the symbol.
+*         - value: Value of the symbol.
+********************************************************************************/
+static int define(struct assembler* self, const char* name, const uint32_t value)
+{
+	uint32_t previous;
+
+	if (lookup(self, name, &previous)) return error(self, "symbol %s already defined", name);
+
+	if (self->symbol_count == self->symbol_capacity)
+	{
+		const size_t new_capacity = self->symbol_capacity ? self->symbol_capacity * 2 : 32;
+		struct symbol* copy = (struct symbol*)realloc(self->symbols, new_capacity * sizeof(struct symbol));
+
+		if (!copy) return error(self, "out of memory");
+		self->symbols = copy;
+		self->symbol_capacity = new_capacity;
+	}
+
+	strcpy(self->symbols[self->symbol_count].name, name);
+	self->symbols[self->symbol_count++].value = value;
+	return 0;
+}
+
+/********************************************************************************
+* lookup: Looks up the value of the symbol or cpu.h constant with specified
+*         name. Returns true if the name is defined.
+*
+*         - self : Reference to the assembler.
+*         - name : Name of the symbol.
+*         - value: Reference to the value, stored if the name is defined.
+********************************************************************************/
+static bool lookup(const struct assembler* self, const char* name, uint32_t* value)
+{
+	for (size_t i = 0; i < self->symbol_count; ++i)
+	{
+		if (strcmp(self->symbols[i].name, name) == 0)
+		{
+			*value = self->symbols[i].value;
+			return true;
+		}
+	}
+	return lookup_name(constants, sizeof(constants) / sizeof(constants[0]), name, value);
+}
+
+/********************************************************************************
+* lookup_name: Looks up the value of specified name in specified table.
+*              Returns true if the name is found.
+*
+*              - names: The table of names.
+*              - count: Number of names in the table.
+*              - name : The name to look up.
+*              - value: Reference to the value, stored if the name is found.
+********************************************************************************/
+static bool lookup_name(const struct name* names, const size_t count, const char* name, uint32_t* value)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (strcmp(names[i].name, name) == 0)
+		{
+			*value = names[i].value;
+			return true;
+		}
+	}
+	return false;
+}
+
+/********************************************************************************
+* append_data: Appends specified word to the initial data. The value 0 is
+*              returned after success, otherwise error code 1 is returned.
+*
+*              - self : Reference to the assembler.
+*              - value: The word to append.
+********************************************************************************/
+static int append_data(struct assembler* self, const uint32_t value)
+{
+	if (!self->has_data_address) return error(self, ".word without preceding .data");
+	if (self->data_size == UINT16_MAX) return error(self, "too much data");
+
+	if (self->data_size == self->data_capacity)
+	{
+		const size_t new_capacity = self->data_capacity ? self->data_capacity * 2 : 32;
+		uint32_t* copy = (uint32_t*)realloc(self->data, new_capacity * sizeof(uint32_t));
+
+		if (!copy) return error(self, "out of memory");
+		self->data = copy;
+		self->data_capacity = new_capacity;
+	}
+
+	self->data[self->data_size++] = value;
+	return 0;
+}
+
+/********************************************************************************
+* build_image: Builds the program image from the output of the second pass.
+*              The value 0 is returned after success, otherwise error code 1
+*              is returned.
+*
+*              - self : Reference to the assembler.
+*              - image: Reference to the image pointer.
+*              - size : Reference to the image size.
+********************************************************************************/
+static int build_image(struct assembler* self, uint32_t** image, size_t* size)
+{
+	struct program_image_header header;
+	const uint16_t code_address = program_image_code_address(self->vector_count);
+	uint32_t* words;
+
+	if (self->data_address > UINT16_MAX) return error(self, "data address out of range");
+
+	header.magic = PROGRAM_IMAGE_MAGIC;
+	header.version = PROGRAM_IMAGE_VERSION;
+	header.entry = (uint16_t)(self->has_entry ? self->entry : code_address);
+	header.vector_count = self->vector_count;
+	header.code_size = (uint16_t)(self->address - code_address);
+	header.data_address = (uint16_t)(self->data_address);
+	header.data_size = (uint16_t)(self->data_size);
+
+	if (self->has_entry && (self->entry < code_address || self->entry >= self->address))
+	{
+		return error(self, "entry outside the code");
+	}
+
+	for (uint16_t i = 0; i < self->vector_count; ++i)
+	{
+		if (self->vectors[i] != PROGRAM_IMAGE_NO_VECTOR && (self->vectors[i] < code_address || self->vectors[i] >= self->address))
+		{
+			return error(self, "interrupt handler outside the code");
+		}
+	}
+
+	*size = program_image_size(&header);
+	words = (uint32_t*)malloc(*size);
+	if (!words) return error(self, "out of memory");
+
+	memcpy(words, &header, sizeof(header));
+	memcpy(words + sizeof(header) / sizeof(uint32_t), self->vectors, self->vector_count * sizeof(uint32_t));
+	memcpy((uint32_t*)(program_image_code((const struct program_image_header*)(words))),
+	       self->code + code_address, header.code_size * sizeof(uint32_t));
+	if (self->data_size)
+	{
+		memcpy((uint32_t*)(program_image_data((const struct program_image_header*)(words))),
+		       self->data, self->data_size * sizeof(uint32_t));
+	}
+
+	*image = words;
+	return 0;
+}
+
+/********************************************************************************
+* error: Stores an error message on the format "line <number>: <error>" in the
+*        message buffer of the assembler. Error code 1 is always returned.
+*
+*        - self  : Reference to the assembler.
+*        - format: Format string of the error, followed by its arguments.
+********************************************************************************/
+static int error(struct assembler* self, const char* format, ...)
+{
+	va_list arguments;
+	int length = snprintf(self->message, self->message_size, "line %u: ", self->line);
+
+	if (length < 0 || (size_t)(length) >= self->message_size) return 1;
+
+	va_start(arguments, format);
+	vsnprintf(self->message + length, self->message_size - (size_t)(length), format, arguments);
+	va_end(arguments);
+	return 1;
+}
+
+/********************************************************************************
+* skip_space: Returns specified position moved past any whitespace.
+*
+*             - s: The position.
+********************************************************************************/
+static inline const char* skip_space(const char* s)
+{
+	while (isspace((unsigned char)(*s))) s++;
+	return s;
+}
@@ -0,0 +1,65 @@
+/********************************************************************************
+* assembler.h: Contains function declarations for the host assembler, which
+*              translates assembly source to a program image, see
+*              program_image.h.
+*
+*              Each line of the source holds an optional label, followed by
+*              an instruction or a directive. Text after a ; is ignored:
+*
+*              [label:] [mnemonic [op1[, op2]]] [; comment]
+*
+*              The mnemonics are the OP codes of cpu.h, for instance LDI,
+*              OUT or JMP. Operands are expressions of numbers (decimal,
+*              hexadecimal with prefix 0x or binary with prefix 0b), labels,
+*              constants and the names of cpu.h, such as R16, PORTA or
+*              PCIEA, combined with the operators |, &, ^, +, -, << and >>
+*              and parentheses. Operators are evaluated from left to right,
+*              where << and >> bind tighter than the others. Second operands
+*              too wide for the instruction word get an extension word.
+*              The vector table and the code must fit in the program memory
+*              of the target, see PROGRAM_MEMORY_ADDRESS_WIDTH.
+*
+*              The following directives are supported:
+*
+*              .equ <name>, <value>    : Defines a constant.
+*              .vector <vect>, <label> : Sets the handler of the interrupt
+*                                        vector, for instance PCINT_vect.
+*                                        Must precede the first instruction,
+*                                        since the code is placed right
+*                                        after the vector table.
+*              .entry <label>          : Sets the address run after reset,
+*                                        the first instruction as default.
+*              .data <address>         : Sets the data memory address of
+*                                        the initial data.
+*              .word <value>[, ...]    : Appends words to the initial data.
+********************************************************************************/
+#ifndef ASSEMBLER_H_
+#define ASSEMBLER_H_
+
+/* Include directives: */
+#include "cpu.h"
+#include "program_image.h"
+
+/********************************************************************************
+* assembler_assemble: Assembles specified source to a program image, which is
+*                     allocated on the heap and must be freed by the caller.
+*                     The value 0 is returned after successful assembly, in
+*                     which case the image and its size in bytes are stored
+*                     at the referenced locations. Otherwise if the source
+*                     contains an error, a message on the format
+*                     "line <number>: <error>" is stored in the referenced
+*                     buffer and error code 1 is returned.
+*
+*                     - source      : The assembly source, null terminated.
+*                     - image       : Reference to the image pointer.
+*                     - size        : Reference to the image size.
+*                     - message     : Buffer for the error message.
+*                     - message_size: Size of the error message buffer.
+********************************************************************************/
+int assembler_assemble(const char* source,
+                       uint32_t** image,
+                       size_t* size,
+                       char* message,
+                       const size_t message_size);
+
+#endif /* ASSEMBLER_H_ */
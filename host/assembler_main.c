@@ -0,0 +1,102 @@
+/********************************************************************************
+* assembler_main.c: Assembles a source file to a program image file.
+*
+*                   Usage: 32bitcpu_asm <source file> <image file>
+*
+*                   See host/assembler.h for the source syntax. The image can
+*                   be run with the -p option of 32bitcpu and 32bitcpu_batch.
+*                   Errors are printed to stderr on the format
+*                   "<source file>:<line>: <error>".
+********************************************************************************/
+#include "cpu_context.h"
+#include "assembler.h"
+#include <string.h>
+
+/* Static functions: */
+static char* read_source(const char* path);
+
+/********************************************************************************
+* main: Assembles the source file and writes the image file. Returns 0 after
+*       success, otherwise 1.
+*
+*       - argc: Number of arguments.
+*       - argv: The arguments, see usage above.
+********************************************************************************/
+int main(int argc, char** argv)
+{
+	char message[256];
+	char* source;
+	uint32_t* image;
+	size_t size;
+	FILE* file;
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <source file> <image file>\n", argv[0]);
+		return 1;
+	}
+
+	source = read_source(argv[1]);
+	if (!source)
+	{
+		fprintf(stderr, "Failed to read source file %s!\n", argv[1]);
+		return 1;
+	}
+
+	if (assembler_assemble(source, &image, &size, message, sizeof(message)))
+	{
+		fprintf(stderr, "%s:%s\n", argv[1], strncmp(message, "line ", 5) == 0 ? message + 5 : message);
+		free(source);
+		return 1;
+	}
+
+	free(source);
+	file = fopen(argv[2], "wb");
+
+	if (!file || fwrite(image, 1, size, file) != size)
+	{
+		fprintf(stderr, "Failed to write image file %s!\n", argv[2]);
+		if (file) fclose(file);
+		free(image);
+		return 1;
+	}
+
+	fclose(file);
+	free(image);
+	return 0;
+}
+
+/********************************************************************************
+* read_source: Reads the source file at specified path into a null terminated
+*              string, which must be freed by the caller. Returns 0 if the file
+*              can't be read.
+*
+*              - path: Path to the source file.
+********************************************************************************/
+static char* read_source(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	char* source;
+	long length;
+
+	if (!file) return 0;
+
+	if (fseek(file, 0, SEEK_END) || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET))
+	{
+		fclose(file);
+		return 0;
+	}
+
+	source = (char*)malloc((size_t)(length) + 1);
+
+	if (!source || fread(source, 1, (size_t)(length), file) != (size_t)(length))
+	{
+		free(source);
+		fclose(file);
+		return 0;
+	}
+
+	source[length] = '\0';
+	fclose(file);
+	return source;
+}
@@ -0,0 +1,376 @@
+/********************************************************************************
+* batch.c: Contains function definitions for running large sets of
+*          independent CPU instances on a pool of work-stealing threads.
+********************************************************************************/
+#include "batch.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+
+/* Macro definitions: */
+#define INSTRUCTIONS_PER_RUN 1000 /* Maximum number of instructions run per call. */
+#define BATCH_MAX_THREADS    256  /* Maximum number of worker threads. */
+
+/********************************************************************************
+* batch_queue: Queue of work units owned by a worker thread, holding the unit
+*              indices head to tail - 1. Each unit is a single job, or a group
+*              of LOCKSTEP_LANES jobs in lockstep mode. The owner takes units
+*              from the head, while other workers steal units from the tail.
+********************************************************************************/
+struct batch_queue
+{
+	pthread_mutex_t lock; /* Protects head and tail. */
+	size_t head;          /* Index of the next unit to take. */
+	size_t tail;          /* Index after the last unit to steal. */
+};
+
+/********************************************************************************
+* batch_worker: Worker thread of the batch runner.
+********************************************************************************/
+struct batch_worker
+{
+	pthread_t thread;             /* The worker thread. */
+	struct batch_queue queue;     /* Jobs owned by the worker. */
+	struct batch_worker* workers; /* All workers, for stealing. */
+	unsigned worker_count;        /* Number of workers. */
+	unsigned index;               /* Index of this worker. */
+	struct batch_job* jobs;       /* All jobs. */
+	size_t job_count;             /* Number of jobs. */
+	bool lockstep;                /* Indicates if the units are run in lockstep. */
+};
+
+/* Static functions: */
+static void* work(void* argument);
+static bool take(struct batch_queue* queue,
+                 size_t* job);
+static bool steal(struct batch_queue* queue,
+                  size_t* job);
+static void run_unit(struct batch_worker* self,
+                     const size_t unit);
+static int job_start(struct batch_job* job);
+static void job_finish(struct batch_job* job);
+static void run_job(struct batch_job* job);
+static void run_lockstep(struct batch_job* jobs,
+                         const size_t count);
+
+/********************************************************************************
+* batch_job_init: Initializes specified job to run the program stored in the
+*                 referenced program memory with input events from specified
+*                 stimulus file, if any.
+*
+*                 - job           : Reference to the job.
+*                 - program_memory: Reference to the program memory, shared
+*                                   by all jobs.
+*                 - stimulus      : Path to the stimulus file, or 0.
+*                 - instructions  : Instruction budget of the job.
+********************************************************************************/
+void batch_job_init(struct batch_job* job,
+                    struct program_memory* program_memory,
+                    const char* stimulus,
+                    const uint64_t instructions)
+{
+	memset(&job->port, 0, sizeof(job->port));
+	cpu_context_init(&job->context, program_memory, &job->port);
+	job->stimulus = stimulus;
+	job->instructions = instructions;
+	job->retired = 0;
+	job->output = 0;
+	job->status = 0;
+	return;
+}
+
+/********************************************************************************
+* batch_run: Runs specified jobs on specified number of worker threads (one
+*            per online processor if 0). The work units are split evenly
+*            between the workers up front, after which idle workers steal
+*            units from the others. The value 0 is returned if all jobs were
+*            run successfully, otherwise error code 1.
+*
+*            - jobs    : The jobs to run.
+*            - count   : Number of jobs.
+*            - threads : Number of worker threads.
+*            - lockstep: Indicates if the jobs are run in lockstep.
+********************************************************************************/
+int batch_run(struct batch_job* jobs,
+              const size_t count,
+              unsigned threads,
+              const bool lockstep)
+{
+	const size_t units = lockstep ? (count + LOCKSTEP_LANES - 1) / LOCKSTEP_LANES : count;
+	struct batch_worker* workers;
+	unsigned started = 0;
+	int status = 0;
+
+	if (count == 0) return 0;
+
+	if (threads == 0)
+	{
+		const int online = get_nprocs();
+		threads = online > 0 ? (unsigned)(online) : 1;
+	}
+	if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+	if (threads > units) threads = (unsigned)(units);
+
+	workers = (struct batch_worker*)calloc(threads, sizeof(struct batch_worker));
+	if (!workers) return 1;
+
+	program_memory_write_ctx(&jobs[0].context); /* Written once, before it's shared. */
+
+	for (unsigned i = 0; i < threads; ++i)
+	{
+		pthread_mutex_init(&workers[i].queue.lock, 0);
+		workers[i].queue.head = units * i / threads;
+		workers[i].queue.tail = units * (i + 1) / threads;
+		workers[i].workers = workers;
+		workers[i].worker_count = threads;
+		workers[i].index = i;
+		workers[i].jobs = jobs;
+		workers[i].job_count = count;
+		workers[i].lockstep = lockstep;
+	}
+
+	for (; started < threads; ++started)
+	{
+		if (pthread_create(&workers[started].thread, 0, work, &workers[started])) break;
+	}
+
+	if (started == 0)
+	{
+		work(&workers[0]); /* Runs all jobs on the calling thread instead. */
+	}
+
+	for (unsigned i = 0; i < started; ++i)
+	{
+		pthread_join(workers[i].thread, 0);
+	}
+
+	for (unsigned i = 0; i < threads; ++i)
+	{
+		pthread_mutex_destroy(&workers[i].queue.lock);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (jobs[i].status) status = 1;
+	}
+
+	free(workers);
+	return status;
+}
+
+/********************************************************************************
+* work: Runs units from the queue of specified worker until it's empty, then
+*       steals units from the other workers until all queues are empty.
+*
+*       - argument: Reference to the worker.
+********************************************************************************/
+static void* work(void* argument)
+{
+	struct batch_worker* self = (struct batch_worker*)(argument);
+	size_t unit;
+
+	while (take(&self->queue, &unit))
+	{
+		run_unit(self, unit);
+	}
+
+	for (unsigned i = 1; i < self->worker_count;)
+	{
+		struct batch_worker* victim = &self->workers[(self->index + i) % self->worker_count];
+
+		if (steal(&victim->queue, &unit)) run_unit(self, unit);
+		else ++i; /* The victim is out of units, tries the next one. */
+	}
+	return 0;
+}
+
+/********************************************************************************
+* take: Takes the unit at the head of specified queue. Returns true if a unit
+*       was taken, otherwise false if the queue is empty.
+*
+*       - queue: Reference to the queue.
+*       - job  : Reference to the index of the taken unit.
+********************************************************************************/
+static bool take(struct batch_queue* queue,
+                 size_t* job)
+{
+	bool taken = false;
+	pthread_mutex_lock(&queue->lock);
+
+	if (queue->head < queue->tail)
+	{
+		*job = queue->head++;
+		taken = true;
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+	return taken;
+}
+
+/********************************************************************************
+* steal: Steals the unit at the tail of specified queue. Returns true if a
+*        unit was stolen, otherwise false if the queue is empty.
+*
+*        - queue: Reference to the queue.
+*        - job  : Reference to the index of the stolen unit.
+********************************************************************************/
+static bool steal(struct batch_queue* queue,
+                  size_t* job)
+{
+	bool stolen = false;
+	pthread_mutex_lock(&queue->lock);
+
+	if (queue->head < queue->tail)
+	{
+		*job = --queue->tail;
+		stolen = true;
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+	return stolen;
+}
+
+/********************************************************************************
+* run_unit: Runs specified work unit of specified worker, either a single job
+*           or a group of jobs in lockstep.
+*
+*           - self: Reference to the worker.
+*           - unit: Index of the unit.
+********************************************************************************/
+static void run_unit(struct batch_worker* self,
+                     const size_t unit)
+{
+	if (self->lockstep)
+	{
+		const size_t first = unit * LOCKSTEP_LANES;
+		const size_t left = self->job_count - first;
+		run_lockstep(&self->jobs[first], left < LOCKSTEP_LANES ? left : LOCKSTEP_LANES);
+	}
+	else
+	{
+		run_job(&self->jobs[unit]);
+	}
+	return;
+}
+
+/********************************************************************************
+* job_start: Loads the stimulus of specified job and resets its CPU. The value
+*            0 is returned if the job is ready to run, otherwise error code 1
+*            is returned if the stimulus couldn't be loaded.
+*
+*            - job: Reference to the job.
+********************************************************************************/
+static int job_start(struct batch_job* job)
+{
+	struct cpu_context* context = &job->context;
+
+	if (job->stimulus && port_host_load_stimulus_ctx(context, job->stimulus))
+	{
+		job->status = 1;
+		return 1;
+	}
+
+	control_unit_reset_ctx(context);
+	port_host_advance_ctx(context, 0);
+	job->retired = 0;
+	return 0;
+}
+
+/********************************************************************************
+* job_finish: Collects the output values of specified job and frees its
+*             stimulus.
+*
+*             - job: Reference to the job.
+********************************************************************************/
+static void job_finish(struct batch_job* job)
+{
+	job->output = port_host_output_ctx(&job->context);
+	port_host_free_ctx(&job->context);
+	return;
+}
+
+/********************************************************************************
+* run_job: Resets the CPU of specified job and runs it until the instruction
+*          budget is spent. Input events are applied at the instruction counts
+*          given by the stimulus, just as for a single CPU in host/main.c.
+*
+*          - job: Reference to the job.
+********************************************************************************/
+static void run_job(struct batch_job* job)
+{
+	struct cpu_context* context = &job->context;
+
+	if (job_start(job)) return;
+
+	while (job->retired < job->instructions)
+	{
+		const uint64_t next_event = port_host_next_event_ctx(context);
+		uint64_t count = job->instructions - job->retired;
+
+		if (next_event > job->retired && next_event - job->retired < count) count = next_event - job->retired;
+		if (count > INSTRUCTIONS_PER_RUN) count = INSTRUCTIONS_PER_RUN;
+
+		job->retired += control_unit_run_ctx(context, (uint32_t)(count));
+		port_host_advance_ctx(context, job->retired);
+	}
+
+	job_finish(job);
+	return;
+}
+
+/********************************************************************************
+* run_lockstep: Resets the CPUs of specified jobs and runs them in lockstep
+*               until their instruction budgets are spent. Each run is cut at
+*               the next input event of any of the jobs, so that every job
+*               gets its events at the same instruction counts as in run_job.
+*               Jobs are left out of the group when their budgets are spent.
+*
+*               - jobs : The jobs to run (no more than LOCKSTEP_LANES).
+*               - count: Number of jobs.
+********************************************************************************/
+static void run_lockstep(struct batch_job* jobs,
+                         const size_t count)
+{
+	struct cpu_context* contexts[LOCKSTEP_LANES];
+	struct batch_job* running[LOCKSTEP_LANES];
+	uint64_t retired = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		(void)job_start(&jobs[i]);
+	}
+
+	while (1)
+	{
+		uint64_t run = INSTRUCTIONS_PER_RUN;
+		uint8_t lanes = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint64_t next_event = port_host_next_event_ctx(&jobs[i].context);
+
+			if (jobs[i].status || jobs[i].retired >= jobs[i].instructions) continue;
+			if (jobs[i].instructions - retired < run) run = jobs[i].instructions - retired;
+			if (next_event > retired && next_event - retired < run) run = next_event - retired;
+
+			contexts[lanes] = &jobs[i].context;
+			running[lanes++] = &jobs[i];
+		}
+
+		if (lanes == 0) break;
+
+		retired += lockstep_run(contexts, lanes, (uint32_t)(run));
+
+		for (uint8_t lane = 0; lane < lanes; ++lane)
+		{
+			running[lane]->retired = retired;
+			port_host_advance_ctx(contexts[lane], retired);
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!jobs[i].status) job_finish(&jobs[i]);
+	}
+	return;
+}
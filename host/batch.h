@@ -0,0 +1,73 @@
+/********************************************************************************
+* batch.h: Contains function declarations for running large sets of
+*          independent CPU instances on the host, for instance the same
+*          program against many different stimulus files.
+*
+*          Each job holds its own CPU context and simulated I/O ports, while
+*          the program memory is shared by all jobs without being copied.
+*          The jobs are distributed over a pool of worker threads, where each
+*          worker takes jobs from the front of its own queue and steals jobs
+*          from the back of the other queues when its own queue is empty.
+*          Every job runs until its instruction budget is spent, after which
+*          its final registers, data memory and stack are left in its
+*          context. Optionally, groups of LOCKSTEP_LANES jobs are run in
+*          lockstep on vector instructions instead, see lockstep.h.
+********************************************************************************/
+#ifndef BATCH_H_
+#define BATCH_H_
+
+/* Include directives: */
+#include "cpu_context.h"
+#include "port_host.h"
+#include "lockstep.h"
+
+/********************************************************************************
+* batch_job: A CPU instance run by the batch runner.
+********************************************************************************/
+struct batch_job
+{
+	struct cpu_context context; /* State of the CPU, holds the final state after the run. */
+	struct port_host port;      /* Simulated I/O ports of the CPU. */
+	const char* stimulus;       /* Path to the stimulus file, 0 for no input events. */
+	uint64_t instructions;      /* Instruction budget of the job. */
+	uint64_t retired;           /* Number of retired instructions after the run. */
+	uint32_t output;            /* Output values of I/O port A after the run. */
+	int status;                 /* 0 after successful run, 1 if the stimulus couldn't be loaded. */
+};
+
+/********************************************************************************
+* batch_job_init: Initializes specified job to run the program stored in the
+*                 referenced program memory with input events from specified
+*                 stimulus file, if any.
+*
+*                 - job           : Reference to the job.
+*                 - program_memory: Reference to the program memory, shared
+*                                   by all jobs.
+*                 - stimulus      : Path to the stimulus file, or 0.
+*                 - instructions  : Instruction budget of the job.
+********************************************************************************/
+void batch_job_init(struct batch_job* job,
+                    struct program_memory* program_memory,
+                    const char* stimulus,
+                    const uint64_t instructions);
+
+/********************************************************************************
+* batch_run: Runs specified jobs on specified number of worker threads (one
+*            per online processor if 0). The program memory referenced by the
+*            jobs is written before the workers start and must not be
+*            rewritten while they run. If lockstep is set, consecutive jobs
+*            are run in groups of LOCKSTEP_LANES through lockstep_run. The
+*            value 0 is returned if all jobs were run successfully. Otherwise
+*            if any job failed, error code 1 is returned.
+*
+*            - jobs    : The jobs to run.
+*            - count   : Number of jobs.
+*            - threads : Number of worker threads.
+*            - lockstep: Indicates if the jobs are run in lockstep.
+********************************************************************************/
+int batch_run(struct batch_job* jobs,
+              const size_t count,
+              unsigned threads,
+              const bool lockstep);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,133 @@
+/********************************************************************************
+* batch_main.c: Runs the program against many stimulus files in parallel.
+*
+*               Usage: 32bitcpu_batch [-l] [-j threads] [-p image] <instructions> <stimulus file>...
+*
+*               One CPU instance is run per stimulus file for the specified
+*               number of instructions, distributed over the specified
+*               number of threads (one per processor as default). With -l
+*               the instances are run in lockstep, see lockstep.h. With -p
+*               the program is loaded from the image file, see
+*               host/assembler.h, instead of the built-in program. For each
+*               instance the final state is printed to stdout on the format
+*               "<stimulus file> <output> <pc> <state hash>", where the state
+*               hash covers the CPU registers, status register and data
+*               memory, so that runs can be compared against a reference.
+*               The elapsed time is printed to stderr.
+********************************************************************************/
+#include "batch.h"
+#include "program_image_host.h"
+#include <string.h>
+#include <time.h>
+
+/* Static functions: */
+static uint32_t state_hash(const struct cpu_context* context);
+
+/********************************************************************************
+* main: Runs one CPU instance per stimulus file and prints the final states.
+*       Returns 0 after successful runs, otherwise 1.
+*
+*       - argc: Number of arguments.
+*       - argv: The arguments, see usage above.
+********************************************************************************/
+int main(int argc, char** argv)
+{
+	static struct program_memory program_memory; /* Shared by all instances. */
+	unsigned long long instructions;
+	unsigned threads = 0;
+	struct batch_job* jobs;
+	size_t count;
+	const char* image = 0;
+	bool lockstep = false;
+	int first = 1;
+	int status;
+	struct timespec start, stop;
+
+	if (argc > first && strcmp(argv[first], "-l") == 0)
+	{
+		lockstep = true;
+		first++;
+	}
+
+	if (argc > first + 1 && strcmp(argv[first], "-j") == 0)
+	{
+		if (sscanf(argv[first + 1], "%u", &threads) != 1) first = argc;
+		else first += 2;
+	}
+
+	if (argc > first + 1 && strcmp(argv[first], "-p") == 0)
+	{
+		image = argv[first + 1];
+		first += 2;
+	}
+
+	if (argc - first < 2 || sscanf(argv[first], "%llu", &instructions) != 1)
+	{
+		fprintf(stderr, "Usage: %s [-l] [-j threads] [-p image] <instructions> <stimulus file>...\n", argv[0]);
+		return 1;
+	}
+
+	count = (size_t)(argc - first - 1);
+	jobs = (struct batch_job*)malloc(count * sizeof(struct batch_job));
+	if (!jobs) return 1;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		batch_job_init(&jobs[i], &program_memory, argv[first + 1 + i], instructions);
+	}
+
+	if (image && program_image_host_load_ctx(&jobs[0].context, image))
+	{
+		free(jobs);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	status = batch_run(jobs, count, threads, lockstep);
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (jobs[i].status)
+		{
+			printf("%s failed\n", jobs[i].stimulus);
+			continue;
+		}
+		printf("%s %05lx %u %08lx\n", jobs[i].stimulus, (unsigned long)(jobs[i].output),
+		       (unsigned)(jobs[i].context.pc), (unsigned long)(state_hash(&jobs[i].context)));
+	}
+
+	{
+		const double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+		fprintf(stderr, "%lu instances x %llu instructions in %.3f s\n", (unsigned long)(count), instructions, seconds);
+	}
+
+	free(jobs);
+	return status;
+}
+
+/********************************************************************************
+* state_hash: Returns an FNV-1a hash of the CPU registers, status register and
+*             data memory of specified context. The stored content is hashed
+*             without calling the read handlers of the I/O registers, so that
+*             hashing doesn't consume received bytes.
+*
+*             - context: Reference to the CPU context.
+********************************************************************************/
+static uint32_t state_hash(const struct cpu_context* context)
+{
+	uint32_t hash = 2166136261UL;
+
+	for (uint16_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+	{
+		hash = (hash ^ context->reg[i]) * 16777619UL;
+	}
+
+	hash = (hash ^ context->sr) * 16777619UL;
+
+	for (uint16_t i = 0; i < DATA_MEMORY_ADDRESS_WIDTH; ++i)
+	{
+		hash = (hash ^ context->data_memory.data[i]) * 16777619UL;
+	}
+	return hash;
+}
@@ -0,0 +1,72 @@
+/********************************************************************************
+* benchmark_clock_host.c: Contains function definitions for the benchmark clock
+*                         on the host. On x86 the time stamp counter is used,
+*                         whose frequency is calibrated against the monotonic
+*                         clock when the clock is started. Other processors
+*                         count nanoseconds instead.
+********************************************************************************/
+#include "benchmark.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_CLOCK_TSC 1
+#else
+#define BENCHMARK_CLOCK_TSC 0
+#endif
+
+/* Macro definitions: */
+#define CALIBRATION_TIME_NS 50000000 /* Calibration time of the time stamp counter (50 ms). */
+
+/* Static functions: */
+static uint64_t nanoseconds(void);
+
+/* Static variables: */
+static uint32_t frequency = 1000000000; /* Clock ticks per second. */
+
+/********************************************************************************
+* benchmark_clock_init: Calibrates the frequency of the time stamp counter, if
+*                       used. Otherwise nothing is done.
+********************************************************************************/
+void benchmark_clock_init(void)
+{
+#if BENCHMARK_CLOCK_TSC
+	const uint64_t start = nanoseconds();
+	const uint64_t start_ticks = __rdtsc();
+	uint64_t elapsed;
+
+	while ((elapsed = nanoseconds() - start) < CALIBRATION_TIME_NS);
+	frequency = (uint32_t)((__rdtsc() - start_ticks) * 1000000000ULL / elapsed);
+#endif /* BENCHMARK_CLOCK_TSC */
+	return;
+}
+
+/********************************************************************************
+* benchmark_clock_ticks: Returns the time stamp counter, or the number of
+*                        nanoseconds of the monotonic clock.
+********************************************************************************/
+uint64_t benchmark_clock_ticks(void)
+{
+#if BENCHMARK_CLOCK_TSC
+	return __rdtsc();
+#else
+	return nanoseconds();
+#endif /* BENCHMARK_CLOCK_TSC */
+}
+
+/********************************************************************************
+* benchmark_clock_frequency: Returns the number of clock ticks per second.
+********************************************************************************/
+uint32_t benchmark_clock_frequency(void)
+{
+	return frequency;
+}
+
+/********************************************************************************
+* nanoseconds: Returns the time of the monotonic clock in nanoseconds.
+********************************************************************************/
+static uint64_t nanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec) * 1000000000ULL + (uint64_t)(now.tv_nsec);
+}
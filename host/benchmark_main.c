@@ -0,0 +1,32 @@
+/********************************************************************************
+* benchmark_main.c: Runs the benchmark suite on the host.
+*
+*                   Usage: 32bitcpu_bench [instructions]
+*
+*                   Each workload and per-instruction kernel is run for the
+*                   specified number of instructions (10 000 000 as default).
+********************************************************************************/
+#include "benchmark.h"
+
+/* Macro definitions: */
+#define DEFAULT_INSTRUCTIONS 10000000 /* Number of instructions run per benchmark as default. */
+
+/********************************************************************************
+* main: Runs all benchmarks for specified number of instructions. Returns 0
+*       after successful runs, otherwise 1.
+*
+*       - argc: Number of arguments.
+*       - argv: The arguments, see usage above.
+********************************************************************************/
+int main(int argc, char** argv)
+{
+	unsigned long instructions = DEFAULT_INSTRUCTIONS;
+
+	if (argc > 2 || (argc > 1 && sscanf(argv[1], "%lu", &instructions) != 1))
+	{
+		fprintf(stderr, "Usage: %s [instructions]\n", argv[0]);
+		return 1;
+	}
+
+	return benchmark_run_all((uint32_t)(instructions));
+}
@@ -0,0 +1,38 @@
+/********************************************************************************
+* check.h: Contains the assertion macro of the unit tests in host/, which are
+*          small programs run by ctest, see CMakeLists.txt. Each failed check
+*          is printed to stderr, and the test returns 1 from main if any
+*          check has failed.
+********************************************************************************/
+#ifndef CHECK_H_
+#define CHECK_H_
+
+/* Include directives: */
+#include <stdio.h>
+
+/* Static variables: */
+static int check_failures = 0; /* Number of failed checks. */
+
+/********************************************************************************
+* CHECK: Checks that specified condition holds, otherwise the condition and
+*        its location are printed to stderr and the failure is counted.
+*
+*        - condition: The condition to check.
+********************************************************************************/
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #condition); \
+			check_failures++; \
+		} \
+	} while (0)
+
+/********************************************************************************
+* CHECK_RESULT: Returns the exit status of a test, 0 if all checks have
+*               passed, otherwise 1.
+********************************************************************************/
+#define CHECK_RESULT() (check_failures ? 1 : 0)
+
+#endif /* CHECK_H_ */
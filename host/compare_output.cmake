@@ -0,0 +1,15 @@
+# Runs two commands and fails unless both succeed and print the same output to
+# stdout. Used by the regression checks in CMakeLists.txt, where the commands
+# are passed as lists:
+#
+#   cmake -DFIRST="<command>;<args>" -DSECOND="<command>;<args>" -P compare_output.cmake
+execute_process(COMMAND ${FIRST} OUTPUT_VARIABLE first_output RESULT_VARIABLE first_result)
+execute_process(COMMAND ${SECOND} OUTPUT_VARIABLE second_output RESULT_VARIABLE second_result)
+
+if(NOT first_result EQUAL 0 OR NOT second_result EQUAL 0)
+  message(FATAL_ERROR "Command failed: ${FIRST} (${first_result}), ${SECOND} (${second_result})")
+endif()
+
+if(NOT first_output STREQUAL second_output)
+  message(FATAL_ERROR "Output differs!\n${FIRST}:\n${first_output}\n${SECOND}:\n${second_output}")
+endif()
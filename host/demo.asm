@@ -0,0 +1,35 @@
+; demo.asm: The built-in program of program_memory.c as assembly source.
+;           Toggles LED1 on every pin change of BUTTON1 that reads high.
+;
+;           32bitcpu_asm host/demo.asm demo.img
+;           32bitcpu -p demo.img 10000000 host/button.txt
+
+.equ LED1, PORTA8
+.equ BUTTON1, PORTA11
+
+.vector PCINT_vect, ISR_PCINT
+
+main:
+	CALL setup
+main_loop:
+	SLEEP
+	JMP main_loop
+
+setup:
+	LDI R16, (1 << LED1)
+	OUT DDRA, R16
+	LDI R17, (1 << BUTTON1)
+	OUT PORTA, R17
+	SEI
+	LDI R24, (1 << PCIEA)
+	OUT ICR, R24
+	OUT PCMSKA, R17
+	RET
+
+ISR_PCINT:
+	IN R24, PINA
+	ANDI R24, (1 << BUTTON1)
+	BREQ ISR_PCINT_end
+	OUT PINA, R16
+ISR_PCINT_end:
+	RETI
@@ -0,0 +1,194 @@
+; flags.asm: Exercises the status flags of every ALU operation and every
+;            conditional branch on pseudo-random operands, while a timer
+;            interrupt modifies the flags between them. The outcome of the
+;            branches is folded into a signature in R3, which is written to
+;            I/O port A and data memory and moved through the stack and the
+;            remaining load, store and block instructions. Used by the
+;            regression checks in CMakeLists.txt, which compare builds with
+;            different options.
+;
+;            32bitcpu_asm host/flags.asm flags.img
+;            32bitcpu -p flags.img 1000000
+
+.vector TIMER_COMPA_vect, ISR_TIMER
+
+main:
+	LDI R16, 0x3FFFFF
+	OUT DDRA, R16
+	LDI R16, 97
+	OUT OCRA, R16
+	LDI R16, (1 << CTC) | (1 << CS0)
+	OUT TCCR, R16
+	LDI R16, (1 << OCIEA)
+	OUT ICR, R16
+	SEI
+	LDI R1, 12345      ; Seed of the pseudo-random generator.
+	LDI R2, 1103515245 ; Multiplier of the pseudo-random generator.
+	LDI R8, 13
+	CLR R9             ; Divisor for division by zero.
+	CLR R3
+loop:
+	MUL R1, R2
+	ADDI R1, 12345
+	MOV R5, R1
+	ROR R5, R8
+	MOV R4, R1
+	ADD R4, R5
+	CALL flags
+	MOV R4, R1
+	SUB R4, R5
+	CALL flags
+	MOV R4, R1
+	CP R4, R5
+	CALL flags
+	MOV R4, R1
+	CPI R4, 0x800
+	CALL flags
+	MOV R4, R1
+	AND R4, R5
+	CALL flags
+	MOV R4, R1
+	OR R4, R5
+	CALL flags
+	MOV R4, R1
+	XOR R4, R5
+	CALL flags
+	MOV R4, R1
+	ADDI R4, 0x7FF
+	CALL flags
+	MOV R4, R1
+	SUBI R4, 0xFFF
+	CALL flags
+	MOV R4, R1
+	ANDI R4, 0xF0F
+	CALL flags
+	MOV R4, R1
+	ORI R4, 0x101
+	CALL flags
+	MOV R4, R1
+	XORI R4, 0xAAA
+	CALL flags
+	MOV R4, R1
+	INC R4
+	CALL flags
+	MOV R4, R1
+	DEC R4
+	CALL flags
+	MOV R4, R1
+	LSL R4
+	CALL flags
+	MOV R4, R1
+	LSR R4
+	CALL flags
+	MOV R4, R1
+	MUL R4, R5
+	CALL flags
+	MOV R4, R1
+	MULH R4, R5
+	CALL flags
+	MOV R4, R1
+	DIV R4, R5
+	CALL flags
+	MOV R4, R1
+	MOD R4, R5
+	CALL flags
+	MOV R4, R1
+	DIV R4, R9
+	CALL flags
+	MOV R4, R1
+	MOD R4, R9
+	CALL flags
+	MOV R4, R1
+	LSLV R4, R5
+	CALL flags
+	MOV R4, R1
+	LSRV R4, R5
+	CALL flags
+	MOV R4, R1
+	ASR R4, R5
+	CALL flags
+	MOV R4, R1
+	ROL R4, R5
+	CALL flags
+	MOV R4, R1
+	ROR R4, R5
+	CALL flags
+	MOV R4, R1
+	CP R4, R5          ; Compare directly followed by a branch.
+	BRLT less
+	INC R10
+less:
+	CPI R5, 0x800
+	BRGE greater
+	ADD R10, R5
+greater:
+	STS 0x101, R10
+	CALL memory
+	JMP loop
+
+flags:              ; Folds the outcome of every branch into R3.
+	LDI R20, 0
+	LDI R21, 0
+	LDI R22, 0
+	LDI R23, 0
+	LDI R24, 0
+	LDI R25, 0
+	BREQ flags_breq
+	LDI R20, 1
+flags_breq:
+	BRNE flags_brne
+	LDI R21, 2
+flags_brne:
+	BRGE flags_brge
+	LDI R22, 4
+flags_brge:
+	BRGT flags_brgt
+	LDI R23, 8
+flags_brgt:
+	BRLE flags_brle
+	LDI R24, 16
+flags_brle:
+	BRLT flags_brlt
+	LDI R25, 32
+flags_brlt:
+	OR R20, R21
+	OR R20, R22
+	OR R20, R23
+	OR R20, R24
+	OR R20, R25
+	LDI R26, 6
+	ROL R3, R26
+	XOR R3, R20
+	OUT PORTA, R3
+	STS 0x100, R3
+	RET
+
+memory:             ; Moves the signature through the stack and data memory.
+	PUSH R3
+	PUSH R10
+	POP R13
+	POP R14
+	LDI R26, 0x20
+	LDI R27, 0x01
+	ST R26, R14
+	LD R15, R26
+	LDS R15, 0x100
+	LDI R28, PORTA
+	CLR R29
+	LDIO R17, R28
+	STIO R28, R13
+	IN R18, PINA
+	NOP
+	LDI R20, 0x108      ; Overlapping copy longer than one chunk.
+	LDI R21, 36
+	LDI R22, 0x100
+	MEMCPY R20, R22
+	LDI R20, 0x10C
+	LDI R21, 8
+	MEMSET R20, R15
+	RET
+
+ISR_TIMER:          ; Modifies the flags, which aren't saved.
+	INC R11
+	ADD R12, R11
+	RETI
@@ -0,0 +1,521 @@
+/********************************************************************************
+* lockstep.c: Contains function definitions for running several CPU instances
+*             of the same program in lockstep, see lockstep.h.
+********************************************************************************/
+#include "lockstep.h"
+
+/* Macro definitions: */
+#define LOCKSTEP_SETTLE 2 /* Number of instructions checked after an instruction outside the register file. */
+
+/********************************************************************************
+* lockstep_group: CPU registers, status registers, program counters and
+*                 instruction counters of the lanes, stored as structure of
+*                 arrays. The remaining state of each lane is kept in its
+*                 context.
+********************************************************************************/
+struct lockstep_group
+{
+	uint32_t reg[CPU_REGISTER_ADDRESS_WIDTH][LOCKSTEP_LANES]; /* CPU registers R0 - R31 of each lane. */
+	uint32_t sr[LOCKSTEP_LANES];      /* Status register of each lane. */
+	uint32_t pc[LOCKSTEP_LANES];      /* Program counter of each lane. */
+	uint32_t retired[LOCKSTEP_LANES]; /* Number of retired instructions of each lane. */
+	uint64_t instructions[LOCKSTEP_LANES]; /* Instructions retired since reset of each lane. */
+	uint64_t deadline[LOCKSTEP_LANES];     /* Timer deadline of each lane. */
+	bool sleeping[LOCKSTEP_LANES];         /* Indicates if each lane is sleeping. */
+	uint8_t settle[LOCKSTEP_LANES];   /* Number of instructions left to run with I/O and interrupt checks. */
+	struct cpu_context* contexts[LOCKSTEP_LANES]; /* Context of each lane. */
+	uint8_t count;                    /* Number of lanes in use. */
+};
+
+/* Static functions: */
+static bool step_lanes(struct lockstep_group* self,
+                       const struct instruction* instruction,
+                       const uint32_t address,
+                       const uint32_t* mask);
+static uint32_t run_converged(struct lockstep_group* self,
+                              struct cpu_context* context,
+                              uint32_t address,
+                              const uint32_t max_steps);
+static uint32_t step_lane(struct lockstep_group* self,
+                          const uint8_t lane,
+                          const uint32_t max_instructions);
+static void load(struct lockstep_group* self,
+                 const uint8_t lane);
+static void store(struct lockstep_group* self,
+                  const uint8_t lane);
+
+/********************************************************************************
+* lockstep_run: Runs specified number of instructions in each of specified
+*               contexts in lockstep. Each step runs the instruction at the
+*               lowest program counter among the lanes with instructions left.
+*               Lanes that are settling are run through control_unit_run_ctx
+*               one by one, just as instructions outside the register file.
+*               So are lanes whose next instruction reaches the timer
+*               deadline, so that the timer interrupts are raised in time.
+*               Sleeping lanes are given the rest of their instructions in
+*               one go, which lets control_unit_run_ctx skip the idle cycles.
+*               While all lanes are at the same address and none of them is
+*               settling or due, register instructions are run back to back
+*               by run_converged without selecting the lanes for each step.
+*               The number of retired instructions per context is returned.
+*
+*               - contexts        : The contexts to run.
+*               - count           : Number of contexts (1 - LOCKSTEP_LANES).
+*               - max_instructions: Number of instructions to run per context.
+********************************************************************************/
+uint32_t lockstep_run(struct cpu_context** contexts,
+                      const uint8_t count,
+                      const uint32_t max_instructions)
+{
+	struct lockstep_group group;
+
+	if (count == 0 || count > LOCKSTEP_LANES || max_instructions == 0) return 0;
+	group.count = count;
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		if (lane < count)
+		{
+			group.contexts[lane] = contexts[lane];
+			load(&group, lane);
+			group.retired[lane] = 0;
+			group.settle[lane] = LOCKSTEP_SETTLE + 1; /* The input values may have changed since last run. */
+		}
+		else
+		{
+			group.contexts[lane] = 0;
+			group.pc[lane] = UINT32_MAX; /* Unused lanes are never selected. */
+			group.retired[lane] = max_instructions;
+			group.instructions[lane] = 0;
+			group.deadline[lane] = UINT64_MAX;
+			group.sleeping[lane] = false;
+			group.settle[lane] = 0;
+		}
+	}
+
+	while (1)
+	{
+		uint32_t address = UINT32_MAX;
+		uint32_t active[LOCKSTEP_LANES];
+		uint32_t mask[LOCKSTEP_LANES];
+		uint32_t limit = UINT32_MAX;
+		bool converged = true;
+		bool vector;
+
+		for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+		{
+			if (group.retired[lane] < max_instructions && group.pc[lane] < address) address = group.pc[lane];
+		}
+
+		if (address == UINT32_MAX) break; /* All lanes are done. */
+
+		for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+		{
+			const bool due = group.instructions[lane] + 1 >= group.deadline[lane] || group.sleeping[lane];
+			active[lane] = group.pc[lane] == address && group.retired[lane] < max_instructions ? UINT32_MAX : 0;
+			mask[lane] = group.settle[lane] || due ? 0 : active[lane];
+		}
+
+		for (uint8_t lane = 0; lane < count; ++lane)
+		{
+			const uint64_t until_due = group.deadline[lane] - group.instructions[lane] - 1;
+			if (!mask[lane]) converged = false;
+			if (max_instructions - group.retired[lane] < limit) limit = max_instructions - group.retired[lane];
+			if (until_due < limit) limit = (uint32_t)(until_due);
+		}
+
+		if (converged)
+		{
+			const uint32_t steps = run_converged(&group, contexts[0], address, limit);
+
+			for (uint8_t lane = 0; lane < count; ++lane)
+			{
+				group.instructions[lane] += steps;
+				group.retired[lane] += steps;
+			}
+			if (steps) continue; /* Otherwise the instruction is run lane by lane below. */
+		}
+
+		vector = step_lanes(&group, program_memory_decoded_ctx(contexts[0], (uint16_t)(address)), address, mask);
+
+		for (uint8_t lane = 0; lane < count; ++lane)
+		{
+			if (active[lane] && (!vector || !mask[lane]))
+			{
+				const uint32_t budget = group.sleeping[lane] ? max_instructions - group.retired[lane] : 1;
+				group.retired[lane] += step_lane(&group, lane, budget);
+				if (!vector) group.settle[lane] = LOCKSTEP_SETTLE;
+				else if (group.settle[lane]) group.settle[lane]--;
+			}
+			else if (vector)
+			{
+				group.instructions[lane] += mask[lane] & 1;
+				group.retired[lane] += mask[lane] & 1;
+			}
+		}
+	}
+
+	for (uint8_t lane = 0; lane < count; ++lane)
+	{
+		store(&group, lane);
+	}
+	return max_instructions;
+}
+
+/********************************************************************************
+* lane_flags: Returns the status flags SNZVC of a lane, calculated without
+*             branches so that the lane loops can be vectorized. Must match
+*             alu_flags in alu.h.
+*
+*             - operation: The performed operation (OR, AND, XOR, ADD or SUB).
+*             - a        : First operand.
+*             - b        : Second operand.
+*             - result   : Result of the calculation.
+********************************************************************************/
+static inline uint32_t lane_flags(const uint8_t operation,
+                                  const uint32_t a,
+                                  const uint32_t b,
+                                  const uint32_t result)
+{
+	uint32_t c = 0;
+	uint32_t v = 0;
+
+	if (operation == ADD)
+	{
+		c = result < a;
+		v = ((a ^ result) & (b ^ result)) >> 31;
+	}
+	else if (operation == SUB)
+	{
+		c = a < b;
+		v = ((a ^ b) & (a ^ result)) >> 31;
+	}
+
+	{
+		const uint32_t n = result >> 31;
+		const uint32_t z = result == 0;
+		return ((n ^ v) << S) | (n << N) | (z << Z) | (v << V) | (c << C);
+	}
+}
+
+/********************************************************************************
+* alu_lanes: Performs calculation in the lanes selected by the mask and updates
+*            their status flags. The second operand is either a constant or a
+*            CPU register. The result is stored in the destination register
+*            unless the instruction is a comparison.
+*
+*            - self     : Reference to the lockstep group.
+*            - mask     : Selected lanes (all bits set) or not (all cleared).
+*            - operation: The operation to perform (OR, AND, XOR, ADD or SUB).
+*            - op1      : Destination register, also the first operand.
+*            - b        : Second operand of each lane.
+*            - store    : Indicates if the result is stored.
+********************************************************************************/
+static inline void alu_lanes(struct lockstep_group* self,
+                             const uint32_t* mask,
+                             const uint8_t operation,
+                             const uint16_t op1,
+                             const uint32_t* b,
+                             const bool store)
+{
+	uint32_t* destination = self->reg[op1];
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		const uint32_t a = destination[lane];
+		const uint32_t result = alu_calculate(operation, a, b[lane]);
+		const uint32_t sr = (self->sr[lane] & ~ALU_FLAGS) | lane_flags(operation, a, b[lane], result);
+
+		if (store) destination[lane] = (result & mask[lane]) | (a & ~mask[lane]);
+		self->sr[lane] = (sr & mask[lane]) | (self->sr[lane] & ~mask[lane]);
+	}
+	return;
+}
+
+/********************************************************************************
+* alu_lanes_constant: Performs calculation with a constant as second operand in
+*                     the lanes selected by the mask, see alu_lanes.
+********************************************************************************/
+static inline void alu_lanes_constant(struct lockstep_group* self,
+                                      const uint32_t* mask,
+                                      const uint8_t operation,
+                                      const uint16_t op1,
+                                      const uint32_t constant,
+                                      const bool store)
+{
+	uint32_t b[LOCKSTEP_LANES];
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		b[lane] = constant;
+	}
+
+	alu_lanes(self, mask, operation, op1, b, store);
+	return;
+}
+
+/********************************************************************************
+* move_lanes: Stores specified values in the destination register of the lanes
+*             selected by the mask.
+*
+*             - self : Reference to the lockstep group.
+*             - mask : Selected lanes.
+*             - op1  : Destination register.
+*             - value: Value of each lane.
+********************************************************************************/
+static inline void move_lanes(struct lockstep_group* self,
+                              const uint32_t* mask,
+                              const uint16_t op1,
+                              const uint32_t* value)
+{
+	uint32_t* destination = self->reg[op1];
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		destination[lane] = (value[lane] & mask[lane]) | (destination[lane] & ~mask[lane]);
+	}
+	return;
+}
+
+/********************************************************************************
+* branch_taken: Indicates if specified conditional branch is taken for the
+*               status register of a lane.
+*
+*               - op_code: OP code of the branch.
+*               - sr     : Status register of the lane.
+********************************************************************************/
+static inline bool branch_taken(const uint8_t op_code,
+                                const uint32_t sr)
+{
+	const bool s = read(sr, S);
+	const bool z = read(sr, Z);
+
+	if (op_code == BREQ)      return z;
+	else if (op_code == BRNE) return !z;
+	else if (op_code == BRGE) return !s;
+	else if (op_code == BRGT) return !s && !z;
+	else if (op_code == BRLE) return s || z;
+	else                      return s; /* BRLT */
+}
+
+/********************************************************************************
+* step_lanes: Executes specified register instruction in the lanes selected
+*             by the mask and moves their program counters. Returns true if the
+*             instruction was executed, otherwise false if it must be executed
+*             lane by lane instead.
+*
+*             - self       : Reference to the lockstep group.
+*             - instruction: The predecoded instruction.
+*             - address    : Address of the instruction.
+*             - mask       : Selected lanes.
+********************************************************************************/
+static bool step_lanes(struct lockstep_group* self,
+                       const struct instruction* instruction,
+                       const uint32_t address,
+                       const uint32_t* mask)
+{
+	const uint16_t op1 = instruction->op1;
+	const uint32_t op2 = instruction->op2;
+	uint32_t next = (address + instruction->size) & UINT16_MAX; /* The program counter is 16 bits. */
+	uint32_t value[LOCKSTEP_LANES];
+
+	if (op1 >= CPU_REGISTER_ADDRESS_WIDTH && instruction->op_code != JMP &&
+	   (instruction->op_code < BREQ || instruction->op_code > BRLT))
+	{
+		return false; /* Not a CPU register, executed lane by lane as in the scalar engine. */
+	}
+
+	switch (instruction->op_code)
+	{
+		case NOP:  break;
+		case ORI:  alu_lanes_constant(self, mask, OR, op1, op2, true); break;
+		case ANDI: alu_lanes_constant(self, mask, AND, op1, op2, true); break;
+		case XORI: alu_lanes_constant(self, mask, XOR, op1, op2, true); break;
+		case ADDI: alu_lanes_constant(self, mask, ADD, op1, op2, true); break;
+		case SUBI: alu_lanes_constant(self, mask, SUB, op1, op2, true); break;
+		case INC:  alu_lanes_constant(self, mask, ADD, op1, 1, true); break;
+		case DEC:  alu_lanes_constant(self, mask, SUB, op1, 1, true); break;
+		case CPI:  alu_lanes_constant(self, mask, SUB, op1, op2, false); break;
+		case JMP:  next = op1; break;
+		case LDI:
+		case CLR:
+		{
+			for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+			{
+				value[lane] = instruction->op_code == LDI ? op2 : 0x00;
+			}
+			move_lanes(self, mask, op1, value);
+			break;
+		}
+		case LSL:
+		case LSR:
+		{
+			for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+			{
+				value[lane] = instruction->op_code == LSL ? self->reg[op1][lane] << 1 : self->reg[op1][lane] >> 1;
+			}
+			move_lanes(self, mask, op1, value);
+			break;
+		}
+		case MOV:
+		case OR:
+		case AND:
+		case XOR:
+		case ADD:
+		case SUB:
+		case CP:
+		{
+			if (op2 >= CPU_REGISTER_ADDRESS_WIDTH) return false;
+
+			switch (instruction->op_code)
+			{
+				case MOV: move_lanes(self, mask, op1, self->reg[op2]); break;
+				case OR:  alu_lanes(self, mask, OR, op1, self->reg[op2], true); break;
+				case AND: alu_lanes(self, mask, AND, op1, self->reg[op2], true); break;
+				case XOR: alu_lanes(self, mask, XOR, op1, self->reg[op2], true); break;
+				case ADD: alu_lanes(self, mask, ADD, op1, self->reg[op2], true); break;
+				case SUB: alu_lanes(self, mask, SUB, op1, self->reg[op2], true); break;
+				case CP:  alu_lanes(self, mask, SUB, op1, self->reg[op2], false); break;
+			}
+			break;
+		}
+		case BREQ:
+		case BRNE:
+		case BRGE:
+		case BRGT:
+		case BRLE:
+		case BRLT:
+		{
+			for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+			{
+				const uint32_t target = branch_taken(instruction->op_code, self->sr[lane]) ? op1 : next;
+				self->pc[lane] = (target & mask[lane]) | (self->pc[lane] & ~mask[lane]);
+			}
+			return true;
+		}
+		default:
+		{
+			return false; /* Accesses memory, the stack or the status register. */
+		}
+	}
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		self->pc[lane] = (next & mask[lane]) | (self->pc[lane] & ~mask[lane]);
+	}
+	return true;
+}
+
+/********************************************************************************
+* run_converged: Runs register instructions in all lanes in use, starting at
+*                specified address, for as long as the lanes stay at the same
+*                address, but no more than specified number of steps. The
+*                lanes must not be settling or due for that many steps. The
+*                number of steps run is returned, which is 0 if the first
+*                instruction must be run lane by lane.
+*
+*                - self     : Reference to the lockstep group.
+*                - context  : Context of any lane, for the shared program memory.
+*                - address  : Address of the first instruction.
+*                - max_steps: Maximum number of steps to run.
+********************************************************************************/
+static uint32_t run_converged(struct lockstep_group* self,
+                              struct cpu_context* context,
+                              uint32_t address,
+                              const uint32_t max_steps)
+{
+	uint32_t mask[LOCKSTEP_LANES];
+	uint32_t steps = 0;
+
+	for (uint8_t lane = 0; lane < LOCKSTEP_LANES; ++lane)
+	{
+		mask[lane] = lane < self->count ? UINT32_MAX : 0;
+	}
+
+	while (steps < max_steps)
+	{
+		const struct instruction* instruction = program_memory_decoded_ctx(context, (uint16_t)(address));
+
+		if (!step_lanes(self, instruction, address, mask)) break;
+		steps++;
+		address = self->pc[0];
+
+		if (instruction->op_code >= BREQ && instruction->op_code <= BRLT)
+		{
+			for (uint8_t lane = 1; lane < self->count; ++lane)
+			{
+				if (self->pc[lane] != address) return steps; /* The lanes have diverged. */
+			}
+		}
+	}
+	return steps;
+}
+
+/********************************************************************************
+* step_lane: Runs up to specified number of instructions of specified lane
+*            through control_unit_run_ctx, including the I/O and interrupt
+*            checks. The number of retired instructions is returned.
+*
+*            - self            : Reference to the lockstep group.
+*            - lane            : Index of the lane.
+*            - max_instructions: Maximum number of instructions to run.
+********************************************************************************/
+static uint32_t step_lane(struct lockstep_group* self,
+                          const uint8_t lane,
+                          const uint32_t max_instructions)
+{
+	uint32_t retired;
+
+	store(self, lane);
+	retired = control_unit_run_ctx(self->contexts[lane], max_instructions);
+	load(self, lane);
+	return retired;
+}
+
+/********************************************************************************
+* load: Loads the CPU registers, status register, program counter and
+*       instruction counter of specified lane from its context.
+*
+*       - self: Reference to the lockstep group.
+*       - lane: Index of the lane.
+********************************************************************************/
+static void load(struct lockstep_group* self,
+                 const uint8_t lane)
+{
+	const struct cpu_context* context = self->contexts[lane];
+
+	for (uint8_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+	{
+		self->reg[i][lane] = context->reg[i];
+	}
+
+	self->sr[lane] = context->sr;
+	self->pc[lane] = context->pc;
+	self->instructions[lane] = context->instructions;
+	self->deadline[lane] = context->timer.deadline;
+	self->sleeping[lane] = context->sleeping;
+	return;
+}
+
+/********************************************************************************
+* store: Stores the CPU registers, status register, program counter and
+*        instruction counter of specified lane in its context.
+*
+*        - self: Reference to the lockstep group.
+*        - lane: Index of the lane.
+********************************************************************************/
+static void store(struct lockstep_group* self,
+                  const uint8_t lane)
+{
+	struct cpu_context* context = self->contexts[lane];
+
+	for (uint8_t i = 0; i < CPU_REGISTER_ADDRESS_WIDTH; ++i)
+	{
+		context->reg[i] = self->reg[i][lane];
+	}
+
+	context->sr = (uint8_t)(self->sr[lane]);
+	context->pc = (uint16_t)(self->pc[lane]);
+	context->instructions = self->instructions[lane];
+	return;
+}
@@ -0,0 +1,61 @@
+/********************************************************************************
+* lockstep.h: Contains function declarations for running several CPU
+*             instances of the same program in lockstep, where each
+*             instruction is executed for all instances at once.
+*
+*             The CPU registers, status registers and program counters of up
+*             to LOCKSTEP_LANES instances (lanes) are stored as structure of
+*             arrays, so that register instructions (LDI, MOV, CLR, the ALU
+*             instructions, LSL, LSR, JMP and the conditional branches) are
+*             executed by loops over the lanes, which the compiler turns into
+*             SSE or AVX2 vector instructions (build with -march=native for
+*             AVX2). Each step executes the instruction at the lowest program
+*             counter among the lanes, masked to the lanes that are there, so
+*             lanes that diverge at a branch are run separately until they
+*             reach the same address again.
+*
+*             All other instructions, which access data memory, the stack or
+*             the I/O ports, are executed lane by lane through
+*             control_unit_run_ctx. The result is exactly the same as when
+*             each instance is run by control_unit_run_ctx, which behaves as
+*             if interrupts and I/O are checked after every instruction
+*             regardless of CONTROL_UNIT_BLOCK_CACHE. Register instructions
+*             can't change any I/O or interrupt state, but the checks take
+*             effect with a delay: the input values are read before the
+*             outputs are written, and a pin change flag set after one
+*             instruction generates the interrupt after the next. Hence each
+*             lane is run with the checks for two more instructions after an
+*             instruction outside the register file, and for the first three
+*             instructions of each run, since the input values may have
+*             changed in between. Otherwise the checks are left out.
+*
+*             On a compute-bound program of register instructions, eight
+*             lanes run about 2.5 times faster than eight scalar instances
+*             with SSE2 and about 4 times faster with AVX2. Programs that
+*             mostly access I/O or sleep run faster through the scalar
+*             engine, which skips the idle cycles in one go.
+********************************************************************************/
+#ifndef LOCKSTEP_H_
+#define LOCKSTEP_H_
+
+/* Include directives: */
+#include "cpu_context.h"
+
+/* Macro definitions: */
+#define LOCKSTEP_LANES 8 /* Number of instances run in lockstep (one AVX2 vector of 32-bit words). */
+
+/********************************************************************************
+* lockstep_run: Runs specified number of instructions in each of specified
+*               contexts, which must have been reset and share the same program
+*               memory. The number of retired instructions per context is
+*               returned.
+*
+*               - contexts        : The contexts to run.
+*               - count           : Number of contexts (1 - LOCKSTEP_LANES).
+*               - max_instructions: Number of instructions to run per context.
+********************************************************************************/
+uint32_t lockstep_run(struct cpu_context** contexts,
+                      const uint8_t count,
+                      const uint32_t max_instructions);
+
+#endif /* LOCKSTEP_H_ */
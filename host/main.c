@@ -0,0 +1,111 @@
+/********************************************************************************
+* main.c: Runs the CPU on a host computer with simulated I/O ports, for fast
+*         and repeatable regression runs and profiling off-target.
+*
+*         Usage: 32bitcpu [-p image] [-s input output] [instructions]
+*                         [stimulus file]
+*
+*         The specified number of instructions is run (10 000 000 as
+*         default), with input signals read from the stimulus file, if any.
+*         With -p the program is loaded from the image file, see
+*         host/assembler.h, instead of the built-in program. With -s the
+*         UART receives bytes from the input file and transmits bytes to the
+*         output file, either of which can be a named pipe or - to leave
+*         that direction unconnected.
+*         Each change of the output values of I/O port A is printed to stdout
+*         on the format "<instruction> <output>", while the elapsed time and
+*         number of instructions per second are printed to stderr.
+********************************************************************************/
+#include "control_unit.h"
+#include "port_host.h"
+#include "program_image_host.h"
+#include "serial_host.h"
+#include <string.h>
+#include <time.h>
+
+/* Macro definitions: */
+#define INSTRUCTIONS_PER_RUN 1000     /* Maximum number of instructions run per call. */
+#define DEFAULT_INSTRUCTIONS 10000000 /* Number of instructions run as default. */
+
+/********************************************************************************
+* main: Runs the CPU for specified number of instructions with input signals
+*       from specified stimulus file. Returns 0 after a successful run,
+*       otherwise 1 if the arguments are invalid.
+*
+*       - argc: Number of arguments.
+*       - argv: The arguments, see usage above.
+********************************************************************************/
+int main(int argc, char** argv)
+{
+	uint64_t instructions = DEFAULT_INSTRUCTIONS;
+	uint64_t retired = 0;
+	uint32_t output;
+	struct timespec start, stop;
+	int first = 1;
+
+	if (argc > first + 1 && strcmp(argv[first], "-p") == 0)
+	{
+		if (program_image_host_load(argv[first + 1])) return 1;
+		first += 2;
+	}
+
+	if (argc > first + 2 && strcmp(argv[first], "-s") == 0)
+	{
+		const char* input = strcmp(argv[first + 1], "-") ? argv[first + 1] : 0;
+		const char* output = strcmp(argv[first + 2], "-") ? argv[first + 2] : 0;
+
+		if (serial_host_open(input, output))
+		{
+			fprintf(stderr, "Failed to open serial files %s and %s!\n", argv[first + 1], argv[first + 2]);
+			return 1;
+		}
+		first += 3;
+	}
+
+	if (argc - first > 2 || (argc > first && sscanf(argv[first], "%llu", (unsigned long long*)&instructions) != 1))
+	{
+		fprintf(stderr, "Usage: %s [-p image] [-s input output] [instructions] [stimulus file]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > first + 1 && port_host_load_stimulus(argv[first + 1]))
+	{
+		fprintf(stderr, "Failed to load stimulus file %s!\n", argv[first + 1]);
+		return 1;
+	}
+
+	control_unit_reset();
+	port_host_advance(0);
+	output = port_host_output();
+	printf("%llu %05lx\n", 0ULL, (unsigned long)(output));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (retired < instructions)
+	{
+		const uint64_t next_event = port_host_next_event();
+		uint64_t count = instructions - retired;
+
+		if (next_event > retired && next_event - retired < count) count = next_event - retired;
+		if (count > INSTRUCTIONS_PER_RUN) count = INSTRUCTIONS_PER_RUN;
+
+		retired += control_unit_run((uint32_t)(count));
+		port_host_advance(retired);
+		serial_host_update();
+
+		if (port_host_output() != output)
+		{
+			output = port_host_output();
+			printf("%llu %05lx\n", (unsigned long long)(retired), (unsigned long)(output));
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	serial_host_close();
+	{
+		const double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+		fprintf(stderr, "%llu instructions in %.3f s (%.1f MIPS)\n", (unsigned long long)(retired),
+		        seconds, seconds > 0 ? retired / seconds * 1e-6 : 0.0);
+	}
+	return 0;
+}
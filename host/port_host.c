@@ -0,0 +1,338 @@
+/********************************************************************************
+* port_host.c: Contains function definitions for the host port backend, where
+*              I/O port B, C and D are simulated registers fed by a stimulus
+*              file, see port_host.h for the file format.
+********************************************************************************/
+#include "cpu_context.h"
+#include "port_host.h"
+#include <ctype.h>
+#include <string.h>
+
+/* Macro definitions: */
+#define PORT_HOST_PIN_COUNT 20 /* Number of pins in I/O port A. */
+#define PORT_HOST_LINE_SIZE 128 /* Maximum length of a line in a stimulus file. */
+
+/* Static functions: */
+static inline struct port_host* port_host(const struct cpu_context* context);
+static void pins_update(struct port_host* self);
+static int parse_event(char* line,
+                       struct stimulus_event* event,
+                       int* has_event);
+
+/* Static variables: */
+static struct port_host port_host_default; /* Ports of contexts without own ports. */
+
+/********************************************************************************
+* port_reset_ctx: Clears the simulated data direction registers and data
+*                 registers of specified context. The stimulus is kept, pins
+*                 driven by it keep their levels.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void port_reset_ctx(struct cpu_context* context)
+{
+	struct port_host* self = port_host(context);
+
+	self->portb.ddr = 0;
+	self->portc.ddr = 0;
+	self->portd.ddr = 0;
+
+	self->portb.port = 0;
+	self->portc.port = 0;
+	self->portd.port = 0;
+
+	pins_update(self);
+	return;
+}
+
+/********************************************************************************
+* port_write_ctx: Writes data direction and output values of I/O port A to the
+*                 simulated I/O port B, C and D of specified context.
+*
+*                 - context: Reference to the CPU context.
+*                 - ddr    : Data direction of I/O port A (1 = output).
+*                 - port   : Output values (or pull-ups for inputs) of I/O port A.
+********************************************************************************/
+void port_write_ctx(struct cpu_context* context,
+                    const uint32_t ddr,
+                    const uint32_t port)
+{
+	struct port_host* self = port_host(context);
+
+	self->portb.ddr = (uint8_t)(ddr >> 8) & 0x3F;
+	self->portc.ddr = (uint8_t)(ddr >> 14) & 0x3F;
+	self->portd.ddr = (uint8_t)(ddr);
+
+	self->portb.port = (uint8_t)(port >> 8) & 0x3F;
+	self->portc.port = (uint8_t)(port >> 14) & 0x3F;
+	self->portd.port = (uint8_t)(port);
+
+	pins_update(self);
+	return;
+}
+
+/********************************************************************************
+* port_read_ctx: Returns the input values of I/O port A of specified context
+*                read from the simulated pin input registers.
+*
+*                - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t port_read_ctx(const struct cpu_context* context)
+{
+	const struct port_host* self = port_host(context);
+	return self->portd.pin | ((uint32_t)(self->portb.pin) << 8) | ((uint32_t)(self->portc.pin) << 14);
+}
+
+/********************************************************************************
+* port_changed_ctx: Indicates if the simulated pins of specified context have
+*                   changed since the last call, either by the stimulus or by
+*                   written output values. The indication is cleared.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+bool port_changed_ctx(struct cpu_context* context)
+{
+	struct port_host* self = port_host(context);
+	const bool changed = self->changed;
+	self->changed = false;
+	return changed;
+}
+
+/********************************************************************************
+* port_idle_ctx: Returns immediately, since the pins of the simulated ports
+*                only change when the runner applies the stimulus between
+*                runs.
+*
+*                - context: Reference to the CPU context (unused).
+********************************************************************************/
+void port_idle_ctx(struct cpu_context* context)
+{
+	(void)context;
+	return;
+}
+
+/********************************************************************************
+* port_host_load_stimulus_ctx: Reads input events from specified stimulus file
+*                              into the simulated ports of specified context,
+*                              which replaces the previously loaded events.
+*                              The value 0 is returned after successful load.
+*                              Otherwise if the file can't be read or contains
+*                              an invalid event, no events are loaded and
+*                              error code 1 is returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - path   : Path to the stimulus file.
+********************************************************************************/
+int port_host_load_stimulus_ctx(struct cpu_context* context,
+                                const char* path)
+{
+	struct port_host* self = port_host(context);
+	FILE* file = fopen(path, "r");
+	struct stimulus_event* loaded = 0;
+	size_t count = 0;
+	size_t capacity = 0;
+	char line[PORT_HOST_LINE_SIZE];
+
+	if (!file) return 1;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		struct stimulus_event event;
+		int has_event = 0;
+
+		if (parse_event(line, &event, &has_event) ||
+		   (has_event && count && event.instruction < loaded[count - 1].instruction))
+		{
+			fprintf(stderr, "Invalid stimulus event: %s", line);
+			free(loaded);
+			fclose(file);
+			return 1;
+		}
+
+		if (!has_event) continue;
+
+		if (count == capacity)
+		{
+			const size_t new_capacity = capacity ? capacity * 2 : 16;
+			struct stimulus_event* copy = (struct stimulus_event*)realloc(loaded,
+				new_capacity * sizeof(struct stimulus_event));
+
+			if (!copy)
+			{
+				free(loaded);
+				fclose(file);
+				return 1;
+			}
+			loaded = copy;
+			capacity = new_capacity;
+		}
+		loaded[count++] = event;
+	}
+
+	fclose(file);
+	free(self->events);
+	self->events = loaded;
+	self->event_count = count;
+	self->next_event = 0;
+	return 0;
+}
+
+/********************************************************************************
+* port_host_free_ctx: Frees the events loaded into the simulated ports of
+*                     specified context.
+*
+*                     - context: Reference to the CPU context.
+********************************************************************************/
+void port_host_free_ctx(struct cpu_context* context)
+{
+	struct port_host* self = port_host(context);
+
+	free(self->events);
+	self->events = 0;
+	self->event_count = 0;
+	self->next_event = 0;
+	return;
+}
+
+/********************************************************************************
+* port_host_next_event_ctx: Returns the instruction count of the next pending
+*                           input event of specified context, or UINT64_MAX if
+*                           no events are pending.
+*
+*                           - context: Reference to the CPU context.
+********************************************************************************/
+uint64_t port_host_next_event_ctx(const struct cpu_context* context)
+{
+	const struct port_host* self = port_host(context);
+	return self->next_event < self->event_count ? self->events[self->next_event].instruction : UINT64_MAX;
+}
+
+/********************************************************************************
+* port_host_advance_ctx: Applies all pending input events of specified context
+*                        that occur at or before specified instruction count
+*                        to the simulated pins.
+*
+*                        - context     : Reference to the CPU context.
+*                        - instructions: Number of retired instructions so far.
+********************************************************************************/
+void port_host_advance_ctx(struct cpu_context* context,
+                           const uint64_t instructions)
+{
+	struct port_host* self = port_host(context);
+	int changed = 0;
+
+	while (self->next_event < self->event_count && self->events[self->next_event].instruction <= instructions)
+	{
+		const struct stimulus_event* event = &self->events[self->next_event++];
+
+		if (event->driven) set(self->driven, event->pin);
+		else clr(self->driven, event->pin);
+
+		if (event->level) set(self->level, event->pin);
+		else clr(self->level, event->pin);
+		changed = 1;
+	}
+
+	if (changed) pins_update(self);
+	return;
+}
+
+/********************************************************************************
+* port_host_output_ctx: Returns the output values of I/O port A of specified
+*                       context, i.e. the bits set both in the simulated data
+*                       direction and data registers.
+*
+*                       - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t port_host_output_ctx(const struct cpu_context* context)
+{
+	const struct port_host* self = port_host(context);
+	const uint32_t ddr = self->portd.ddr | ((uint32_t)(self->portb.ddr) << 8) | ((uint32_t)(self->portc.ddr) << 14);
+	const uint32_t port = self->portd.port | ((uint32_t)(self->portb.port) << 8) | ((uint32_t)(self->portc.port) << 14);
+	return ddr & port;
+}
+
+/********************************************************************************
+* port_host: Returns the simulated ports of specified context, or the default
+*            instance if the context has no ports of its own.
+*
+*            - context: Reference to the CPU context.
+********************************************************************************/
+static inline struct port_host* port_host(const struct cpu_context* context)
+{
+	return context->port ? (struct port_host*)(context->port) : &port_host_default;
+}
+
+/********************************************************************************
+* pins_update: Updates the simulated pin input registers. Outputs read back
+*              their own values, inputs driven by the stimulus read the
+*              driven levels and released inputs read their pull-ups. Pin
+*              changes are recorded for port_changed_ctx.
+*
+*              - self: Reference to the simulated ports.
+********************************************************************************/
+static void pins_update(struct port_host* self)
+{
+	const uint32_t ddr = self->portd.ddr | ((uint32_t)(self->portb.ddr) << 8) | ((uint32_t)(self->portc.ddr) << 14);
+	const uint32_t port = self->portd.port | ((uint32_t)(self->portb.port) << 8) | ((uint32_t)(self->portc.port) << 14);
+	const uint32_t inputs = (self->driven & self->level) | (~self->driven & port);
+	const uint32_t pins = (ddr & port) | (~ddr & inputs);
+	const uint32_t previous = self->portd.pin | ((uint32_t)(self->portb.pin) << 8) | ((uint32_t)(self->portc.pin) << 14);
+
+	if (pins != previous) self->changed = true;
+
+	self->portd.pin = (uint8_t)(pins);
+	self->portb.pin = (uint8_t)(pins >> 8) & 0x3F;
+	self->portc.pin = (uint8_t)(pins >> 14) & 0x3F;
+	return;
+}
+
+/********************************************************************************
+* parse_event: Parses a line of a stimulus file. The value 0 is returned if
+*              the line is valid, in which case has_event is set if the line
+*              contains an event. Otherwise error code 1 is returned.
+*
+*              - line     : The line to parse, comments are removed in place.
+*              - event    : Reference to the parsed event.
+*              - has_event: Reference to flag set if the line holds an event.
+********************************************************************************/
+static int parse_event(char* line,
+                       struct stimulus_event* event,
+                       int* has_event)
+{
+	unsigned long long instruction;
+	unsigned pin;
+	char value[2];
+	char* comment = strchr(line, '#');
+	char* s = line;
+
+	if (comment) *comment = '\0';
+	while (isspace((unsigned char)(*s))) s++;
+	if (*s == '\0') return 0;
+
+	if (sscanf(s, "%llu %u %1s", &instruction, &pin, value) != 3 || pin >= PORT_HOST_PIN_COUNT)
+	{
+		return 1;
+	}
+
+	event->instruction = instruction;
+	event->pin = (uint8_t)(pin);
+
+	if (value[0] == '0' || value[0] == '1')
+	{
+		event->driven = 1;
+		event->level = (uint8_t)(value[0] - '0');
+	}
+	else if (value[0] == 'z' || value[0] == 'Z')
+	{
+		event->driven = 0;
+		event->level = 0;
+	}
+	else
+	{
+		return 1;
+	}
+
+	*has_event = 1;
+	return 0;
+}
@@ -0,0 +1,162 @@
+/********************************************************************************
+* port_host.h: Contains function declarations for the host port backend, where
+*              I/O port B, C and D of the ATmega328P are simulated registers.
+*
+*              Input signals are scripted in a stimulus file with one event
+*              per line on the format "<instruction> <pin> <level>", where
+*              instruction is the number of retired instructions when the
+*              event occurs, pin is the pin number of I/O port A (0 - 19) and
+*              level is 0 or 1 to drive the pin or z to release it. A released
+*              input reads high if its pull-up is enabled, otherwise low.
+*              Events must be listed in chronological order. Empty lines and
+*              text after a # are ignored, for instance:
+*
+*              # Presses and releases BUTTON1 (pin 11).
+*              1000 11 0
+*              2000 11 z
+*
+*              Each CPU context can be given its own simulated ports and
+*              stimulus by pointing its member port to a struct port_host.
+*              Contexts without one share a default instance.
+********************************************************************************/
+#ifndef PORT_HOST_H_
+#define PORT_HOST_H_
+
+/* Include directives: */
+#include "port.h"
+
+/********************************************************************************
+* port_registers: Simulated registers of an I/O port of the ATmega328P.
+********************************************************************************/
+struct port_registers
+{
+	uint8_t ddr;  /* Data direction register. */
+	uint8_t port; /* Data register. */
+	uint8_t pin;  /* Pin input register. */
+};
+
+/********************************************************************************
+* stimulus_event: Input event read from a stimulus file.
+********************************************************************************/
+struct stimulus_event
+{
+	uint64_t instruction; /* Number of retired instructions when the event occurs. */
+	uint8_t pin;          /* Pin number of I/O port A. */
+	uint8_t driven;       /* 1 if the pin is driven by the event, 0 if released. */
+	uint8_t level;        /* Level of a driven pin. */
+};
+
+/********************************************************************************
+* port_host: Simulated I/O ports and stimulus of a CPU context. Must be
+*            cleared before first use, for instance with memset.
+********************************************************************************/
+struct port_host
+{
+	struct port_registers portb; /* Simulated I/O port B (pin 8 - 13). */
+	struct port_registers portc; /* Simulated I/O port C (pin 14 - 19). */
+	struct port_registers portd; /* Simulated I/O port D (pin 0 - 7). */
+
+	uint32_t driven; /* Pins of I/O port A driven by the stimulus. */
+	uint32_t level;  /* Levels of the driven pins. */
+	bool changed;    /* Set when the simulated pins change, cleared by port_changed_ctx. */
+
+	struct stimulus_event* events; /* Events read from the stimulus file. */
+	size_t event_count;            /* Number of events. */
+	size_t next_event;             /* Index of the next pending event. */
+};
+
+/********************************************************************************
+* port_host_load_stimulus_ctx: Reads input events from specified stimulus file
+*                              into the simulated ports of specified context,
+*                              which replaces the previously loaded events.
+*                              The value 0 is returned after successful load.
+*                              Otherwise if the file can't be read or contains
+*                              an invalid event, no events are loaded and
+*                              error code 1 is returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - path   : Path to the stimulus file.
+********************************************************************************/
+int port_host_load_stimulus_ctx(struct cpu_context* context,
+                                const char* path);
+
+/********************************************************************************
+* port_host_free_ctx: Frees the events loaded into the simulated ports of
+*                     specified context.
+*
+*                     - context: Reference to the CPU context.
+********************************************************************************/
+void port_host_free_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* port_host_next_event_ctx: Returns the instruction count of the next pending
+*                           input event of specified context, or UINT64_MAX if
+*                           no events are pending.
+*
+*                           - context: Reference to the CPU context.
+********************************************************************************/
+uint64_t port_host_next_event_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* port_host_advance_ctx: Applies all pending input events of specified context
+*                        that occur at or before specified instruction count
+*                        to the simulated pins.
+*
+*                        - context     : Reference to the CPU context.
+*                        - instructions: Number of retired instructions so far.
+********************************************************************************/
+void port_host_advance_ctx(struct cpu_context* context,
+                           const uint64_t instructions);
+
+/********************************************************************************
+* port_host_output_ctx: Returns the output values of I/O port A of specified
+*                       context, i.e. the bits set both in the simulated data
+*                       direction and data registers.
+*
+*                       - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t port_host_output_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* port_host_load_stimulus: Reads input events from specified stimulus file
+*                          into the simulated ports of the default context,
+*                          see port_host_load_stimulus_ctx.
+*
+*                          - path: Path to the stimulus file.
+********************************************************************************/
+static inline int port_host_load_stimulus(const char* path)
+{
+	return port_host_load_stimulus_ctx(&cpu_context_default, path);
+}
+
+/********************************************************************************
+* port_host_next_event: Returns the instruction count of the next pending
+*                       input event of the default context, or UINT64_MAX if
+*                       no events are pending.
+********************************************************************************/
+static inline uint64_t port_host_next_event(void)
+{
+	return port_host_next_event_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* port_host_advance: Applies all pending input events of the default context
+*                    that occur at or before specified instruction count.
+*
+*                    - instructions: Number of retired instructions so far.
+********************************************************************************/
+static inline void port_host_advance(const uint64_t instructions)
+{
+	port_host_advance_ctx(&cpu_context_default, instructions);
+}
+
+/********************************************************************************
+* port_host_output: Returns the output values of I/O port A of the default
+*                   context.
+********************************************************************************/
+static inline uint32_t port_host_output(void)
+{
+	return port_host_output_ctx(&cpu_context_default);
+}
+
+#endif /* PORT_HOST_H_ */
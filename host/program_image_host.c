@@ -0,0 +1,86 @@
+/********************************************************************************
+* program_image_host.c: Contains function definitions for reading program
+*                       image files on the host.
+********************************************************************************/
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "program_image_host.h"
+
+/********************************************************************************
+* program_image_host_open: Maps the program image file at specified path
+*                          read-only into memory. The mapping is page aligned
+*                          as required by the loader and shared through the
+*                          page cache, hence processes running the same image
+*                          share its memory and nothing is copied up front.
+*                          Returns the image, or 0 if the file can't be
+*                          mapped.
+*
+*                          - path: Path to the image file.
+*                          - size: Reference to the image size.
+********************************************************************************/
+const void* program_image_host_open(const char* path,
+                                    size_t* size)
+{
+	FILE* file = fopen(path, "rb");
+	struct stat status;
+	void* image;
+
+	if (!file) return 0;
+
+	if (fstat(fileno(file), &status) || status.st_size <= 0)
+	{
+		fclose(file);
+		return 0;
+	}
+
+	image = mmap(0, (size_t)(status.st_size), PROT_READ, MAP_SHARED, fileno(file), 0);
+	fclose(file); /* The mapping stays valid after the file is closed. */
+
+	if (image == MAP_FAILED) return 0;
+	*size = (size_t)(status.st_size);
+	return image;
+}
+
+/********************************************************************************
+* program_image_host_close: Unmaps specified program image.
+*
+*                           - image: Reference to the image.
+*                           - size : Size of the image in bytes.
+********************************************************************************/
+void program_image_host_close(const void* image,
+                              const size_t size)
+{
+	munmap((void*)(image), size);
+	return;
+}
+
+/********************************************************************************
+* program_image_host_load_ctx: Reads the program image file at specified path
+*                              and loads it into the program memory of
+*                              specified context. The value 0 is returned after
+*                              successful load, otherwise error code 1 is
+*                              returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - path   : Path to the image file.
+********************************************************************************/
+int program_image_host_load_ctx(struct cpu_context* context,
+                                const char* path)
+{
+	size_t size;
+	const void* image = program_image_host_open(path, &size);
+
+	if (!image)
+	{
+		fprintf(stderr, "Failed to read program image %s!\n", path);
+		return 1;
+	}
+
+	if (program_memory_load_image_ctx(context, image, size))
+	{
+		fprintf(stderr, "Invalid program image %s!\n", path);
+		program_image_host_close(image, size);
+		return 1;
+	}
+	return 0;
+}
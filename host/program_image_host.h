@@ -0,0 +1,67 @@
+/********************************************************************************
+* program_image_host.h: Contains function declarations for reading program
+*                       image files on the host, see program_image.h for the
+*                       format and host/assembler.h for how images are made.
+********************************************************************************/
+#ifndef PROGRAM_IMAGE_HOST_H_
+#define PROGRAM_IMAGE_HOST_H_
+
+/* Include directives: */
+#include "cpu_context.h"
+
+/********************************************************************************
+* program_image_host_open: Maps the program image file at specified path
+*                          read-only into memory. The image is returned and
+*                          its size in bytes is stored at the referenced
+*                          location. Otherwise if the file can't be mapped, 0
+*                          is returned. The program is read from the mapping
+*                          in place, hence the image must be closed with
+*                          program_image_host_close once no program memory
+*                          uses it anymore.
+*
+*                          - path: Path to the image file.
+*                          - size: Reference to the image size.
+********************************************************************************/
+const void* program_image_host_open(const char* path,
+                                    size_t* size);
+
+/********************************************************************************
+* program_image_host_close: Unmaps specified program image mapped by
+*                           program_image_host_open.
+*
+*                           - image: Reference to the image.
+*                           - size : Size of the image in bytes.
+********************************************************************************/
+void program_image_host_close(const void* image,
+                              const size_t size);
+
+/********************************************************************************
+* program_image_host_load_ctx: Reads the program image file at specified path
+*                              and loads it into the program memory of
+*                              specified context, see
+*                              program_memory_load_image_ctx. The image is kept
+*                              open as long as the process runs. The value 0 is
+*                              returned after successful load. Otherwise if the
+*                              file can't be read or the image is invalid, an
+*                              error message is printed to stderr and error
+*                              code 1 is returned.
+*
+*                              - context: Reference to the CPU context.
+*                              - path   : Path to the image file.
+********************************************************************************/
+int program_image_host_load_ctx(struct cpu_context* context,
+                                const char* path);
+
+/********************************************************************************
+* program_image_host_load: Reads the program image file at specified path and
+*                          loads it into the program memory of the default
+*                          context, see program_image_host_load_ctx.
+*
+*                          - path: Path to the image file.
+********************************************************************************/
+static inline int program_image_host_load(const char* path)
+{
+	return program_image_host_load_ctx(&cpu_context_default, path);
+}
+
+#endif /* PROGRAM_IMAGE_HOST_H_ */
@@ -0,0 +1,181 @@
+/********************************************************************************
+* serial_host.c: Contains function definitions for the host serial backend,
+*                where the UART is connected to an input and an output
+*                stream, see serial_host.h.
+********************************************************************************/
+#include <fcntl.h>
+#include "cpu_context.h"
+#include "serial_host.h"
+
+/* Static functions: */
+static inline struct serial_host* serial_host(const struct cpu_context* context);
+static void transmit(struct cpu_context* context);
+static void receive(struct cpu_context* context);
+
+/* Static variables: */
+static struct serial_host serial_host_default; /* Streams of contexts without own streams. */
+
+/********************************************************************************
+* serial_reset_ctx: Keeps the streams of specified context, since the host
+*                   backend has nothing to start. Bytes already read from
+*                   the input stream are lost when the UART is reset.
+*
+*                   - context: Reference to the CPU context (unused).
+********************************************************************************/
+void serial_reset_ctx(struct cpu_context* context)
+{
+	(void)context;
+	return;
+}
+
+/********************************************************************************
+* serial_transmit_ctx: Writes out the transmit buffer of specified context
+*                      once it's full, so the program can keep transmitting
+*                      until the next update.
+*
+*                      - context: Reference to the CPU context.
+********************************************************************************/
+void serial_transmit_ctx(struct cpu_context* context)
+{
+	if (uart_ring_count(&context->uart.tx) == UART_BUFFER_SIZE) transmit(context);
+	return;
+}
+
+/********************************************************************************
+* serial_host_open_ctx: Opens the streams of the serial backend of specified
+*                       context from specified paths, either of which can be
+*                       0. The input stream is made non-blocking, so that an
+*                       empty pipe doesn't stall the runner.
+*
+*                       - context: Reference to the CPU context.
+*                       - input  : Path to read received bytes from, or 0.
+*                       - output : Path to write transmitted bytes to, or 0.
+********************************************************************************/
+int serial_host_open_ctx(struct cpu_context* context,
+                         const char* input,
+                         const char* output)
+{
+	struct serial_host* self = serial_host(context);
+	FILE* input_stream = input ? fopen(input, "rb") : 0;
+	FILE* output_stream = output ? fopen(output, "wb") : 0;
+
+	if ((input && !input_stream) || (output && !output_stream))
+	{
+		if (input_stream) fclose(input_stream);
+		if (output_stream) fclose(output_stream);
+		return 1;
+	}
+
+	if (input_stream)
+	{
+		const int flags = fcntl(fileno(input_stream), F_GETFL);
+		if (flags != -1) fcntl(fileno(input_stream), F_SETFL, flags | O_NONBLOCK);
+	}
+
+	serial_host_close_ctx(context);
+	self->input = input_stream;
+	self->output = output_stream;
+	return 0;
+}
+
+/********************************************************************************
+* serial_host_close_ctx: Writes out the transmit buffer and closes the
+*                        streams of the serial backend of specified context.
+*
+*                        - context: Reference to the CPU context.
+********************************************************************************/
+void serial_host_close_ctx(struct cpu_context* context)
+{
+	struct serial_host* self = serial_host(context);
+
+	transmit(context);
+	if (self->input) fclose(self->input);
+	if (self->output) fclose(self->output);
+	self->input = 0;
+	self->output = 0;
+	return;
+}
+
+/********************************************************************************
+* serial_host_update_ctx: Writes the transmit buffer of specified context to
+*                         the output stream and fills the receive buffer
+*                         with the bytes available from the input stream.
+*
+*                         - context: Reference to the CPU context.
+********************************************************************************/
+void serial_host_update_ctx(struct cpu_context* context)
+{
+	transmit(context);
+	receive(context);
+	return;
+}
+
+/********************************************************************************
+* serial_host: Returns the streams of specified context, or the default
+*              instance if the context has no streams of its own.
+*
+*              - context: Reference to the CPU context.
+********************************************************************************/
+static inline struct serial_host* serial_host(const struct cpu_context* context)
+{
+	return context->serial ? (struct serial_host*)(context->serial) : &serial_host_default;
+}
+
+/********************************************************************************
+* transmit: Empties the transmit buffer of specified context into the output
+*           stream in a single write, or discards the bytes if there's no
+*           output stream.
+*
+*           - context: Reference to the CPU context.
+********************************************************************************/
+static void transmit(struct cpu_context* context)
+{
+	struct serial_host* self = serial_host(context);
+	uint8_t buffer[UART_BUFFER_SIZE];
+	size_t count = 0;
+
+	while (uart_ring_get(&context->uart.tx, &buffer[count])) count++;
+
+	if (count && self->output)
+	{
+		fwrite(buffer, 1, count, self->output);
+		fflush(self->output);
+	}
+	return;
+}
+
+/********************************************************************************
+* receive: Fills the receive buffer of specified context with the bytes
+*          available from the input stream in a single read. The input
+*          stream is closed at the end of the file, or when the writer of a
+*          pipe has closed it.
+*
+*          - context: Reference to the CPU context.
+********************************************************************************/
+static void receive(struct cpu_context* context)
+{
+	struct serial_host* self = serial_host(context);
+	uint8_t buffer[UART_BUFFER_SIZE];
+	const size_t space = UART_BUFFER_SIZE - uart_ring_count(&context->uart.rx);
+	size_t count;
+
+	if (!self->input || space == 0) return;
+
+	count = fread(buffer, 1, space, self->input);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uart_ring_put(&context->uart.rx, buffer[i]);
+	}
+
+	if (feof(self->input))
+	{
+		fclose(self->input);
+		self->input = 0;
+	}
+	else
+	{
+		clearerr(self->input); /* No more bytes available from the pipe right now. */
+	}
+	return;
+}
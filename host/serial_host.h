@@ -0,0 +1,100 @@
+/********************************************************************************
+* serial_host.h: Contains function declarations for the host serial backend,
+*                where the UART is connected to an input and an output
+*                stream, for instance files or named pipes.
+*
+*                The runner moves bytes between the streams and the ring
+*                buffers of the UART with serial_host_update_ctx between
+*                runs, in bulk reads and writes. The transmit buffer is
+*                also written out as soon as it's full, so the program never
+*                waits for the runner to transmit. Input pipes are read
+*                without blocking; the bytes available so far are received
+*                and the rest at later updates.
+*
+*                Each CPU context can be given its own streams by pointing
+*                its member serial to a struct serial_host. Contexts without
+*                one share a default instance. Without an output stream
+*                transmitted bytes are discarded, and without an input
+*                stream nothing is received.
+********************************************************************************/
+#ifndef SERIAL_HOST_H_
+#define SERIAL_HOST_H_
+
+/* Include directives: */
+#include "serial.h"
+
+/********************************************************************************
+* serial_host: Streams connected to the UART of a CPU context. Must be
+*              cleared before first use, for instance with memset.
+********************************************************************************/
+struct serial_host
+{
+	FILE* input;  /* Stream received bytes are read from, 0 if none. */
+	FILE* output; /* Stream transmitted bytes are written to, 0 if none. */
+};
+
+/********************************************************************************
+* serial_host_open_ctx: Opens the streams of the serial backend of specified
+*                       context from specified paths, either of which can be
+*                       0 to leave that direction unconnected. The value 0
+*                       is returned after successful open. Otherwise if a
+*                       file can't be opened, no stream is opened and error
+*                       code 1 is returned.
+*
+*                       - context: Reference to the CPU context.
+*                       - input  : Path to read received bytes from, or 0.
+*                       - output : Path to write transmitted bytes to, or 0.
+********************************************************************************/
+int serial_host_open_ctx(struct cpu_context* context,
+                         const char* input,
+                         const char* output);
+
+/********************************************************************************
+* serial_host_close_ctx: Writes out the transmit buffer and closes the
+*                        streams of the serial backend of specified context.
+*
+*                        - context: Reference to the CPU context.
+********************************************************************************/
+void serial_host_close_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* serial_host_update_ctx: Writes the transmit buffer of specified context to
+*                         the output stream and fills the receive buffer
+*                         with the bytes available from the input stream.
+*
+*                         - context: Reference to the CPU context.
+********************************************************************************/
+void serial_host_update_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* serial_host_open: Opens the streams of the serial backend of the default
+*                   context, see serial_host_open_ctx.
+*
+*                   - input : Path to read received bytes from, or 0.
+*                   - output: Path to write transmitted bytes to, or 0.
+********************************************************************************/
+static inline int serial_host_open(const char* input,
+                                   const char* output)
+{
+	return serial_host_open_ctx(&cpu_context_default, input, output);
+}
+
+/********************************************************************************
+* serial_host_close: Writes out the transmit buffer and closes the streams of
+*                    the serial backend of the default context.
+********************************************************************************/
+static inline void serial_host_close(void)
+{
+	serial_host_close_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* serial_host_update: Moves bytes between the streams and the ring buffers of
+*                     the default context, see serial_host_update_ctx.
+********************************************************************************/
+static inline void serial_host_update(void)
+{
+	serial_host_update_ctx(&cpu_context_default);
+}
+
+#endif /* SERIAL_HOST_H_ */
@@ -0,0 +1,213 @@
+/********************************************************************************
+* test_alu.c: Checks the results and status flags SNZVC of the ALU, see
+*             alu.h. The flags of addition, subtraction, multiplication and
+*             the bitwise operations are compared with a reference calculated
+*             on 64-bit integers for operands around every sign and carry
+*             boundary, while division by zero, division overflow and shift
+*             counts of 32 and above are checked case by case.
+*
+*             Usage: 32bitcpu_test_alu
+********************************************************************************/
+#include "alu.h"
+#include "check.h"
+
+/* Static variables: */
+static const uint32_t operands[] = /* Operands around the sign and carry boundaries. */
+{
+	0x00000000, 0x00000001, 0x00000002, 0x12345678, 0x7FFFFFFE, 0x7FFFFFFF,
+	0x80000000, 0x80000001, 0xEDCBA988, 0xFFFFFFFE, 0xFFFFFFFF
+};
+
+#define OPERANDS (sizeof(operands) / sizeof(operands[0])) /* Number of operands. */
+
+/* Static functions: */
+static uint8_t reference_flags(const uint32_t operation,
+                               const uint32_t a,
+                               const uint32_t b,
+                               const uint32_t result);
+static uint8_t flags_of(const uint32_t result,
+                        const bool v,
+                        const bool c);
+static void check_operation(const uint32_t operation,
+                            const uint32_t a,
+                            const uint32_t b,
+                            const uint32_t expected,
+                            const uint8_t flags);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	for (uint8_t i = 0; i < OPERANDS; ++i)
+	{
+		for (uint8_t j = 0; j < OPERANDS; ++j)
+		{
+			const uint32_t a = operands[i];
+			const uint32_t b = operands[j];
+
+			const int64_t product = (int64_t)((int32_t)(a)) * (int32_t)(b);
+
+			check_operation(ADD, a, b, a + b, reference_flags(ADD, a, b, a + b));
+			check_operation(SUB, a, b, a - b, reference_flags(SUB, a, b, a - b));
+			check_operation(OR, a, b, a | b, reference_flags(OR, a, b, a | b));
+			check_operation(AND, a, b, a & b, reference_flags(AND, a, b, a & b));
+			check_operation(XOR, a, b, a ^ b, reference_flags(XOR, a, b, a ^ b));
+			check_operation(MUL, a, b, a * b, reference_flags(MUL, a, b, a * b));
+			check_operation(MULH, a, b, (uint32_t)((uint64_t)(product) >> 32),
+			                flags_of((uint32_t)((uint64_t)(product) >> 32), false, false));
+
+			if (b != 0 && !(a == 0x80000000UL && b == 0xFFFFFFFFUL))
+			{
+				const uint32_t quotient = (uint32_t)((int32_t)(a) / (int32_t)(b));
+				const uint32_t remainder = (uint32_t)((int32_t)(a) % (int32_t)(b));
+				check_operation(DIV, a, b, quotient, flags_of(quotient, false, false));
+				check_operation(MOD, a, b, remainder, flags_of(remainder, false, false));
+			}
+		}
+	}
+
+	/* Division by zero sets V, the quotient is -1 and the remainder the dividend. */
+	check_operation(DIV, 7, 0, 0xFFFFFFFF, flags_of(0xFFFFFFFF, true, false));
+	check_operation(DIV, 0, 0, 0xFFFFFFFF, flags_of(0xFFFFFFFF, true, false));
+	check_operation(MOD, 7, 0, 7, flags_of(7, true, false));
+	check_operation(MOD, 0x80000000, 0, 0x80000000, flags_of(0x80000000, true, false));
+
+	/* -2^31 / -1 overflows to -2^31 with V set, while the remainder is 0 without overflow. */
+	check_operation(DIV, 0x80000000, 0xFFFFFFFF, 0x80000000, flags_of(0x80000000, true, false));
+	check_operation(MOD, 0x80000000, 0xFFFFFFFF, 0, flags_of(0, false, false));
+
+	/* Signed division rounds towards zero, the remainder has the sign of the dividend. */
+	check_operation(DIV, (uint32_t)(-7), 2, (uint32_t)(-3), flags_of((uint32_t)(-3), false, false));
+	check_operation(MOD, (uint32_t)(-7), 2, (uint32_t)(-1), flags_of((uint32_t)(-1), false, false));
+
+	/* MULH keeps the signed high word, -1 * -1 = 1 has the high word 0. */
+	check_operation(MULH, 0xFFFFFFFF, 0xFFFFFFFF, 0, flags_of(0, false, false));
+	check_operation(MULH, 0x80000000, 0x80000000, 0x40000000, flags_of(0x40000000, false, false));
+
+	/* Shift counts use the lowest 5 bits, hence 32 shifts by 0 (C cleared) and 33 by 1. */
+	check_operation(LSLV, 0x80000001, 32, 0x80000001, flags_of(0x80000001, false, false));
+	check_operation(LSLV, 0x80000001, 33, 0x00000002, flags_of(0x00000002, false, true));
+	check_operation(LSLV, 0x00000001, 31, 0x80000000, flags_of(0x80000000, false, false));
+	check_operation(LSRV, 0x80000001, 1, 0x40000000, flags_of(0x40000000, false, true));
+	check_operation(LSRV, 0x80000001, 64, 0x80000001, flags_of(0x80000001, false, false));
+	check_operation(LSRV, 0x80000000, 63, 0x00000001, flags_of(0x00000001, false, false));
+	check_operation(ASR, 0x80000000, 31, 0xFFFFFFFF, flags_of(0xFFFFFFFF, false, false));
+	check_operation(ASR, 0x80000001, 33, 0xC0000000, flags_of(0xC0000000, false, true));
+	check_operation(ASR, 0x40000000, 30, 0x00000001, flags_of(0x00000001, false, false));
+	check_operation(ROL, 0x80000001, 1, 0x00000003, flags_of(0x00000003, false, true));
+	check_operation(ROL, 0x80000001, 32, 0x80000001, flags_of(0x80000001, false, false));
+	check_operation(ROR, 0x80000001, 1, 0xC0000000, flags_of(0xC0000000, false, true));
+	check_operation(ROR, 0x00000002, 33, 0x00000001, flags_of(0x00000001, false, false));
+
+	/* The example of alu.h scaled to 32 bits, -2^31 - 1 overflows to a positive result. */
+	{
+		uint8_t sr = 0x00;
+		CHECK(alu(SUB, 0x80000000, 1, &sr) == 0x7FFFFFFF);
+		CHECK(read(sr, V) && read(sr, S) && !read(sr, N) && !read(sr, C) && !read(sr, Z));
+	}
+
+	/* 0xFFFFFFFF + 1 carries out to zero without signed overflow. */
+	{
+		uint8_t sr = 0x00;
+		CHECK(alu(ADD, 0xFFFFFFFF, 1, &sr) == 0);
+		CHECK(read(sr, C) && read(sr, Z) && !read(sr, V) && !read(sr, N) && !read(sr, S));
+	}
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* reference_flags: Returns the status flags SNZVC of specified operation,
+*                  calculated from the exact 64-bit result, where C is set
+*                  if the unsigned result doesn't fit in 32 bits and V if the
+*                  signed result doesn't.
+*
+*                  - operation: The performed operation (OR, AND, XOR, ADD,
+*                               SUB or MUL).
+*                  - a        : First operand.
+*                  - b        : Second operand.
+*                  - result   : The 32-bit result.
+********************************************************************************/
+static uint8_t reference_flags(const uint32_t operation,
+                               const uint32_t a,
+                               const uint32_t b,
+                               const uint32_t result)
+{
+	int64_t signed_result = (int32_t)(result);
+	uint64_t unsigned_result = result;
+
+	if (operation == ADD)
+	{
+		signed_result = (int64_t)((int32_t)(a)) + (int32_t)(b);
+		unsigned_result = (uint64_t)(a) + b;
+	}
+	else if (operation == SUB)
+	{
+		signed_result = (int64_t)((int32_t)(a)) - (int32_t)(b);
+		unsigned_result = (uint64_t)(a) - b;
+	}
+	else if (operation == MUL)
+	{
+		signed_result = (int64_t)((int32_t)(a)) * (int32_t)(b);
+		unsigned_result = (uint64_t)(a) * b;
+	}
+	return flags_of(result, signed_result != (int32_t)(result), unsigned_result >> 32);
+}
+
+/********************************************************************************
+* flags_of: Returns the status flags SNZVC of specified result, with the V and
+*           C flags given.
+*
+*           - result: The 32-bit result.
+*           - v     : Indicates if the V flag is set.
+*           - c     : Indicates if the C flag is set.
+********************************************************************************/
+static uint8_t flags_of(const uint32_t result,
+                        const bool v,
+                        const bool c)
+{
+	uint8_t sr = 0x00;
+
+	if (c) set(sr, C);
+	if (v) set(sr, V);
+	if (result & 0x80000000UL) set(sr, N);
+	if (result == 0) set(sr, Z);
+	if (read(sr, N) != read(sr, V)) set(sr, S);
+	return sr;
+}
+
+/********************************************************************************
+* check_operation: Checks that the generic ALU, the specialized kernels and
+*                  the lazy evaluation through alu_calculate and alu_flags
+*                  all give the expected result and flags, without touching
+*                  the other bits of the status register.
+*
+*                  - operation: The operation to check.
+*                  - a        : First operand.
+*                  - b        : Second operand.
+*                  - expected : The expected result.
+*                  - flags    : The expected status flags SNZVC.
+********************************************************************************/
+static void check_operation(const uint32_t operation,
+                            const uint32_t a,
+                            const uint32_t b,
+                            const uint32_t expected,
+                            const uint8_t flags)
+{
+	uint8_t sr = (1 << I) | ALU_FLAGS;
+	uint8_t kernel_sr = 1 << I;
+	uint32_t kernel_result;
+
+	CHECK(alu(operation, a, b, &sr) == expected);
+	CHECK(sr == ((1 << I) | flags));
+
+	if (operation == ADD) kernel_result = alu_add(a, b, &kernel_sr);
+	else if (operation == SUB) kernel_result = alu_sub(a, b, &kernel_sr);
+	else kernel_result = alu_other(operation, a, b, &kernel_sr);
+
+	CHECK(kernel_result == expected);
+	CHECK(kernel_sr == sr);
+	CHECK(alu_calculate(operation, a, b) == expected);
+	CHECK(alu_flags(operation, a, b, expected) == flags);
+	return;
+}
@@ -0,0 +1,178 @@
+/********************************************************************************
+* test_assembler.c: Checks that a program assembled by the host assembler is
+*                   loaded into program and data memory word for word and
+*                   runs as written, and that the assembler and the loader
+*                   reject what they can't handle.
+*
+*                   Usage: 32bitcpu_test_assembler
+********************************************************************************/
+#include "cpu_context.h"
+#include "assembler.h"
+#include "check.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Static variables: */
+static const char* const source = /* Uses every directive, an extension word and forward references. */
+	".equ WIDE, 0x12345678\n"
+	".vector TIMER_COMPA_vect, timer\n"
+	".entry main\n"
+	".data 0x40\n"
+	".word 7, WIDE, helper\n"
+	"helper:\n"
+	"\tADDI R5, 1\n"
+	"\tRET\n"
+	"main:\n"
+	"\tLDI R16, WIDE      ; Extension word.\n"
+	"\tLDI R17, last      ; Narrow forward reference.\n"
+	"\tLDS R18, 0x40 + 1\n"
+	"\tCALL helper\n"
+	"\tLDI R19, 50\n"
+	"\tOUT OCRA, R19\n"
+	"\tLDI R19, (1 << CTC) | (1 << CS0)\n"
+	"\tOUT TCCR, R19\n"
+	"\tLDI R19, (1 << OCIEA)\n"
+	"\tOUT ICR, R19\n"
+	"\tSEI\n"
+	"loop:\n"
+	"\tJMP loop\n"
+	"timer:\n"
+	"\tINC R3\n"
+	"\tRETI\n"
+	"last:\n"
+	"\tNOP\n";
+
+static struct program_memory program_memory;
+static struct cpu_context context;
+
+/* Static functions: */
+static void check_round_trip(void);
+static void check_errors(void);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	check_round_trip();
+	check_errors();
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* check_round_trip: Assembles the test program, checks the image, loads it
+*                   and checks the program and data memory and the result of
+*                   running it. Images that fail validation must leave the
+*                   loaded program in place.
+********************************************************************************/
+static void check_round_trip(void)
+{
+	uint32_t* image = 0;
+	size_t size = 0;
+	char message[128];
+
+	CHECK(assembler_assemble(source, &image, &size, message, sizeof(message)) == 0);
+	if (!image) return;
+
+	const struct program_image_header* header = (const struct program_image_header*)(image);
+	const uint32_t* code = program_image_code(header);
+	const uint16_t helper = program_image_code_address(header->vector_count);
+	const uint16_t entry = helper + 2;  /* After ADDI and RET. */
+	const uint16_t timer = entry + 13;  /* After 11 instructions, one with an extension word. */
+	const uint16_t last = timer + 2;
+
+	CHECK(header->magic == PROGRAM_IMAGE_MAGIC);
+	CHECK(header->version == PROGRAM_IMAGE_VERSION);
+	CHECK(size == program_image_size(header));
+	CHECK(header->vector_count == TIMER_COMPA_vect / 2);
+	CHECK(header->entry == entry);
+	CHECK(header->code_size == last + 1 - helper);
+	CHECK(header->data_address == 0x40);
+	CHECK(header->data_size == 3);
+	CHECK(program_image_vectors(header)[TIMER_COMPA_vect / 2 - 1] == timer);
+	CHECK(program_image_vectors(header)[PCINT_vect / 2 - 1] == PROGRAM_IMAGE_NO_VECTOR);
+
+	/* Encodings of the first instructions at the entry, with the extension word. */
+	CHECK(code[2] == ASSEMBLE_EXTENDED(LDI, R16));
+	CHECK(code[3] == 0x12345678);
+	CHECK(code[4] == ASSEMBLE(LDI, R17, last));
+	CHECK(code[5] == ASSEMBLE(LDS, R18, 0x41));
+	CHECK(code[6] == ASSEMBLE(CALL, helper, 0x00));
+	CHECK(code[timer - helper] == ASSEMBLE(INC, R3, 0x00));
+
+	cpu_context_init(&context, &program_memory, 0);
+	CHECK(program_memory_load_image_ctx(&context, image, size) == 0);
+	control_unit_reset_ctx(&context);
+
+	CHECK(program_memory_read_ctx(&context, RESET_vect) == ASSEMBLE(JMP, entry, 0x00));
+	CHECK(program_memory_read_ctx(&context, TIMER_COMPA_vect) == ASSEMBLE(JMP, timer, 0x00));
+
+	for (uint16_t i = 0; i < header->code_size; ++i)
+	{
+		CHECK(program_memory_read_ctx(&context, helper + i) == code[i]);
+	}
+
+	CHECK(data_memory_read_ctx(&context, 0x40) == 7);
+	CHECK(data_memory_read_ctx(&context, 0x41) == 0x12345678);
+	CHECK(data_memory_read_ctx(&context, 0x42) == helper);
+
+	CHECK(control_unit_run_ctx(&context, 1000) == 1000);
+	CHECK(context.reg[R16] == 0x12345678);
+	CHECK(context.reg[R17] == last);
+	CHECK(context.reg[R18] == 0x12345678);
+	CHECK(context.reg[R5] == 1);
+	CHECK(context.reg[R3] > 0);
+
+	/* Invalid images are rejected without touching the loaded program. */
+	image[0] ^= 0x01;
+	CHECK(program_memory_load_image_ctx(&context, image, size) == 1);
+	image[0] ^= 0x01;
+	CHECK(program_memory_load_image_ctx(&context, image, size - sizeof(uint32_t)) == 1);
+	CHECK(program_memory_read_ctx(&context, RESET_vect) == ASSEMBLE(JMP, entry, 0x00));
+	CHECK(program_memory_read_ctx(&context, entry) == code[2]);
+
+	free(image);
+	return;
+}
+
+/********************************************************************************
+* check_errors: Checks that a forward reference to a constant too wide for the
+*               instruction word is reported at the next label, since the
+*               label would otherwise have been moved by the extension word,
+*               while the same constant defined first assembles fine, as
+*               does a forward reference that fits the instruction word.
+********************************************************************************/
+static void check_errors(void)
+{
+	uint32_t* image = 0;
+	size_t size = 0;
+	char message[128] = "";
+
+	CHECK(assembler_assemble("main:\n"
+	                         "\tLDI R16, WIDE\n"
+	                         "next:\n"
+	                         "\tJMP next\n"
+	                         ".equ WIDE, 0x1000\n", &image, &size, message, sizeof(message)) == 1);
+	CHECK(image == 0);
+	CHECK(strcmp(message, "line 3: forward reference too wide for instruction word before next") == 0);
+
+	CHECK(assembler_assemble(".equ WIDE, 0x1000\n"
+	                         "main:\n"
+	                         "\tLDI R16, WIDE\n"
+	                         "next:\n"
+	                         "\tJMP next\n", &image, &size, message, sizeof(message)) == 0);
+	CHECK(image != 0);
+	if (image) CHECK(((const struct program_image_header*)(image))->code_size == 3);
+	free(image);
+	image = 0;
+
+	CHECK(assembler_assemble("main:\n"
+	                         "\tLDI R16, NARROW\n"
+	                         "next:\n"
+	                         "\tJMP next\n"
+	                         ".equ NARROW, 0xFFF\n", &image, &size, message, sizeof(message)) == 0);
+	CHECK(image != 0);
+	if (image) CHECK(((const struct program_image_header*)(image))->code_size == 2);
+	free(image);
+	return;
+}
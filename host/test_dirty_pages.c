@@ -0,0 +1,113 @@
+/********************************************************************************
+* test_dirty_pages.c: Checks that every kind of data memory write marks
+*                     exactly the pages it touches as dirty, and that
+*                     data_memory_diff reports the pages that differ between
+*                     two contexts restored from the same snapshot, but not
+*                     pages written with equal content.
+*
+*                     Usage: 32bitcpu_test_dirty_pages
+********************************************************************************/
+#include "cpu_snapshot.h"
+#include "check.h"
+
+/* Static variables: */
+static struct program_memory program_memory;
+static struct cpu_context first;
+static struct cpu_context second;
+static struct cpu_snapshot snapshot;
+
+/* Static functions: */
+static bool dirty_pages_are(const struct cpu_context* context,
+                            const uint16_t* expected,
+                            const uint16_t count);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	uint16_t pages[DATA_MEMORY_PAGES];
+
+	cpu_context_init(&first, &program_memory, 0);
+	control_unit_reset_ctx(&first);
+
+#if DATA_MEMORY_DIRTY_TRACKING
+	CHECK(data_memory_dirty_pages_ctx(&first, pages) == DATA_MEMORY_PAGES); /* Everything is dirty after reset. */
+
+	/* Single writes mark their own page only. */
+	data_memory_clear_dirty_ctx(&first);
+	CHECK(dirty_pages_are(&first, 0, 0));
+	CHECK(data_memory_write_ctx(&first, 0x85, 1) == 0);
+	CHECK(data_memory_write_ctx(&first, 0x120, 2) == 0);
+	CHECK(dirty_pages_are(&first, (const uint16_t[]) { 8, 18 }, 2));
+	CHECK(data_memory_page_dirty_ctx(&first, 8) && !data_memory_page_dirty_ctx(&first, 9));
+
+	/* Writes through an I/O handler mark the I/O page. */
+	data_memory_clear_dirty_ctx(&first);
+	CHECK(data_memory_write_ctx(&first, PORTA, 0x100) == 0);
+	CHECK(dirty_pages_are(&first, (const uint16_t[]) { 0 }, 1));
+
+	/* Fills across a page boundary mark both pages. */
+	data_memory_clear_dirty_ctx(&first);
+	CHECK(data_memory_fill_ctx(&first, 0x9E, 3, 4) == 0);
+	CHECK(dirty_pages_are(&first, (const uint16_t[]) { 9, 10 }, 2));
+
+	/* Copies mark the destination but not the source. */
+	data_memory_clear_dirty_ctx(&first);
+	CHECK(data_memory_copy_ctx(&first, 0x40, 0x9E, 4) == 0);
+	CHECK(dirty_pages_are(&first, (const uint16_t[]) { 4 }, 1));
+
+	/* Rejected writes mark nothing. */
+	data_memory_clear_dirty_ctx(&first);
+	CHECK(data_memory_write_ctx(&first, DATA_MEMORY_ADDRESS_WIDTH, 1) == 1);
+	CHECK(data_memory_fill_ctx(&first, DATA_MEMORY_ADDRESS_WIDTH - 2, 1, 3) == 1);
+	CHECK(data_memory_copy_ctx(&first, 0x40, DATA_MEMORY_ADDRESS_WIDTH - 2, 3) == 1);
+	CHECK(dirty_pages_are(&first, 0, 0));
+#endif /* DATA_MEMORY_DIRTY_TRACKING */
+
+	/* Both contexts start out equal and clean, restored from the same snapshot. */
+	cpu_snapshot_save_ctx(&first, &snapshot);
+	cpu_snapshot_restore_ctx(&first, &snapshot);
+	cpu_context_init(&second, &program_memory, 0);
+	control_unit_reset_ctx(&second);
+	cpu_snapshot_restore_ctx(&second, &snapshot);
+	CHECK(data_memory_diff(&first.data_memory, &second.data_memory, pages) == 0);
+
+	/* Page 8 is written equally, pages 17 and 18 each in one context and page 4 with its old content. */
+	CHECK(data_memory_write_ctx(&first, 0x85, 7) == 0);
+	CHECK(data_memory_write_ctx(&second, 0x85, 7) == 0);
+	CHECK(data_memory_write_ctx(&first, 0x120, 5) == 0);
+	CHECK(data_memory_write_ctx(&second, 0x110, 6) == 0);
+	CHECK(data_memory_write_ctx(&second, 0x40, second.data_memory.data[0x40]) == 0);
+	CHECK(data_memory_diff(&first.data_memory, &second.data_memory, pages) == 2 && pages[0] == 17 && pages[1] == 18);
+	CHECK(data_memory_diff(&second.data_memory, &first.data_memory, pages) == 2 && pages[0] == 17 && pages[1] == 18);
+
+	/* Writing the content back makes the pages equal again. */
+	CHECK(data_memory_write_ctx(&first, 0x120, second.data_memory.data[0x120]) == 0);
+	CHECK(data_memory_write_ctx(&first, 0x110, 6) == 0);
+	CHECK(data_memory_diff(&first.data_memory, &second.data_memory, pages) == 0);
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* dirty_pages_are: Indicates if the dirty pages of specified context are
+*                  exactly the expected ones.
+*
+*                  - context : Reference to the CPU context.
+*                  - expected: The expected page numbers in ascending order.
+*                  - count   : Number of expected pages.
+********************************************************************************/
+static bool dirty_pages_are(const struct cpu_context* context,
+                            const uint16_t* expected,
+                            const uint16_t count)
+{
+	uint16_t pages[DATA_MEMORY_PAGES];
+
+	if (data_memory_dirty_pages_ctx(context, pages) != count) return false;
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		if (pages[i] != expected[i]) return false;
+	}
+	return true;
+}
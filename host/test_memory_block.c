@@ -0,0 +1,165 @@
+/********************************************************************************
+* test_memory_block.c: Checks that MEMCPY and MEMSET give the same result as
+*                      memmove and a plain fill when the block is handled in
+*                      several chunks with interrupts in between, also when
+*                      the source and destination of MEMCPY overlap in
+*                      either direction, and that blocks extending past data
+*                      memory are left untouched.
+*
+*                      Usage: 32bitcpu_test_memory_block
+********************************************************************************/
+#include "cpu_context.h"
+#include "check.h"
+#include <string.h>
+
+/* Macro definitions: */
+#define BLOCK_AREA 0x40  /* Start of the data memory area used by the blocks. */
+#define LOG_AREA   0x118 /* Lengths left logged by the interrupt, up to the end of data memory. */
+#define MAX_STEPS  1000  /* Maximum number of instructions run per block. */
+
+/********************************************************************************
+* block: A MEMCPY or MEMSET to run, with the operands of the instruction.
+********************************************************************************/
+struct block
+{
+	uint32_t op_code;     /* MEMCPY or MEMSET. */
+	uint32_t destination; /* Destination address. */
+	uint32_t operand;     /* Source address of MEMCPY or value of MEMSET. */
+	uint32_t length;      /* Number of words. */
+	bool valid;           /* Indicates if the block lies within data memory. */
+};
+
+/* Static variables: */
+static const uint32_t program[] = /* Runs the block instruction at 15, logging R21 in interrupts. */
+{
+	[0]  = ASSEMBLE(JMP, 12, 0x00),
+	[8]  = ASSEMBLE(JMP, 40, 0x00), /* SWI_vect */
+	[12] = ASSEMBLE(LDI, R16, (1 << SWIE)),
+	[13] = ASSEMBLE(OUT, ICR, R16),
+	[14] = ASSEMBLE(SEI, 0x00, 0x00),
+	[15] = ASSEMBLE(NOP, 0x00, 0x00), /* Replaced by the block instruction. */
+	[16] = ASSEMBLE(JMP, 16, 0x00),
+	[40] = ASSEMBLE(ST, R24, R21),    /* Software interrupt. */
+	[41] = ASSEMBLE(INC, R24, 0x00),
+	[42] = ASSEMBLE(RETI, 0x00, 0x00)
+};
+
+static const struct block blocks[] =
+{
+	{ MEMCPY, 0xA0, BLOCK_AREA, 90, true },             /* Disjoint. */
+	{ MEMCPY, BLOCK_AREA + 8, BLOCK_AREA, 100, true },  /* Upwards, closer than a chunk. */
+	{ MEMCPY, BLOCK_AREA, BLOCK_AREA + 8, 100, true },  /* Downwards, closer than a chunk. */
+	{ MEMCPY, BLOCK_AREA + 48, BLOCK_AREA, 150, true }, /* Upwards, further than a chunk. */
+	{ MEMCPY, BLOCK_AREA, BLOCK_AREA + 48, 150, true }, /* Downwards, further than a chunk. */
+	{ MEMCPY, BLOCK_AREA, BLOCK_AREA, 64, true },       /* Onto itself, whole chunks. */
+	{ MEMSET, 0x50, 0xDEADBEEF, 150, true },
+	{ MEMSET, BLOCK_AREA, 7, 20, true },                /* Single chunk. */
+	{ MEMCPY, 0x100, BLOCK_AREA, 100, false },          /* Past the end of data memory, */
+	{ MEMCPY, BLOCK_AREA, 0x100, 100, false },          /* although the first chunk fits. */
+	{ MEMSET, 0x100, 0, 100, false }
+};
+
+static struct program_memory program_memory;
+static struct cpu_context context;
+static uint32_t expected[DATA_MEMORY_ADDRESS_WIDTH];
+
+/* Static functions: */
+static void check_block(const struct block* block);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	for (uint16_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); ++i)
+	{
+		check_block(&blocks[i]);
+	}
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* check_block: Runs specified block on a numbered data memory area, with a
+*              software interrupt requested after every chunk that leaves
+*              words to handle, and checks the data memory, the operand
+*              registers and the lengths left when the interrupts occurred.
+*
+*              - block: Reference to the block to run.
+********************************************************************************/
+static void check_block(const struct block* block)
+{
+	const uint32_t operand = block->op_code == MEMCPY ? R22 : R23;
+	uint32_t steps = 0;
+
+	cpu_context_init(&context, &program_memory, 0);
+	control_unit_reset_ctx(&context);
+
+	for (uint16_t i = 0; i < sizeof(program) / sizeof(program[0]); ++i)
+	{
+		CHECK(program_memory_store_ctx(&context, i, i == 15 ? ASSEMBLE(block->op_code, R20, operand) : program[i]) == 0);
+	}
+
+	for (uint16_t i = BLOCK_AREA; i < LOG_AREA; ++i)
+	{
+		CHECK(data_memory_write_ctx(&context, i, 0x1000 + i) == 0);
+	}
+
+	memcpy(expected, context.data_memory.data, sizeof(expected));
+
+	if (block->valid && block->op_code == MEMCPY)
+	{
+		memmove(&expected[block->destination], &expected[block->operand], block->length * sizeof(uint32_t));
+	}
+	else if (block->valid)
+	{
+		for (uint32_t i = 0; i < block->length; ++i)
+		{
+			expected[block->destination + i] = block->operand;
+		}
+	}
+
+	context.reg[R20] = block->destination;
+	context.reg[R21] = block->length;
+	context.reg[operand] = block->operand;
+	context.reg[R24] = LOG_AREA;
+
+	while (context.pc != 16 && steps++ < MAX_STEPS)
+	{
+		CHECK(control_unit_run_ctx(&context, 1) == 1);
+
+		if (context.pc == 15 && context.reg[R21] > 0 && context.reg[R21] < block->length)
+		{
+			interrupt_request_ctx(&context, INTERRUPT_SOFTWARE); /* Taken after the next chunk. */
+		}
+	}
+
+	CHECK(context.pc == 16);
+	CHECK(memcmp(&context.data_memory.data[BLOCK_AREA], &expected[BLOCK_AREA],
+	             (LOG_AREA - BLOCK_AREA) * sizeof(uint32_t)) == 0);
+
+	if (!block->valid)
+	{
+		CHECK(context.reg[R20] == block->destination);
+		CHECK(context.reg[R21] == block->length);
+		CHECK(context.reg[operand] == block->operand);
+		CHECK(context.reg[R24] == LOG_AREA);
+		return;
+	}
+
+	const bool moved = block->op_code == MEMSET || block->destination <= block->operand;
+	CHECK(context.reg[R20] == block->destination + (moved ? block->length : 0));
+	CHECK(context.reg[R21] == 0);
+	CHECK(context.reg[operand] == block->operand + (block->op_code == MEMCPY && moved ? block->length : 0));
+
+	/* Each interrupt must have seen the length left after a whole number of chunks. */
+	const uint32_t interrupts = context.reg[R24] - LOG_AREA;
+	CHECK(interrupts == (block->length - 1) / CONTROL_UNIT_MEMORY_CHUNK); /* After every chunk but the first. */
+
+	for (uint32_t i = 0; i < interrupts; ++i)
+	{
+		const uint32_t left = context.data_memory.data[LOG_AREA + i];
+		CHECK(left < block->length);
+		CHECK(left == 0 || (block->length - left) % CONTROL_UNIT_MEMORY_CHUNK == 0);
+	}
+	return;
+}
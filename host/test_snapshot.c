@@ -0,0 +1,136 @@
+/********************************************************************************
+* test_snapshot.c: Checks that a CPU context restored from a snapshot runs
+*                  exactly as it did after the snapshot was saved, whether
+*                  only the words written since then are copied back or the
+*                  whole state is, as when the snapshot is restored into
+*                  another context for the first time.
+*
+*                  Usage: 32bitcpu_test_snapshot
+********************************************************************************/
+#include "cpu_snapshot.h"
+#include "check.h"
+#include <string.h>
+
+/* Macro definitions: */
+#define BOOT_INSTRUCTIONS 1000 /* Instructions run before the snapshot is saved. */
+#define RUN_INSTRUCTIONS  5000 /* Instructions run after the snapshot is saved or restored. */
+
+/* Static variables: */
+static const uint32_t program[] = /* Writes data memory and the stack while a timer interrupt fires. */
+{
+	[0]  = ASSEMBLE(JMP, 12, 0x00),
+	[6]  = ASSEMBLE(JMP, 32, 0x00),   /* TIMER_COMPA_vect */
+	[12] = ASSEMBLE(LDI, R16, 40),
+	[13] = ASSEMBLE(OUT, OCRA, R16),
+	[14] = ASSEMBLE(LDI, R16, (1 << CTC) | (1 << CS0)),
+	[15] = ASSEMBLE(OUT, TCCR, R16),
+	[16] = ASSEMBLE(LDI, R16, (1 << OCIEA)),
+	[17] = ASSEMBLE(OUT, ICR, R16),
+	[18] = ASSEMBLE(SEI, 0x00, 0x00),
+	[19] = ASSEMBLE(LDI, R26, 0x80),
+	[20] = ASSEMBLE(PUSH, R26, 0x00), /* Sum kept on the stack. */
+	[21] = ASSEMBLE(ADDI, R1, 7),     /* Loop: stores R1 at 0x80 - 0xBF in turn. */
+	[22] = ASSEMBLE(ST, R26, R1),
+	[23] = ASSEMBLE(INC, R26, 0x00),
+	[24] = ASSEMBLE(ANDI, R26, 0x3F),
+	[25] = ASSEMBLE(ORI, R26, 0x80),
+	[26] = ASSEMBLE(POP, R2, 0x00),
+	[27] = ASSEMBLE(ADD, R2, R1),
+	[28] = ASSEMBLE(PUSH, R2, 0x00),
+	[29] = ASSEMBLE(CALL, 31, 0x00),
+	[30] = ASSEMBLE(JMP, 21, 0x00),
+	[31] = ASSEMBLE(RET, 0x00, 0x00),
+	[32] = ASSEMBLE(INC, R3, 0x00),   /* Timer interrupt. */
+	[33] = ASSEMBLE(RETI, 0x00, 0x00)
+};
+
+static struct program_memory program_memory;
+static struct cpu_context first;
+static struct cpu_context second;
+static struct cpu_context expected;
+static struct cpu_snapshot snapshot;
+
+/* Static functions: */
+static void load(struct cpu_context* context);
+static bool same_state(const struct cpu_context* a,
+                       const struct cpu_context* b);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	load(&first);
+	CHECK(control_unit_run_ctx(&first, BOOT_INSTRUCTIONS) == BOOT_INSTRUCTIONS);
+	cpu_snapshot_save_ctx(&first, &snapshot);
+
+	CHECK(control_unit_run_ctx(&first, RUN_INSTRUCTIONS) == RUN_INSTRUCTIONS);
+	expected = first;
+	CHECK(expected.reg[R3] > 0);                    /* The timer interrupt has fired. */
+	CHECK(expected.data_memory.data[0xBF] != 0x00); /* The loop has gone around. */
+
+	/* Restores only the words written since the save, repeatedly. */
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		cpu_snapshot_restore_ctx(&first, &snapshot);
+		CHECK(first.instructions == BOOT_INSTRUCTIONS);
+		CHECK(control_unit_run_ctx(&first, RUN_INSTRUCTIONS) == RUN_INSTRUCTIONS);
+		CHECK(same_state(&first, &expected));
+	}
+
+	/* Restores everything into another context sharing the program memory. */
+	cpu_context_init(&second, &program_memory, 0);
+	control_unit_reset_ctx(&second);
+	cpu_snapshot_restore_ctx(&second, &snapshot);
+	CHECK(control_unit_run_ctx(&second, RUN_INSTRUCTIONS) == RUN_INSTRUCTIONS);
+	CHECK(same_state(&second, &expected));
+
+	/* Saving again after a restore must capture the state at that point. */
+	cpu_snapshot_restore_ctx(&first, &snapshot);
+	CHECK(control_unit_run_ctx(&first, RUN_INSTRUCTIONS / 2) == RUN_INSTRUCTIONS / 2);
+	cpu_snapshot_save_ctx(&first, &snapshot);
+	CHECK(control_unit_run_ctx(&first, RUN_INSTRUCTIONS / 2) == RUN_INSTRUCTIONS / 2);
+	CHECK(same_state(&first, &expected));
+	cpu_snapshot_restore_ctx(&second, &snapshot);
+	CHECK(control_unit_run_ctx(&second, RUN_INSTRUCTIONS / 2) == RUN_INSTRUCTIONS / 2);
+	CHECK(same_state(&second, &expected));
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* load: Initializes specified context with the shared program memory, resets
+*       it and loads the test program.
+*
+*       - context: Reference to the CPU context.
+********************************************************************************/
+static void load(struct cpu_context* context)
+{
+	cpu_context_init(context, &program_memory, 0);
+	control_unit_reset_ctx(context);
+
+	for (uint16_t i = 0; i < sizeof(program) / sizeof(program[0]); ++i)
+	{
+		CHECK(program_memory_store_ctx(context, i, program[i]) == 0);
+	}
+	return;
+}
+
+/********************************************************************************
+* same_state: Indicates if the machine state saved by a snapshot is the same
+*             in specified contexts.
+*
+*             - a: Reference to the first context.
+*             - b: Reference to the second context.
+********************************************************************************/
+static bool same_state(const struct cpu_context* a,
+                       const struct cpu_context* b)
+{
+	return a->pc == b->pc && a->sr == b->sr && a->instructions == b->instructions &&
+	       a->sleeping == b->sleeping && a->state == b->state &&
+	       a->timer.count == b->timer.count && a->timer.base == b->timer.base &&
+	       a->timer.deadline == b->timer.deadline &&
+	       a->stack.sp == b->stack.sp && a->stack.empty == b->stack.empty &&
+	       memcmp(a->reg, b->reg, sizeof(a->reg)) == 0 &&
+	       memcmp(a->stack.data, b->stack.data, sizeof(a->stack.data)) == 0 &&
+	       memcmp(a->data_memory.data, b->data_memory.data, sizeof(a->data_memory.data)) == 0;
+}
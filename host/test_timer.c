@@ -0,0 +1,243 @@
+/********************************************************************************
+* test_timer.c: Checks the deadlines calculated by the timer and that its
+*               interrupts are generated exactly when the counter reaches
+*               OCRA or wraps, whether the CPU runs one instruction at a
+*               time, a whole batch of instructions or sleeps in between.
+*
+*               Usage: 32bitcpu_test_timer
+********************************************************************************/
+#include "cpu_context.h"
+#include "check.h"
+#include <string.h>
+
+/* Macro definitions: */
+#define PRESCALER_8      (1 << CS1) /* Clock select bits for 8 instructions per tick. */
+#define COMPARE_VALUE    100        /* OCRA of the test program. */
+#define RUN_INSTRUCTIONS 2000       /* Instructions run by the test program. */
+#define MAX_ENTRIES      32         /* Maximum number of recorded interrupt entries. */
+
+/* Static variables: */
+static const uint32_t program[] = /* Counts in R1 while the timer interrupt sums TCNT in R5. */
+{
+	[0]  = ASSEMBLE(JMP, 12, 0x00),
+	[6]  = ASSEMBLE(JMP, 32, 0x00),   /* TIMER_COMPA_vect */
+	[12] = ASSEMBLE(LDI, R16, COMPARE_VALUE),
+	[13] = ASSEMBLE(OUT, OCRA, R16),
+	[14] = ASSEMBLE(LDI, R16, (1 << OCIEA)),
+	[15] = ASSEMBLE(OUT, ICR, R16),
+	[16] = ASSEMBLE(SEI, 0x00, 0x00),
+	[17] = ASSEMBLE(LDI, R16, (1 << CTC) | (1 << CS0)),
+	[18] = ASSEMBLE(OUT, TCCR, R16),
+	[19] = ASSEMBLE(INC, R1, 0x00),   /* Loop, replaced by SLEEP in the sleeping runs. */
+	[20] = ASSEMBLE(JMP, 19, 0x00),
+	[32] = ASSEMBLE(IN, R4, TCNT),    /* Timer interrupt. */
+	[33] = ASSEMBLE(ADD, R5, R4),     /* A late entry reads a later count. */
+	[34] = ASSEMBLE(INC, R3, 0x00),
+	[35] = ASSEMBLE(RETI, 0x00, 0x00)
+};
+
+static struct program_memory program_memory;
+static struct cpu_context stepped;
+static struct cpu_context batched;
+
+/* Static functions: */
+static void check_deadlines(void);
+static void check_interrupts(const uint32_t loop);
+static void load(struct cpu_context* context,
+                 const uint32_t loop);
+static void elapse(struct cpu_context* context,
+                   const uint32_t instructions);
+static uint32_t take_flags(struct cpu_context* context);
+
+/********************************************************************************
+* main: Runs the checks. Returns 0 if all checks pass, otherwise 1.
+********************************************************************************/
+int main(void)
+{
+	check_deadlines();
+	check_interrupts(ASSEMBLE(INC, R1, 0x00));
+	check_interrupts(ASSEMBLE(SLEEP, 0x00, 0x00));
+	return CHECK_RESULT();
+}
+
+/********************************************************************************
+* check_deadlines: Checks the counter, the deadline of the next event and the
+*                  raised interrupt flags through the timer registers, with
+*                  the retired instructions advanced directly.
+********************************************************************************/
+static void check_deadlines(void)
+{
+	struct cpu_context* context = &stepped;
+	cpu_context_init(context, &program_memory, 0);
+	control_unit_reset_ctx(context);
+	CHECK(context->timer.deadline == UINT64_MAX);
+	CHECK(timer_count_ctx(context) == 0);
+
+	/* Counts up to 0xFFFF with prescaler 8, matching OCRA on the way. */
+	data_memory_write_ctx(context, OCRA, 100);
+	data_memory_write_ctx(context, TCCR, PRESCALER_8);
+	CHECK(context->timer.deadline == context->instructions + 100 * 8);
+	elapse(context, 100 * 8 - 1);
+	CHECK(timer_count_ctx(context) == 99);
+	CHECK(data_memory_read_ctx(context, TCNT) == 99);
+	CHECK(take_flags(context) == 0);
+	elapse(context, 1);
+	CHECK(timer_count_ctx(context) == 100);
+	CHECK(take_flags(context) == (1 << OCFA));
+	CHECK(context->timer.deadline == context->instructions + (TIMER_TOP + 1 - 100) * 8);
+	elapse(context, (TIMER_TOP + 1 - 100) * 8);
+	CHECK(timer_count_ctx(context) == 0);
+	CHECK(take_flags(context) == (1 << TOV));
+
+	/* Whole periods are skipped in one step, raising both events. */
+	elapse(context, (3 * (TIMER_TOP + 1) + 5) * 8 + 7);
+	CHECK(timer_count_ctx(context) == 5);
+	CHECK(take_flags(context) == ((1 << OCFA) | (1 << TOV)));
+	CHECK(context->timer.deadline == context->instructions - 7 + 95 * 8);
+
+	/* Writing TCNT moves the deadline. */
+	elapse(context, 1);
+	CHECK(timer_count_ctx(context) == 6);
+	data_memory_write_ctx(context, TCNT, 98);
+	CHECK(context->timer.deadline == context->instructions + 2 * 8);
+
+	/* CTC mode clears the counter after OCRA and never overflows. */
+	data_memory_write_ctx(context, TCNT, 0);
+	data_memory_write_ctx(context, OCRA, 10);
+	data_memory_write_ctx(context, TCCR, (1 << CTC) | (1 << CS0));
+	CHECK(context->timer.deadline == context->instructions + 10);
+	elapse(context, 10);
+	CHECK(timer_count_ctx(context) == 10);
+	CHECK(take_flags(context) == (1 << OCFA));
+	elapse(context, 1);
+	CHECK(timer_count_ctx(context) == 0);
+	CHECK(take_flags(context) == 0);
+	CHECK(context->timer.deadline == context->instructions + 10);
+	elapse(context, 11 * 1000 + 3);
+	CHECK(timer_count_ctx(context) == 3);
+	CHECK(take_flags(context) == (1 << OCFA));
+
+	/* A counter above OCRA in CTC mode counts up to 0xFFFF first. */
+	data_memory_write_ctx(context, TCNT, 0xFFF0);
+	CHECK(context->timer.deadline == context->instructions + 0x10);
+	elapse(context, 0x10);
+	CHECK(timer_count_ctx(context) == 0);
+	CHECK(take_flags(context) == (1 << TOV));
+
+	/* A stopped timer keeps its count and has no deadline. */
+	elapse(context, 4);
+	data_memory_write_ctx(context, TCCR, 0);
+	CHECK(context->timer.deadline == UINT64_MAX);
+	elapse(context, 1000);
+	CHECK(timer_count_ctx(context) == 4);
+	CHECK(take_flags(context) == 0);
+	return;
+}
+
+/********************************************************************************
+* check_interrupts: Runs the test program one instruction at a time and
+*                   checks that the timer interrupt is entered exactly when
+*                   the counter reaches OCRA, every OCRA + 1 ticks. The
+*                   program is then run again in a single batch, and in
+*                   batches each up to the next interrupt entry, which must
+*                   end in the same state.
+*
+*                   - loop: The instruction run in the main loop.
+********************************************************************************/
+static void check_interrupts(const uint32_t loop)
+{
+	uint64_t entries[MAX_ENTRIES];
+	uint64_t start = 0;
+	uint16_t count = 0;
+
+	load(&stepped, loop);
+	load(&batched, loop);
+
+	for (uint32_t i = 0; i < RUN_INSTRUCTIONS; ++i)
+	{
+		CHECK(control_unit_run_ctx(&stepped, 1) == 1);
+		if (stepped.pc == 19 && start == 0) start = stepped.timer.base;
+		if (stepped.pc == TIMER_COMPA_vect && count < MAX_ENTRIES) entries[count++] = stepped.instructions;
+	}
+
+	CHECK(start > 0);
+	CHECK(count == (RUN_INSTRUCTIONS - (start + COMPARE_VALUE)) / (COMPARE_VALUE + 1) + 1);
+	CHECK(stepped.reg[R3] == count);
+	CHECK(stepped.reg[R5] == 0); /* TCNT is read before the next tick. */
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		CHECK(entries[i] == start + COMPARE_VALUE + (uint64_t)(i) * (COMPARE_VALUE + 1));
+	}
+
+	CHECK(control_unit_run_ctx(&batched, RUN_INSTRUCTIONS) == RUN_INSTRUCTIONS);
+	CHECK(batched.pc == stepped.pc);
+	CHECK(memcmp(batched.reg, stepped.reg, sizeof(batched.reg)) == 0);
+
+	load(&batched, loop);
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		const uint32_t instructions = (uint32_t)(entries[i] - batched.instructions);
+		CHECK(control_unit_run_ctx(&batched, instructions) == instructions);
+		CHECK(batched.pc == TIMER_COMPA_vect);
+	}
+
+	const uint32_t remaining = (uint32_t)(stepped.instructions - batched.instructions);
+	CHECK(control_unit_run_ctx(&batched, remaining) == remaining);
+	CHECK(batched.pc == stepped.pc);
+	CHECK(batched.instructions == stepped.instructions);
+	CHECK(batched.sleeping == stepped.sleeping);
+	CHECK(memcmp(batched.reg, stepped.reg, sizeof(batched.reg)) == 0);
+	CHECK(batched.timer.base == stepped.timer.base);
+	CHECK(batched.timer.deadline == stepped.timer.deadline);
+	return;
+}
+
+/********************************************************************************
+* load: Initializes specified context with the shared program memory, resets
+*       it and loads the test program with specified instruction in the
+*       main loop.
+*
+*       - context: Reference to the CPU context.
+*       - loop   : The instruction run in the main loop.
+********************************************************************************/
+static void load(struct cpu_context* context,
+                 const uint32_t loop)
+{
+	cpu_context_init(context, &program_memory, 0);
+	control_unit_reset_ctx(context);
+
+	for (uint16_t i = 0; i < sizeof(program) / sizeof(program[0]); ++i)
+	{
+		CHECK(program_memory_store_ctx(context, i, i == 19 ? loop : program[i]) == 0);
+	}
+	return;
+}
+
+/********************************************************************************
+* elapse: Lets specified number of instructions retire without running any
+*         and updates the timer, as the control unit does at its deadline.
+*
+*         - context     : Reference to the CPU context.
+*         - instructions: Number of instructions to let retire.
+********************************************************************************/
+static void elapse(struct cpu_context* context,
+                   const uint32_t instructions)
+{
+	context->instructions += instructions;
+	timer_sync_ctx(context);
+	return;
+}
+
+/********************************************************************************
+* take_flags: Returns the interrupt flags raised in IFR and clears them.
+*
+*             - context: Reference to the CPU context.
+********************************************************************************/
+static uint32_t take_flags(struct cpu_context* context)
+{
+	const uint32_t flags = data_memory_read_ctx(context, IFR);
+	data_memory_write_ctx(context, IFR, 0);
+	return flags;
+}
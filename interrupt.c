@@ -0,0 +1,69 @@
+/********************************************************************************
+* interrupt.c: Contains function definitions for the interrupt controller.
+********************************************************************************/
+#include "cpu_context.h"
+
+/* Static variables: */
+static const uint16_t vectors[INTERRUPT_SOURCES] = /* Vector of each interrupt source. */
+{
+	[INTERRUPT_PCINT]       = PCINT_vect,
+	[INTERRUPT_TIMER_OVF]   = TIMER_OVF_vect,
+	[INTERRUPT_TIMER_COMPA] = TIMER_COMPA_vect,
+	[INTERRUPT_SOFTWARE]    = SWI_vect,
+	[INTERRUPT_UART_RX]     = UART_RX_vect
+};
+
+/********************************************************************************
+* interrupt_update_ctx: Updates the pending interrupt requests of specified
+*                       context, i.e. the sources that are both flagged in IFR
+*                       and enabled in ICR, or none if the I flag is cleared.
+*
+*                       - context: Reference to the CPU context.
+********************************************************************************/
+void interrupt_update_ctx(struct cpu_context* context)
+{
+	if (read(context->sr, I))
+	{
+		const uint32_t mask = (1UL << INTERRUPT_SOURCES) - 1;
+		context->irq_pending = data_memory_read_ctx(context, IFR) & data_memory_read_ctx(context, ICR) & mask;
+	}
+	else
+	{
+		context->irq_pending = 0x00;
+	}
+	return;
+}
+
+/********************************************************************************
+* interrupt_request_ctx: Requests an interrupt from specified source in
+*                        specified context by setting its flag in IFR.
+*
+*                        - context: Reference to the CPU context.
+*                        - source : The requesting interrupt source.
+********************************************************************************/
+void interrupt_request_ctx(struct cpu_context* context,
+                           const enum interrupt_source source)
+{
+	data_memory_set_bit_ctx(context, IFR, source);
+	return;
+}
+
+/********************************************************************************
+* interrupt_acknowledge_ctx: Acknowledges the pending interrupt request with
+*                            highest priority in specified context by clearing
+*                            its flag in IFR and returns its vector.
+*
+*                            - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t interrupt_acknowledge_ctx(struct cpu_context* context)
+{
+	uint8_t source = 0;
+
+	while (!read(context->irq_pending, source))
+	{
+		source++;
+	}
+
+	data_memory_clear_bit_ctx(context, IFR, source);
+	return vectors[source];
+}
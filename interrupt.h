@@ -0,0 +1,81 @@
+/********************************************************************************
+* interrupt.h: Contains function declarations and definitions for the
+*              interrupt controller, which handles several interrupt sources
+*              with fixed priorities.
+*
+*              Each source has a flag bit in the interrupt flag register IFR,
+*              an enable bit in the interrupt control register ICR and a
+*              vector in the vector table at the start of program memory.
+*              A source with a lower number has higher priority. Programs
+*              that don't enable a source may use its vector for other code.
+*
+*              The flagged and enabled sources are kept in the member
+*              irq_pending of the CPU context while the I flag is set, so
+*              that the control unit only needs to test a single word for
+*              interrupt requests after each instruction. The word must be
+*              updated with interrupt_update_ctx whenever IFR, ICR or the I
+*              flag is changed, which is done automatically for writes to
+*              data memory.
+********************************************************************************/
+#ifndef INTERRUPT_H_
+#define INTERRUPT_H_
+
+/* Include directives: */
+#include "cpu.h"
+
+/********************************************************************************
+* interrupt_source: Interrupt sources in order of priority. The number of
+*                   each source is also its bit number in IFR and ICR.
+********************************************************************************/
+enum interrupt_source
+{
+	INTERRUPT_PCINT,       /* Pin change on I/O port A (PCIFA/PCIEA). */
+	INTERRUPT_TIMER_OVF,   /* Timer overflow (TOV/TOIE). */
+	INTERRUPT_TIMER_COMPA, /* Timer compare match A (OCFA/OCIEA). */
+	INTERRUPT_SOFTWARE,    /* Software interrupt (SWIF/SWIE). */
+	INTERRUPT_UART_RX,     /* UART receive complete (RXCF/RXCIE). */
+	INTERRUPT_SOURCES      /* Number of interrupt sources. */
+};
+
+/********************************************************************************
+* interrupt_update_ctx: Updates the pending interrupt requests of specified
+*                       context from IFR, ICR and the I flag.
+*
+*                       - context: Reference to the CPU context.
+********************************************************************************/
+void interrupt_update_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* interrupt_request_ctx: Requests an interrupt from specified source in
+*                        specified context by setting its flag in IFR. The
+*                        interrupt is generated after the current instruction
+*                        if the source is enabled and the I flag is set.
+*
+*                        - context: Reference to the CPU context.
+*                        - source : The requesting interrupt source.
+********************************************************************************/
+void interrupt_request_ctx(struct cpu_context* context,
+                           const enum interrupt_source source);
+
+/********************************************************************************
+* interrupt_acknowledge_ctx: Acknowledges the pending interrupt request with
+*                            highest priority in specified context by clearing
+*                            its flag in IFR and returns its vector. Must only
+*                            be called if an interrupt request is pending.
+*
+*                            - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t interrupt_acknowledge_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* interrupt_request: Requests an interrupt from specified source in the
+*                    default context, see interrupt_request_ctx.
+*
+*                    - source: The requesting interrupt source.
+********************************************************************************/
+static inline void interrupt_request(const enum interrupt_source source)
+{
+	interrupt_request_ctx(&cpu_context_default, source);
+}
+
+#endif /* INTERRUPT_H_ */
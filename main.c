@@ -2,6 +2,13 @@
 * main.c: Demonstration of an 8-bit CPU in progress, based on AVR architecture.
 ********************************************************************************/
 #include "control_unit.h"
+#ifdef BENCHMARK
+#include "benchmark.h"
+#endif
+
+/* Macro definitions: */
+#define INSTRUCTIONS_PER_RUN 1000 /* Number of instructions run per call in fast mode. */
+#define BENCHMARK_INSTRUCTIONS 10000 /* Number of instructions run per benchmark (if BENCHMARK is defined). */
 
 /********************************************************************************
 * main: Controls the program flow of an 8-bit processor by keyboard input.
@@ -9,10 +16,17 @@
 int main(void)
 {
 	control_unit_reset();
+#ifdef BENCHMARK
+	benchmark_run_all(BENCHMARK_INSTRUCTIONS); /* Measures the throughput before the program starts. */
+#endif
 	
 	while (1)
 	{
-		control_unit_run_next_state();
+#ifdef CONTROL_UNIT_CYCLE_ACCURATE
+		control_unit_run_next_state(); /* Steps through fetch, decode and execute separately. */
+#else
+		control_unit_run(INSTRUCTIONS_PER_RUN);
+#endif
 	}
 	return 0;
 }
\ No newline at end of file
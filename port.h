@@ -0,0 +1,76 @@
+/********************************************************************************
+* port.h: Contains function declarations for the port backend, which connects
+*         the 20 pins of I/O port A to the physical pins of the target.
+*
+*         Pin 0 - 7 of I/O port A are mapped to PORTD0 - PORTD7, pin 8 - 13
+*         to PORTB0 - PORTB5 and pin 14 - 19 to PORTC0 - PORTC5. The backend
+*         is selected when linking; port_avr.c drives the real I/O ports of
+*         the ATmega328P, while host/port_host.c simulates them on a host
+*         computer with input signals read from a stimulus file.
+*
+*         The backend reports when the pin input values change, so that
+*         I/O port A only needs to be read when they have actually changed.
+*         port_avr.c is notified through pin change interrupts, while
+*         host/port_host.c detects changes when the simulated pins are
+*         updated by the stimulus or by written output values.
+*
+*         Each CPU context refers to its own state of the backend through
+*         its member port, so that contexts run in parallel can be fed
+*         different input signals. The AVR backend only has one set of I/O
+*         ports and ignores the context.
+********************************************************************************/
+#ifndef PORT_H_
+#define PORT_H_
+
+/* Include directives: */
+#include "cpu.h"
+
+/********************************************************************************
+* port_reset_ctx: Clears the data direction registers and the data registers
+*                 of all I/O ports of specified context, which makes all pins
+*                 inputs without pull-up.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void port_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* port_write_ctx: Writes data direction and output values of I/O port A of
+*                 specified context to the I/O ports of the backend.
+*
+*                 - context: Reference to the CPU context.
+*                 - ddr    : Data direction of I/O port A (1 = output).
+*                 - port   : Output values (or pull-ups for inputs) of I/O port A.
+********************************************************************************/
+void port_write_ctx(struct cpu_context* context,
+                    const uint32_t ddr,
+                    const uint32_t port);
+
+/********************************************************************************
+* port_read_ctx: Returns the input values of I/O port A of specified context
+*                read from the backend.
+*
+*                - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t port_read_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* port_changed_ctx: Indicates if the input values of I/O port A of specified
+*                   context may have changed since the last call. The
+*                   indication is cleared, hence the input values should be
+*                   read with port_read_ctx after true has been returned.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+bool port_changed_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* port_idle_ctx: Waits for a pin change or a received byte while the CPU of
+*                specified context is sleeping and nothing else can wake it.
+*                Returns immediately if the backend has nothing to wait for.
+*
+*                - context: Reference to the CPU context.
+********************************************************************************/
+void port_idle_ctx(struct cpu_context* context);
+
+#endif /* PORT_H_ */
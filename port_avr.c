@@ -0,0 +1,129 @@
+/********************************************************************************
+* port_avr.c: Contains function definitions for the port backend of the
+*             ATmega328P, where I/O port A is mapped to I/O port B, C and D.
+*             Pin changes are detected by the pin change interrupts of the
+*             ATmega328P, which trigger on both input and output pins.
+********************************************************************************/
+#include "cpu_context.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+/* Static variables: */
+static volatile bool pins_changed = true; /* Set when any pin of I/O port A changes. */
+
+/********************************************************************************
+* ISR (PCINT0_vect), ISR (PCINT1_vect), ISR (PCINT2_vect): Records pin changes
+*                                                         on I/O port B, C
+*                                                         and D respectively.
+********************************************************************************/
+ISR (PCINT0_vect)
+{
+	pins_changed = true;
+}
+
+ISR (PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR (PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+
+/********************************************************************************
+* port_reset_ctx: Clears the data direction registers and the data registers
+*                 of I/O port B, C and D and enables pin change interrupts on
+*                 all pins of I/O port A. All contexts share the same ports.
+*
+*                 - context: Reference to the CPU context (unused).
+********************************************************************************/
+void port_reset_ctx(struct cpu_context* context)
+{
+	(void)context;
+	DDRB = 0;
+	DDRC = 0;
+	DDRD = 0;
+
+	PORTB = 0;
+	PORTC = 0;
+	PORTD = 0;
+
+	PCMSK0 = 0x3F;
+	PCMSK1 = 0x3F;
+	PCMSK2 = 0xFC; /* PD0 and PD1 are the USART pins. */
+	PCICR = (1 << PCIE0) | (1 << PCIE1) | (1 << PCIE2);
+	pins_changed = true;
+	sei();
+	return;
+}
+
+/********************************************************************************
+* port_write_ctx: Writes data direction and output values of I/O port A to
+*                 I/O port B, C and D.
+*
+*                 - context: Reference to the CPU context (unused).
+*                 - ddr    : Data direction of I/O port A (1 = output).
+*                 - port   : Output values (or pull-ups for inputs) of I/O port A.
+********************************************************************************/
+void port_write_ctx(struct cpu_context* context,
+                    const uint32_t ddr,
+                    const uint32_t port)
+{
+	(void)context;
+	DDRB = (uint8_t)(ddr >> 8) & 0x3F;  /* PB6 and PB7 are the crystal pins. */
+	DDRC = (uint8_t)(ddr >> 14) & 0x3F; /* PC6 is reset, PC7 doesn't exist. */
+	DDRD = (DDRD & 0x03) | ((uint8_t)(ddr) & 0xFC); /* PD0 and PD1 are the USART pins. */
+
+	PORTB = (uint8_t)(port >> 8) & 0x3F;
+	PORTC = (uint8_t)(port >> 14) & 0x3F;
+	PORTD = (PORTD & 0x03) | ((uint8_t)(port) & 0xFC);
+	return;
+}
+
+/********************************************************************************
+* port_read_ctx: Returns the input values of I/O port A read from I/O port B,
+*                C and D.
+*
+*                - context: Reference to the CPU context (unused).
+********************************************************************************/
+uint32_t port_read_ctx(const struct cpu_context* context)
+{
+	(void)context;
+	return (PIND & 0xFC) | ((uint32_t)(PINB & 0x3F) << 8) | ((uint32_t)(PINC & 0x3F) << 14);
+}
+
+/********************************************************************************
+* port_changed_ctx: Indicates if any pin of I/O port A has changed since the
+*                   last call. The indication is cleared before the pins are
+*                   read, so a change during the read is reported next time.
+*
+*                   - context: Reference to the CPU context (unused).
+********************************************************************************/
+bool port_changed_ctx(struct cpu_context* context)
+{
+	(void)context;
+	if (!pins_changed) return false;
+	pins_changed = false;
+	return true;
+}
+
+/********************************************************************************
+* port_idle_ctx: Puts the ATmega328P in idle sleep mode until an interrupt,
+*                unless a pin change is already pending or received bytes
+*                are waiting in the UART. Interrupts are disabled while both
+*                are checked, so that neither can be missed between the check
+*                and the sleep.
+*
+*                - context: Reference to the CPU context.
+********************************************************************************/
+void port_idle_ctx(struct cpu_context* context)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+
+	if (!pins_changed && !uart_ring_count(&context->uart.rx))
+	{
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+
+	sei();
+	return;
+}
@@ -0,0 +1,111 @@
+/********************************************************************************
+* program_image.h: Contains the definition of the binary program image format,
+*                  which is produced by the host assembler (see
+*                  host/assembler.h) and loaded into program memory by
+*                  program_memory_load_image_ctx.
+*
+*                  An image consists of the following sections, stored right
+*                  after each other as 32-bit words in host byte order:
+*
+*                  Header      : struct program_image_header (4 words).
+*                  Vector table: Handler address of each interrupt vector
+*                                following the reset vector, in vector
+*                                order, or PROGRAM_IMAGE_NO_VECTOR if the
+*                                interrupt has no handler.
+*                  Code        : Instruction words, loaded to program memory
+*                                right after the vector table.
+*                  Data        : Initial values of data memory, written from
+*                                the data address at every reset.
+*
+*                  The loader generates a jump to the entry address at the
+*                  reset vector and a jump to each handler at its interrupt
+*                  vector, hence the code is loaded from address
+*                  program_image_code_address(vector_count). Images must be
+*                  aligned to 4 bytes.
+********************************************************************************/
+#ifndef PROGRAM_IMAGE_H_
+#define PROGRAM_IMAGE_H_
+
+/* Include directives: */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Macro definitions: */
+#define PROGRAM_IMAGE_MAGIC     0x43423233UL /* "32BC" in little endian byte order. */
+#define PROGRAM_IMAGE_VERSION   1            /* Current version of the image format. */
+#define PROGRAM_IMAGE_VECTORS   5            /* Number of interrupt vectors after the reset vector. */
+#define PROGRAM_IMAGE_NO_VECTOR 0xFFFFFFFFUL /* Marks an interrupt vector without handler. */
+
+/********************************************************************************
+* program_image_header: Header at the start of a program image.
+********************************************************************************/
+struct program_image_header
+{
+   uint32_t magic;        /* PROGRAM_IMAGE_MAGIC. */
+   uint16_t version;      /* PROGRAM_IMAGE_VERSION. */
+   uint16_t entry;        /* Address of the first instruction run after reset. */
+   uint16_t vector_count; /* Number of entries in the vector table (0 - PROGRAM_IMAGE_VECTORS). */
+   uint16_t code_size;    /* Number of words in the code section. */
+   uint16_t data_address; /* Data memory address of the first word of the data section. */
+   uint16_t data_size;    /* Number of words in the data section. */
+};
+
+/********************************************************************************
+* program_image_code_address: Returns the program memory address of the code
+*                             section of an image with specified number of
+*                             interrupt vectors. Each vector, including the
+*                             reset vector, occupies two words.
+*
+*                             - vector_count: Number of interrupt vectors.
+********************************************************************************/
+static inline uint16_t program_image_code_address(const uint16_t vector_count)
+{
+   return 2 * (vector_count + 1);
+}
+
+/********************************************************************************
+* program_image_size: Returns the size of the image with specified header in
+*                     bytes.
+*
+*                     - header: Reference to the image header.
+********************************************************************************/
+static inline size_t program_image_size(const struct program_image_header* header)
+{
+   return sizeof(struct program_image_header) +
+          ((size_t)(header->vector_count) + header->code_size + header->data_size) * sizeof(uint32_t);
+}
+
+/********************************************************************************
+* program_image_vectors: Returns the vector table of the image with specified
+*                        header.
+*
+*                        - header: Reference to the image header.
+********************************************************************************/
+static inline const uint32_t* program_image_vectors(const struct program_image_header* header)
+{
+   return (const uint32_t*)(header + 1);
+}
+
+/********************************************************************************
+* program_image_code: Returns the code section of the image with specified
+*                     header.
+*
+*                     - header: Reference to the image header.
+********************************************************************************/
+static inline const uint32_t* program_image_code(const struct program_image_header* header)
+{
+   return program_image_vectors(header) + header->vector_count;
+}
+
+/********************************************************************************
+* program_image_data: Returns the data section of the image with specified
+*                     header.
+*
+*                     - header: Reference to the image header.
+********************************************************************************/
+static inline const uint32_t* program_image_data(const struct program_image_header* header)
+{
+   return program_image_code(header) + header->code_size;
+}
+
+#endif /* PROGRAM_IMAGE_H_ */
@@ -1,19 +1,28 @@
 /********************************************************************************
 * program_memory.c: Contains function definitions and macro definitions for
-*                   implementation of a 0.75 kB program memory, capable of
-*                   storing up to 256 24-bit instructions. Since C doesn't
-*                   support unsigned 24-bit integers (without using structs or
-*                   unions), the program memory is set to 32 bits data width,
-*                   but only 24 bits are used.
+*                   implementation of a program memory storing 32-bit
+*                   instruction words. Operands too wide for the instruction
+*                   word are stored in an extension word following the
+*                   instruction, see program_memory.h for the encoding.
+*
+*                   The program is stored as a constant table in flash, or
+*                   loaded from a program image. By default it's copied to
+*                   SRAM and predecoded when the program starts. If
+*                   PROGRAM_MEMORY_DECODE_CACHE is set, as on the AVR, each
+*                   instruction is instead predecoded when read, through a
+*                   small direct-mapped cache of predecoded instructions. If
+*                   PROGRAM_MEMORY_IN_FLASH is set, the program is also read
+*                   directly from flash or from the image.
 ********************************************************************************/
-#include "program_memory.h"
+#include "cpu_context.h"
+#include <string.h>
 
 /* Macro definitions: */
 #define main             4   /* Start address for subroutine main. */
 #define main_loop        5   /* Start address for loop in subroutine main. */
-#define setup            6   /* Start address for subroutine setup. */
-#define ISR_PCINT        15  /* Start address for subroutine ISR_PCINT. */
-#define ISR_PCINT_end    19  /* Start address for subroutine ISR_PCINT_end. */
+#define setup            7   /* Start address for subroutine setup. */
+#define ISR_PCINT        16  /* Start address for subroutine ISR_PCINT. */
+#define ISR_PCINT_end    20  /* Start address for subroutine ISR_PCINT_end. */
 
 #define LED1    PORTA8  /* LED 1 connected to pin 8 (PORTB0). */
 #define LED2    PORTA9
@@ -22,78 +31,645 @@
 #define BUTTON2 PORTA12
 #define BUTTON3 PORTA13 /* Button 1 connected to pin 13 (PORTB5). */
 
+#define PROGRAM_SIZE (sizeof(program) / sizeof(program[0])) /* Number of words in the program. */
+
 /* Static functions: */
-static inline uint64_t assemble(const uint16_t op_code,
-                                const uint16_t op1,
-                                const uint32_t op2);
+#if !PROGRAM_MEMORY_IN_FLASH
+static void assemble(struct program_memory* self,
+                     const uint16_t address,
+                     const uint16_t op_code,
+                     const uint16_t op1,
+                     const uint32_t op2);
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+static inline uint32_t word(const struct program_memory* self,
+                            const uint16_t address);
+static inline void predecode(const struct program_memory* self,
+                             const uint16_t address,
+                             struct instruction* destination);
+static void predecode_all(struct program_memory* self);
+static inline uint16_t program_size(const struct program_memory* self);
+static bool image_valid(const struct program_image_header* header,
+                        const size_t size);
+static inline uint32_t image_word(const struct program_image_header* header,
+                                  const uint16_t address);
+#if !PROGRAM_MEMORY_IN_FLASH
+static void write_image(struct program_memory* self);
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+
+/********************************************************************************
+* program: The program in machine code, stored in flash.
+********************************************************************************/
+static const uint32_t program[] PROGMEM =
+{
+	[0]  = ASSEMBLE(JMP, main, 0x00),
+	[1]  = ASSEMBLE(NOP, 0x00, 0x00),
+	[2]  = ASSEMBLE(JMP, ISR_PCINT, 0x00),
+	[3]  = ASSEMBLE(NOP, 0x00, 0x00),
+
+	[4]  = ASSEMBLE(CALL, setup, 0x00),
+	[5]  = ASSEMBLE(SLEEP, 0x00, 0x00),
+	[6]  = ASSEMBLE(JMP, main_loop, 0x00),
+
+	[7]  = ASSEMBLE(LDI, R16, (1 << LED1)),
+	[8]  = ASSEMBLE(OUT, DDRA, R16),
+	[9]  = ASSEMBLE(LDI, R17, (1 << BUTTON1)),
+	[10] = ASSEMBLE(OUT, PORTA, R17),
+	[11] = ASSEMBLE(SEI, 0x00, 0x00),
+	[12] = ASSEMBLE(LDI, R24, (1 << PCIEA)),
+	[13] = ASSEMBLE(OUT, ICR, R24),
+	[14] = ASSEMBLE(OUT, PCMSKA, R17),
+	[15] = ASSEMBLE(RET, 0x00, 0x00),
+
+	[16] = ASSEMBLE(IN, R24, PINA),
+	[17] = ASSEMBLE(ANDI, R24, (1 << BUTTON1)),
+	[18] = ASSEMBLE(BREQ, ISR_PCINT_end, 0x00),
+	[19] = ASSEMBLE(OUT, PINA, R16),
+	[20] = ASSEMBLE(RETI, 0x00, 0x00)
+};
 
 /* Static variables: */
-static uint64_t program_memory[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* 0.75 kB program memory. */
-
-/********************************************************************************
-* program_memory_write: Writes machine code to the program memory. This function
-*                       should be called once when the program starts.
-********************************************************************************/
-void program_memory_write(void)
-{
-	static bool program_memory_initialized = false;
-	if (program_memory_initialized) return;
-	
-	program_memory[0]  = assemble(JMP, main, 0x00);
-	program_memory[1]  = assemble(NOP, 0x00, 0x00);
-	program_memory[2]  = assemble(JMP, ISR_PCINT, 0x00);
-	program_memory[3]  = assemble(NOP, 0x00, 0x00);
-
-	program_memory[4]  = assemble(CALL, setup, 0x00);
-	program_memory[5]  = assemble(JMP, main_loop, 0x00);
-	
-	program_memory[6]  = assemble(LDI, R16, (1 << LED1));
-	program_memory[7]  = assemble(OUT, DDRA, R16);
-	program_memory[8]  = assemble(LDI, R17, (1 << BUTTON1));
-	program_memory[9]  = assemble(OUT, PORTA, R17);
-	program_memory[10] = assemble(SEI, 0x00, 0x00);
-	program_memory[11] = assemble(LDI, R24, (1 << PCIEA));
-	program_memory[12] = assemble(OUT, ICR, R24);
-	program_memory[13] = assemble(OUT, PCMSKA, R17);
-	program_memory[14] = assemble(RET, 0x00, 0x00);
-
-	program_memory[15] = assemble(IN, R24, PINA);
-	program_memory[16] = assemble(ANDI, R24, (1 << BUTTON1));
-	program_memory[17] = assemble(BREQ, ISR_PCINT_end, 0x00);
-	program_memory[18] = assemble(OUT, PINA, R16);
-	program_memory[19] = assemble(RETI, 0x00, 0x00);
-
-	program_memory_initialized = true;
+static const struct instruction nop = { NOP, 0x00, 0x00, 1 }; /* Returned for invalid addresses. */
+
+/********************************************************************************
+* program_memory_write_ctx: Writes machine code to the program memory of
+*                           specified context. Only the first call for each
+*                           program memory has any effect, later calls keep
+*                           the program memory as is.
+*
+*                           - context: Reference to the CPU context.
+********************************************************************************/
+void program_memory_write_ctx(struct cpu_context* context)
+{
+	if (context->program_memory->initialized) return;
+
+	program_memory_restore_ctx(context);
+	context->program_memory->initialized = true;
 	return;
 }
+
 /********************************************************************************
-* program_memory_read: Returns the instruction at specified address. If an
-*                      invalid address is specified (should be impossible as
-*                      long as the program memory address width isn't increased)
-*                      no operation (0x00) is returned.
+* program_memory_restore_ctx: Writes the machine code of the program to the
+*                             program memory of specified context, which
+*                             discards any instructions rewritten during
+*                             runtime. If a program image has been loaded,
+*                             it's read in place instead of the built-in
+*                             program and only predecoded, until an
+*                             instruction is rewritten. If instructions are
+*                             predecoded when read, the instruction caches of
+*                             the contexts are invalidated instead, since the
+*                             revision is incremented.
 *
-*                      - address: Address to instruction in program memory.
+*                             - context: Reference to the CPU context.
 ********************************************************************************/
-uint64_t program_memory_read(const uint16_t address)
+void program_memory_restore_ctx(struct cpu_context* context)
 {
+	struct program_memory* self = context->program_memory;
+
+#if PROGRAM_MEMORY_DECODE_CACHE
+	context->program_cache.hits = 0;
+	context->program_cache.misses = 0;
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+
+#if !PROGRAM_MEMORY_IN_FLASH
+	if (self->image)
+	{
+		self->rewritten = false; /* The image is read in place. */
+	}
+	else
+	{
+		for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+		{
+			self->words[i] = i < PROGRAM_SIZE ? pgm_read_dword(&program[i]) : 0x00;
+		}
+	}
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+
+	predecode_all(self);
+	return;
+}
+
+/********************************************************************************
+* program_memory_read_ctx: Returns the instruction at specified address in
+*                          program memory of specified context. If an invalid
+*                          address is specified, no operation (0x00) is
+*                          returned.
+*
+*                          - context: Reference to the CPU context.
+*                          - address: Address to instruction in program memory.
+********************************************************************************/
+uint32_t program_memory_read_ctx(const struct cpu_context* context,
+                                 const uint16_t address)
+{
+   return word(context->program_memory, address);
+}
+
+/********************************************************************************
+* program_memory_decoded_ctx: Returns the predecoded instruction at specified
+*                             address in program memory of specified context.
+*                             If an invalid address is specified, a predecoded
+*                             no operation (NOP) is returned. If instructions
+*                             are predecoded when read, the returned
+*                             instruction is only valid until another
+*                             instruction mapped to the same cache line is read.
+*
+*                             - context: Reference to the CPU context.
+*                             - address: Address to instruction in program memory.
+********************************************************************************/
+const struct instruction* program_memory_decoded_ctx(struct cpu_context* context,
+                                                     const uint16_t address)
+{
+   const struct program_memory* self = context->program_memory;
+#if PROGRAM_MEMORY_DECODE_CACHE
+   struct program_memory_cache* cache = &context->program_cache;
+   struct program_memory_cache_line* line = &cache->lines[address & (PROGRAM_MEMORY_CACHE_SIZE - 1)];
+
+   if (cache->revision != self->revision)
+   {
+      for (uint16_t i = 0; i < PROGRAM_MEMORY_CACHE_SIZE; ++i)
+      {
+         cache->lines[i].address = UINT16_MAX; /* The program has been rewritten since cached. */
+      }
+      cache->revision = self->revision;
+   }
+
+#if PROGRAM_MEMORY_IN_FLASH
+   if (address >= program_size(self))
+#else
+   if (address >= PROGRAM_MEMORY_ADDRESS_WIDTH)
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+   {
+      return &nop;
+   }
+   else if (line->address == address)
+   {
+      cache->hits++;
+      return &line->instruction;
+   }
+   else
+   {
+      cache->misses++;
+      line->address = address;
+      predecode(self, address, &line->instruction);
+      return &line->instruction;
+   }
+#else
    if (address < PROGRAM_MEMORY_ADDRESS_WIDTH)
    {
-      return program_memory[address];
+      return &self->decoded[address];
+   }
+   else
+   {
+      return &nop;
+   }
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+}
+
+/********************************************************************************
+* program_memory_store_ctx: Rewrites the instruction at specified address in
+*                           program memory of specified context and invalidates
+*                           the predecoded copy, which is decoded again from the
+*                           new machine code. The value 0 is returned after
+*                           successful write. Otherwise if an invalid address
+*                           is specified or the program is read directly from
+*                           flash, no write is done and error code 1 is
+*                           returned.
+*
+*                           - context    : Reference to the CPU context.
+*                           - address    : Address to instruction in program memory.
+*                           - instruction: The new instruction word in machine code.
+********************************************************************************/
+int program_memory_store_ctx(struct cpu_context* context,
+                             const uint16_t address,
+                             const uint32_t instruction)
+{
+#if PROGRAM_MEMORY_IN_FLASH
+   (void)context;
+   (void)address;
+   (void)instruction;
+   return 1;
+#else
+   struct program_memory* self = context->program_memory;
+
+   if (address < PROGRAM_MEMORY_ADDRESS_WIDTH)
+   {
+      if (self->image && !self->rewritten)
+      {
+         write_image(self); /* Copied on first write, since the image is read in place. */
+         self->rewritten = true;
+      }
+
+      self->words[address] = instruction;
+#if !PROGRAM_MEMORY_DECODE_CACHE
+      if (address > 0) predecode(self, address - 1, &self->decoded[address - 1]); /* The word might be an extension word. */
+      predecode(self, address, &self->decoded[address]);
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+      self->revision++;
+      return 0;
+   }
+   else
+   {
+      return 1;
+   }
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+}
+
+/********************************************************************************
+* program_memory_revision_ctx: Returns the revision of the program memory of
+*                              specified context, which is incremented every
+*                              time the program memory is written. Used to
+*                              invalidate information derived from the program,
+*                              such as the basic block cache of the control
+*                              unit.
+*
+*                              - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t program_memory_revision_ctx(const struct cpu_context* context)
+{
+   return context->program_memory->revision;
+}
+
+/********************************************************************************
+* program_memory_cache_hits_ctx: Returns the number of instructions found in
+*                                the instruction cache of specified context
+*                                since the program started. Always 0 unless
+*                                PROGRAM_MEMORY_DECODE_CACHE is set.
+*
+*                                - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t program_memory_cache_hits_ctx(const struct cpu_context* context)
+{
+#if PROGRAM_MEMORY_DECODE_CACHE
+   return context->program_cache.hits;
+#else
+   (void)context;
+   return 0;
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+}
+
+/********************************************************************************
+* program_memory_cache_misses_ctx: Returns the number of instructions read and
+*                                  decoded for specified context since the
+*                                  program started. Always 0 unless
+*                                  PROGRAM_MEMORY_DECODE_CACHE is set.
+*
+*                                  - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t program_memory_cache_misses_ctx(const struct cpu_context* context)
+{
+#if PROGRAM_MEMORY_DECODE_CACHE
+   return context->program_cache.misses;
+#else
+   (void)context;
+   return 0;
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+}
+
+/********************************************************************************
+* program_memory_load_legacy_ctx: Converts a program in the legacy format, where
+*                                 each instruction is stored as a 64-bit word
+*                                 (op_code << 48 | op1 << 32 | op2), to 32-bit
+*                                 instruction words and writes it to the
+*                                 program memory of specified context. Since
+*                                 instructions with wide operands occupy an
+*                                 extension word, the addresses of the
+*                                 following instructions are shifted and all
+*                                 jump, branch and call targets are remapped
+*                                 accordingly. The value 0 is returned after
+*                                 successful load. Otherwise if the converted
+*                                 program doesn't fit in program memory, the
+*                                 interrupt vectors would be moved or the
+*                                 program is read directly from flash, nothing
+*                                 is written and error code 1 is returned.
+*
+*                                 - context: Reference to the CPU context.
+*                                 - legacy : The program in legacy format.
+*                                 - size   : Number of instructions in the program.
+********************************************************************************/
+int program_memory_load_legacy_ctx(struct cpu_context* context,
+                                   const uint64_t* legacy,
+                                   const uint16_t size)
+{
+#if PROGRAM_MEMORY_IN_FLASH
+   (void)context;
+   (void)legacy;
+   (void)size;
+   return 1;
+#else
+   struct program_memory* self = context->program_memory;
+   uint16_t address_map[PROGRAM_MEMORY_ADDRESS_WIDTH + 1];
+   uint16_t address = 0;
+
+   if (size > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+
+   for (uint16_t i = 0; i < size; ++i)
+   {
+      address_map[i] = address;
+      address += (uint32_t)(legacy[i]) > INSTRUCTION_OP2_MAX ? 2 : 1;
+   }
+
+   address_map[size] = address;
+   if (address > PROGRAM_MEMORY_ADDRESS_WIDTH) return 1;
+   if (size > PCINT_vect && address_map[PCINT_vect] != PCINT_vect) return 1;
+
+   self->image = 0; /* The converted program replaces any loaded image. */
+
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      self->words[i] = 0x00;
+   }
+
+   for (uint16_t i = 0; i < size; ++i)
+   {
+      const uint16_t op_code = legacy[i] >> 48;
+      uint16_t op1 = legacy[i] >> 32;
+
+      if ((op_code == JMP || op_code == CALL || (op_code >= BREQ && op_code <= BRLT)) && op1 <= size)
+      {
+         op1 = address_map[op1]; /* Remaps the jump target to its converted address. */
+      }
+
+      assemble(self, address_map[i], op_code, op1, (uint32_t)(legacy[i]));
+   }
+
+   predecode_all(self);
+   return 0;
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+}
+
+/********************************************************************************
+* program_memory_load_image_ctx: Validates specified program image and loads
+*                                it into the program memory of specified
+*                                context. The image is referenced by the
+*                                program memory afterwards, hence it must be
+*                                kept as long as the program memory is used.
+*                                The image is read in place rather than copied
+*                                to program memory, until an instruction is
+*                                rewritten. If the program is read directly
+*                                from flash, it isn't predecoded either, hence
+*                                loading takes constant time regardless of the
+*                                program size. The value 0 is returned
+*                                after successful load. Otherwise if the image
+*                                is invalid or doesn't fit in program or data
+*                                memory, nothing is loaded and error code 1 is
+*                                returned.
+*
+*                                - context: Reference to the CPU context.
+*                                - image  : Reference to the image.
+*                                - size   : Size of the image in bytes.
+********************************************************************************/
+int program_memory_load_image_ctx(struct cpu_context* context,
+                                  const void* image,
+                                  const size_t size)
+{
+   struct program_memory* self = context->program_memory;
+   const struct program_image_header* header = (const struct program_image_header*)(image);
+
+   if (!image_valid(header, size)) return 1;
+
+   self->image = header;
+   self->initialized = true;
+   program_memory_restore_ctx(context);
+   return 0;
+}
+
+/********************************************************************************
+* program_memory_load_data_ctx: Writes the data section of the loaded program
+*                               image, if any, to the data memory of specified
+*                               context.
+*
+*                               - context: Reference to the CPU context.
+********************************************************************************/
+void program_memory_load_data_ctx(struct cpu_context* context)
+{
+   const struct program_image_header* header = context->program_memory->image;
+
+   if (header && header->data_size)
+   {
+      memcpy(context->data_memory.data + header->data_address, program_image_data(header),
+             header->data_size * sizeof(uint32_t));
+   }
+   return;
+}
+
+/********************************************************************************
+* word: Returns the word at specified address, either from the program memory
+*       in SRAM or directly from the program in flash or the loaded image. If
+*       an invalid address is specified, the value 0 is returned.
+*
+*       - self   : Reference to the program memory.
+*       - address: Address to the word in program memory.
+********************************************************************************/
+static inline uint32_t word(const struct program_memory* self,
+                            const uint16_t address)
+{
+#if PROGRAM_MEMORY_IN_FLASH
+   if (self->image) return image_word(self->image, address);
+   return address < PROGRAM_SIZE ? pgm_read_dword(&program[address]) : 0x00;
+#else
+   if (self->image && !self->rewritten) return image_word(self->image, address);
+   return address < PROGRAM_MEMORY_ADDRESS_WIDTH ? self->words[address] : 0x00;
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+}
+
+/********************************************************************************
+* predecode_all: Predecodes the entire program memory and increments the
+*                revision, since the program has been rewritten. If
+*                PROGRAM_MEMORY_DECODE_CACHE is set, the instructions are
+*                instead predecoded when they are read.
+*
+*                - self: Reference to the program memory.
+********************************************************************************/
+static void predecode_all(struct program_memory* self)
+{
+#if !PROGRAM_MEMORY_DECODE_CACHE
+   for (uint16_t i = 0; i < PROGRAM_MEMORY_ADDRESS_WIDTH; ++i)
+   {
+      predecode(self, i, &self->decoded[i]);
+   }
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+
+   self->revision++;
+   return;
+}
+
+/********************************************************************************
+* predecode: Splits the instruction at specified address into OP code and
+*            operands and stores the result at the referenced destination.
+*            Unknown OP codes are resolved to ILLEGAL, so that the control unit
+*            can index its handler table without checking the OP code. So are
+*            MEMCPY and MEMSET with R31 as first operand, since the length is
+*            held in the register after it. If the
+*            extension bit is set, the second operand is read from the
+*            following word.
+*
+*            - self       : Reference to the program memory.
+*            - address    : Address to instruction in program memory.
+*            - destination: Reference to the predecoded instruction.
+********************************************************************************/
+static inline void predecode(const struct program_memory* self,
+                             const uint16_t address,
+                             struct instruction* destination)
+{
+   const uint32_t instruction = word(self, address);
+   const uint8_t op_code = (instruction >> 24) & 0x7F; /* Bit 30 downto 24 consists of the OP code. */
+   destination->op_code = op_code < ILLEGAL ? op_code : ILLEGAL;
+   destination->op1 = (instruction >> 12) & 0xFFF;     /* Bit 23 downto 12 consists of the first operand. */
+
+   if ((op_code == MEMCPY || op_code == MEMSET) && destination->op1 >= CPU_REGISTER_ADDRESS_WIDTH - 1)
+   {
+      destination->op_code = ILLEGAL; /* No register left for the length. */
+   }
+
+   if (read(instruction, INSTRUCTION_EXTENDED))
+   {
+      destination->op2 = word(self, address + 1); /* Second operand in extension word. */
+      destination->size = 2;
    }
    else
    {
-      return 0x00;
+      destination->op2 = instruction & INSTRUCTION_OP2_MAX; /* Bit 11 downto 0. */
+      destination->size = 1;
    }
+   return;
 }
 
+#if !PROGRAM_MEMORY_IN_FLASH
 /********************************************************************************
-* assemble: Returns instruction assembled to machine code.
+* assemble: Writes instruction assembled to machine code to specified address.
+*           If the second operand doesn't fit in the instruction word, the
+*           extension bit is set and the operand is written to the following
+*           address, which then can't be used for another instruction.
+*
+*           - self   : Reference to the program memory.
+*           - address: Address to instruction in program memory.
+*           - op_code: OP code of the instruction.
+*           - op1    : First operand (12 bits).
+*           - op2    : Second operand.
 ********************************************************************************/
-static inline uint64_t assemble(const uint16_t op_code,
-                                const uint16_t op1,
-                                const uint32_t op2)
+static void assemble(struct program_memory* self,
+                     const uint16_t address,
+                     const uint16_t op_code,
+                     const uint16_t op1,
+                     const uint32_t op2)
 {
-	return ((uint64_t)op_code << 48) | ((uint64_t)op1 << 32) | op2;
-   //const uint32_t instruction = ((uint64_t)(op_code) << 48) | ((uint64_t)(op1) << 32) | op2;
-   //return instruction;
-}
\ No newline at end of file
+   if (op2 > INSTRUCTION_OP2_MAX)
+   {
+      self->words[address] = ASSEMBLE_EXTENDED(op_code, op1);
+      self->words[address + 1] = op2;
+   }
+   else
+   {
+      self->words[address] = ASSEMBLE(op_code, op1, op2);
+   }
+   return;
+}
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+
+/********************************************************************************
+* program_size: Returns the number of words in the program, which is the code
+*               end of the loaded image or the size of the built-in program.
+*
+*               - self: Reference to the program memory.
+********************************************************************************/
+static inline uint16_t program_size(const struct program_memory* self)
+{
+   const struct program_image_header* header = self->image;
+   return header ? program_image_code_address(header->vector_count) + header->code_size : PROGRAM_SIZE;
+}
+
+/********************************************************************************
+* image_valid: Indicates if the program image with specified header is valid
+*              and fits in program and data memory. Only the header and the
+*              vector table are checked, the code and data sections are taken
+*              as they are.
+*
+*              - header: Reference to the image header.
+*              - size  : Size of the image in bytes.
+********************************************************************************/
+static bool image_valid(const struct program_image_header* header,
+                        const size_t size)
+{
+   uint16_t code_address;
+   uint16_t code_end;
+
+   if (!header || (uintptr_t)(header) % sizeof(uint32_t) || size < sizeof(struct program_image_header)) return false;
+   if (header->magic != PROGRAM_IMAGE_MAGIC || header->version != PROGRAM_IMAGE_VERSION) return false;
+   if (header->vector_count > PROGRAM_IMAGE_VECTORS || program_image_size(header) != size) return false;
+
+   code_address = program_image_code_address(header->vector_count);
+   code_end = code_address + header->code_size;
+
+   if (header->code_size > PROGRAM_MEMORY_ADDRESS_WIDTH || code_end > PROGRAM_MEMORY_ADDRESS_WIDTH) return false;
+   if (header->entry < code_address || header->entry >= code_end) return false;
+   if (header->data_size && (header->data_address < DATA_MEMORY_IO_WIDTH ||
+       header->data_size > DATA_MEMORY_ADDRESS_WIDTH - header->data_address)) return false;
+
+   for (uint16_t i = 0; i < header->vector_count; ++i)
+   {
+      const uint32_t handler = program_image_vectors(header)[i];
+      if (handler != PROGRAM_IMAGE_NO_VECTOR && (handler < code_address || handler >= code_end)) return false;
+   }
+   return true;
+}
+
+/********************************************************************************
+* image_word: Returns the word at specified address of the program in the
+*             image with specified header. The vector table is generated, the
+*             reset vector jumps to the entry address and each interrupt
+*             vector to its handler, while vectors without handler return
+*             from the interrupt right away. The code follows the vector
+*             table. If the address is outside the program, the value 0 is
+*             returned.
+*
+*             - header : Reference to the image header.
+*             - address: Address to the word in program memory.
+********************************************************************************/
+static inline uint32_t image_word(const struct program_image_header* header,
+                                  const uint16_t address)
+{
+   const uint16_t code_address = program_image_code_address(header->vector_count);
+
+   if (address >= code_address)
+   {
+      return address - code_address < header->code_size ? program_image_code(header)[address - code_address] : 0x00;
+   }
+   else if (address % 2)
+   {
+      return ASSEMBLE(NOP, 0x00, 0x00); /* Second word of the vector. */
+   }
+   else if (address == RESET_vect)
+   {
+      return ASSEMBLE(JMP, header->entry, 0x00);
+   }
+   else
+   {
+      const uint32_t handler = program_image_vectors(header)[address / 2 - 1];
+      return handler == PROGRAM_IMAGE_NO_VECTOR ? ASSEMBLE(RETI, 0x00, 0x00) : ASSEMBLE(JMP, handler, 0x00);
+   }
+}
+
+#if !PROGRAM_MEMORY_IN_FLASH
+/********************************************************************************
+* write_image: Writes the program of the loaded image to program memory, so
+*              that it can be rewritten. The vector table is generated word
+*              by word, after which the code section is copied in one go and
+*              the remaining words are cleared.
+*
+*              - self: Reference to the program memory.
+********************************************************************************/
+static void write_image(struct program_memory* self)
+{
+   const struct program_image_header* header = self->image;
+   const uint16_t code_address = program_image_code_address(header->vector_count);
+
+   for (uint16_t i = 0; i < code_address; ++i)
+   {
+      self->words[i] = image_word(header, i);
+   }
+
+   memcpy(self->words + code_address, program_image_code(header), header->code_size * sizeof(uint32_t));
+   memset(self->words + code_address + header->code_size, 0,
+          (PROGRAM_MEMORY_ADDRESS_WIDTH - code_address - header->code_size) * sizeof(uint32_t));
+   return;
+}
+#endif /* PROGRAM_MEMORY_IN_FLASH */
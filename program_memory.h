@@ -1,35 +1,465 @@
 /********************************************************************************
 * program_memory.h: Contains function declarations and macro definitions for
-*                   implementation of a 6 kB program memory, capable of storing
-*                   up to 256 24-bit instructions. Since C doesn't support
-*                   unsigned 24-bit integers (without using structs or unions),
-*                   the program memory is set to 32 bits data width, but only
-*                   24 bits are used.
+*                   implementation of a program memory storing 32-bit
+*                   instruction words, encoded as follows:
+*
+*                   Bit 31     : Extension bit, set if op2 is stored in the
+*                                following word (extension word).
+*                   Bit 30 - 24: OP code.
+*                   Bit 23 - 12: First operand op1.
+*                   Bit 11 - 0 : Second operand op2 (0 if extended).
+*
+*                   Most instructions fit in one word, only immediates wider
+*                   than 12 bits need an extension word. Jump addresses refer
+*                   to words, hence an extension word shifts the addresses of
+*                   all following instructions.
 ********************************************************************************/
 #ifndef PROGRAM_MEMORY_H_
 #define PROGRAM_MEMORY_H_
 
 /* Include directives: */
 #include "cpu.h"
+#include "program_image.h"
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM                                               /* Constants are stored in ordinary memory. */
+#define pgm_read_dword(address) (*(const uint32_t*)(address)) /* Reads 32-bit constant. */
+#endif /* __AVR__ */
 
 /* Macro definitions: */
-#define PROGRAM_MEMORY_DATA_WIDTH    64  /* 24 bits per instruction. */
-#define PROGRAM_MEMORY_ADDRESS_WIDTH 25 /* Capacity for storage of 256 instructions. */
+/********************************************************************************
+* PROGRAM_MEMORY_IN_FLASH: Reads the program directly from flash through a
+*                          small instruction cache when set to 1, instead of
+*                          copying it to SRAM when the program starts. This
+*                          makes room for programs far larger than the SRAM,
+*                          but the program memory can't be rewritten. Loaded
+*                          program images are read in place in either mode,
+*                          which on the host lets every instance run a
+*                          memory-mapped image without copying it.
+********************************************************************************/
+#ifndef PROGRAM_MEMORY_IN_FLASH
+#define PROGRAM_MEMORY_IN_FLASH 0
+#endif
+
+/********************************************************************************
+* PROGRAM_MEMORY_DECODE_CACHE: Predecodes each instruction when it's read,
+*                              through a small instruction cache per context,
+*                              when set to 1, instead of keeping a predecoded
+*                              copy of the whole program memory. The copy
+*                              takes 8 bytes of SRAM per instruction word on
+*                              the AVR, twice the words themselves, hence the
+*                              cache is used by default on the AVR, and always
+*                              when the program is read directly from flash.
+********************************************************************************/
+#ifndef PROGRAM_MEMORY_DECODE_CACHE
+#if PROGRAM_MEMORY_IN_FLASH || defined(__AVR__)
+#define PROGRAM_MEMORY_DECODE_CACHE 1
+#else
+#define PROGRAM_MEMORY_DECODE_CACHE 0
+#endif
+#endif
+
+#if PROGRAM_MEMORY_IN_FLASH && !PROGRAM_MEMORY_DECODE_CACHE
+#error "PROGRAM_MEMORY_DECODE_CACHE must be set when PROGRAM_MEMORY_IN_FLASH is set!"
+#endif
+
+#define PROGRAM_MEMORY_DATA_WIDTH 32 /* 32 bits per instruction word. */
+
+/********************************************************************************
+* PROGRAM_MEMORY_ADDRESS_WIDTH: Number of instruction words in program memory.
+*                               Defaults to 32 words of SRAM on the AVR, which
+*                               holds the built-in program with room to spare
+*                               within the SRAM budget checked in
+*                               cpu_context.c. The host build sets it to 4096
+*                               in CMakeLists.txt, so that assembled programs
+*                               can be loaded. At most 4096, since jump
+*                               addresses are 12 bits.
+********************************************************************************/
+#ifndef PROGRAM_MEMORY_ADDRESS_WIDTH
+#if PROGRAM_MEMORY_IN_FLASH
+#define PROGRAM_MEMORY_ADDRESS_WIDTH 4096 /* Capacity for storage of 4096 instruction words. */
+#else
+#define PROGRAM_MEMORY_ADDRESS_WIDTH 32 /* Capacity for storage of 32 instruction words. */
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+#endif
+
+#if PROGRAM_MEMORY_ADDRESS_WIDTH > 4096
+#error "PROGRAM_MEMORY_ADDRESS_WIDTH must not exceed 4096!"
+#endif
+
+#if PROGRAM_MEMORY_DECODE_CACHE
+#ifdef __AVR__
+#define PROGRAM_MEMORY_CACHE_SIZE 4 /* Number of lines in the instruction cache (power of 2). */
+#else
+#define PROGRAM_MEMORY_CACHE_SIZE 8 /* Number of lines in the instruction cache (power of 2). */
+#endif /* __AVR__ */
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+
+#define INSTRUCTION_EXTENDED 31    /* Extension bit, set if op2 is stored in the next word. */
+#define INSTRUCTION_OP2_MAX  0xFFF /* Largest second operand fitting in the instruction word. */
+
+/********************************************************************************
+* ASSEMBLE: Assembles instruction to a 32-bit instruction word at compile time.
+*           The second operand must fit in the instruction word.
+*
+*           - op_code: OP code of the instruction.
+*           - op1    : First operand (12 bits).
+*           - op2    : Second operand (12 bits).
+********************************************************************************/
+#define ASSEMBLE(op_code, op1, op2) \
+   (((uint32_t)((op_code) & 0x7F) << 24) | ((uint32_t)((op1) & 0xFFF) << 12) | \
+    ((uint32_t)(op2) & INSTRUCTION_OP2_MAX))
+
+/********************************************************************************
+* ASSEMBLE_EXTENDED: Assembles instruction with the extension bit set at compile
+*                    time. The second operand must be placed in the following
+*                    word.
+*
+*                    - op_code: OP code of the instruction.
+*                    - op1    : First operand (12 bits).
+********************************************************************************/
+#define ASSEMBLE_EXTENDED(op_code, op1) \
+   (ASSEMBLE(op_code, op1, 0x00) | (1UL << INSTRUCTION_EXTENDED))
+
+/********************************************************************************
+* instruction: Predecoded instruction, holding the OP code and operands split
+*              from the machine code once when it's written to program memory,
+*              so that they don't need to be extracted every time the
+*              instruction is executed.
+********************************************************************************/
+struct instruction
+{
+   uint8_t op_code; /* OP code, for example LDI, OUT, JMP etc. */
+   uint16_t op1;    /* First operand, most often a destination. */
+   uint32_t op2;    /* Second operand, most often a value or read address. */
+   uint8_t size;    /* Number of words, 2 if the instruction has an extension word. */
+};
+
+#if PROGRAM_MEMORY_DECODE_CACHE
+/********************************************************************************
+* program_memory_cache_line: Line in the instruction cache, holding a
+*                            predecoded instruction.
+********************************************************************************/
+struct program_memory_cache_line
+{
+   uint16_t address;               /* Address of the cached instruction. */
+   struct instruction instruction; /* The predecoded instruction. */
+};
+
+/********************************************************************************
+* program_memory_cache: Instruction cache of a CPU context. Each context has
+*                       its own cache, since the cache is updated when read.
+*                       The cache is invalidated on the next read whenever
+*                       the revision of the program memory has changed, so
+*                       that a program loaded through any of the contexts
+*                       sharing the program memory is seen by all of them.
+********************************************************************************/
+struct program_memory_cache
+{
+   struct program_memory_cache_line lines[PROGRAM_MEMORY_CACHE_SIZE]; /* Direct-mapped cache lines. */
+   uint16_t revision; /* Program memory revision the cached lines were decoded from. */
+   uint32_t hits;   /* Number of instructions found in the cache. */
+   uint32_t misses; /* Number of instructions read and decoded. */
+};
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+
+/********************************************************************************
+* program_memory: Program memory referenced by one or several CPU contexts.
+*                 Since the control unit only reads the program memory, it can
+*                 be shared between contexts running in parallel, as long as
+*                 the program isn't rewritten while they run.
+********************************************************************************/
+struct program_memory
+{
+#if !PROGRAM_MEMORY_IN_FLASH
+   uint32_t words[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* Program memory in SRAM. */
+#if !PROGRAM_MEMORY_DECODE_CACHE
+   struct instruction decoded[PROGRAM_MEMORY_ADDRESS_WIDTH]; /* Predecoded program memory. */
+#endif /* PROGRAM_MEMORY_DECODE_CACHE */
+   bool rewritten; /* Indicates if the words hold a copy of the loaded image, made when it was rewritten. */
+#endif /* PROGRAM_MEMORY_IN_FLASH */
+   const struct program_image_header* image; /* Loaded program image, 0 for the built-in program. */
+   uint16_t revision; /* Incremented every time the program memory is written. */
+   bool initialized;  /* Indicates if the program has been written. */
+};
 
 /********************************************************************************
-* program_memory_write: Writes machine code to the program memory. This function
-*                       should be called once when the program starts.
+* program_memory_write_ctx: Writes machine code to the program memory of
+*                           specified context. Only the first call for each
+*                           program memory has any effect, later calls keep
+*                           the program memory as is.
+*
+*                           - context: Reference to the CPU context.
 ********************************************************************************/
-void program_memory_write(void);
+void program_memory_write_ctx(struct cpu_context* context);
 
 /********************************************************************************
-* program_memory_read: Returns the instruction at specified address. If an
-*                      invalid address is specified (should be impossible as
-*                      long as the program memory address width isn't increased)
-*                      no operation (0x00) is returned.
+* program_memory_restore_ctx: Writes the machine code of the program to the
+*                             program memory of specified context, which
+*                             discards any instructions rewritten during
+*                             runtime. If a program image has been loaded,
+*                             it's read in place instead of the built-in
+*                             program and only predecoded, until an
+*                             instruction is rewritten. If instructions are
+*                             predecoded when read, the instruction caches of
+*                             the contexts are invalidated instead.
+*
+*                             - context: Reference to the CPU context.
+********************************************************************************/
+void program_memory_restore_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* program_memory_load_image_ctx: Validates specified program image and loads
+*                                it into the program memory of specified
+*                                context, see program_image.h for the format.
+*                                The image is read in place, with the vector
+*                                table converted to jump instructions on the
+*                                fly, so only the predecoding takes time in
+*                                proportion to the program size. The program
+*                                is copied to program memory only once an
+*                                instruction is rewritten. The image is
+*                                referenced by the program memory afterwards,
+*                                since its data section is written to data
+*                                memory at every reset and its program is
+*                                read again after program_memory_restore_ctx,
+*                                hence the image must be kept as long as the
+*                                program memory is used. The value 0 is
+*                                returned after successful load. Otherwise if
+*                                the image is invalid or doesn't fit in
+*                                program or data memory, nothing is loaded and
+*                                error code 1 is returned.
+*
+*                                - context: Reference to the CPU context.
+*                                - image  : Reference to the image.
+*                                - size   : Size of the image in bytes.
+********************************************************************************/
+int program_memory_load_image_ctx(struct cpu_context* context,
+                                  const void* image,
+                                  const size_t size);
+
+/********************************************************************************
+* program_memory_load_data_ctx: Writes the data section of the loaded program
+*                               image, if any, to the data memory of specified
+*                               context. Called at reset, after the data
+*                               memory has been cleared.
+*
+*                               - context: Reference to the CPU context.
+********************************************************************************/
+void program_memory_load_data_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* program_memory_read_ctx: Returns the instruction at specified address in
+*                          program memory of specified context. If an invalid
+*                          address is specified, no operation (0x00) is
+*                          returned.
+*
+*                          - context: Reference to the CPU context.
+*                          - address: Address to instruction in program memory.
+******************************************************************************/
+uint32_t program_memory_read_ctx(const struct cpu_context* context,
+                                 const uint16_t address);
+
+/********************************************************************************
+* program_memory_decoded_ctx: Returns the predecoded instruction at specified
+*                             address in program memory of specified context.
+*                             If an invalid address is specified, a predecoded
+*                             no operation (NOP) is returned. If instructions
+*                             are predecoded when read, the returned
+*                             instruction is only valid until another
+*                             instruction mapped to the same cache line is read.
+*
+*                             - context: Reference to the CPU context.
+*                             - address: Address to instruction in program memory.
+********************************************************************************/
+const struct instruction* program_memory_decoded_ctx(struct cpu_context* context,
+                                                     const uint16_t address);
+
+/********************************************************************************
+* program_memory_store_ctx: Rewrites the instruction at specified address in
+*                           program memory of specified context and invalidates
+*                           the predecoded copy, which is decoded again from the
+*                           new machine code. The value 0 is returned after
+*                           successful write. Otherwise if an invalid address
+*                           is specified or the program is read directly from
+*                           flash, no write is done and error code 1 is
+*                           returned.
+*
+*                           - context    : Reference to the CPU context.
+*                           - address    : Address to instruction in program memory.
+*                           - instruction: The new instruction word in machine code.
+********************************************************************************/
+int program_memory_store_ctx(struct cpu_context* context,
+                             const uint16_t address,
+                             const uint32_t instruction);
+
+/********************************************************************************
+* program_memory_load_legacy_ctx: Converts a program in the legacy format, where
+*                                 each instruction is stored as a 64-bit word
+*                                 (op_code << 48 | op1 << 32 | op2), to 32-bit
+*                                 instruction words and writes it to the
+*                                 program memory of specified context. Since
+*                                 instructions with wide operands occupy an
+*                                 extension word, the addresses of the
+*                                 following instructions are shifted and all
+*                                 jump, branch and call targets are remapped
+*                                 accordingly. The value 0 is returned after
+*                                 successful load. Otherwise if the converted
+*                                 program doesn't fit in program memory, the
+*                                 interrupt vectors would be moved or the
+*                                 program is read directly from flash, nothing
+*                                 is written and error code 1 is returned.
+*
+*                                 - context: Reference to the CPU context.
+*                                 - legacy : The program in legacy format.
+*                                 - size   : Number of instructions in the program.
+********************************************************************************/
+int program_memory_load_legacy_ctx(struct cpu_context* context,
+                                   const uint64_t* legacy,
+                                   const uint16_t size);
+
+/********************************************************************************
+* program_memory_revision_ctx: Returns the revision of the program memory of
+*                              specified context, which is incremented every
+*                              time the program memory is written. Used to
+*                              invalidate information derived from the program,
+*                              such as the basic block cache of the control
+*                              unit.
+*
+*                              - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t program_memory_revision_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* program_memory_cache_hits_ctx: Returns the number of instructions found in
+*                                the instruction cache of specified context
+*                                since the program started. Always 0 unless
+*                                PROGRAM_MEMORY_DECODE_CACHE is set.
+*
+*                                - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t program_memory_cache_hits_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* program_memory_cache_misses_ctx: Returns the number of instructions read and
+*                                  decoded for specified context since the
+*                                  program started. Always 0 unless
+*                                  PROGRAM_MEMORY_DECODE_CACHE is set.
+*
+*                                  - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t program_memory_cache_misses_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* program_memory_write: Writes machine code to the program memory of the
+*                       default context. This function should be called once
+*                       when the program starts.
+********************************************************************************/
+static inline void program_memory_write(void)
+{
+   program_memory_write_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* program_memory_restore: Writes the machine code of the program to the program
+*                         memory of the default context, see
+*                         program_memory_restore_ctx.
+********************************************************************************/
+static inline void program_memory_restore(void)
+{
+   program_memory_restore_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* program_memory_read: Returns the instruction at specified address in program
+*                      memory of the default context.
 *
 *                      - address: Address to instruction in program memory.
 ******************************************************************************/
-uint64_t program_memory_read(const uint16_t address);
+static inline uint32_t program_memory_read(const uint16_t address)
+{
+   return program_memory_read_ctx(&cpu_context_default, address);
+}
+
+/********************************************************************************
+* program_memory_decoded: Returns the predecoded instruction at specified
+*                         address in program memory of the default context,
+*                         see program_memory_decoded_ctx.
+*
+*                         - address: Address to instruction in program memory.
+********************************************************************************/
+static inline const struct instruction* program_memory_decoded(const uint16_t address)
+{
+   return program_memory_decoded_ctx(&cpu_context_default, address);
+}
+
+/********************************************************************************
+* program_memory_store: Rewrites the instruction at specified address in
+*                       program memory of the default context, see
+*                       program_memory_store_ctx.
+*
+*                       - address    : Address to instruction in program memory.
+*                       - instruction: The new instruction word in machine code.
+********************************************************************************/
+static inline int program_memory_store(const uint16_t address,
+                                       const uint32_t instruction)
+{
+   return program_memory_store_ctx(&cpu_context_default, address, instruction);
+}
+
+/********************************************************************************
+* program_memory_load_legacy: Converts a program in the legacy format and
+*                             writes it to the program memory of the default
+*                             context, see program_memory_load_legacy_ctx.
+*
+*                             - legacy: The program in legacy format.
+*                             - size  : Number of instructions in the program.
+********************************************************************************/
+static inline int program_memory_load_legacy(const uint64_t* legacy,
+                                             const uint16_t size)
+{
+   return program_memory_load_legacy_ctx(&cpu_context_default, legacy, size);
+}
+
+/********************************************************************************
+* program_memory_load_image: Validates specified program image and loads it
+*                            into the program memory of the default context,
+*                            see program_memory_load_image_ctx.
+*
+*                            - image: Reference to the image.
+*                            - size : Size of the image in bytes.
+********************************************************************************/
+static inline int program_memory_load_image(const void* image,
+                                            const size_t size)
+{
+   return program_memory_load_image_ctx(&cpu_context_default, image, size);
+}
+
+/********************************************************************************
+* program_memory_revision: Returns the revision of the program memory of the
+*                          default context, see program_memory_revision_ctx.
+********************************************************************************/
+static inline uint16_t program_memory_revision(void)
+{
+   return program_memory_revision_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* program_memory_cache_hits: Returns the number of instruction cache hits of
+*                            the default context.
+********************************************************************************/
+static inline uint32_t program_memory_cache_hits(void)
+{
+   return program_memory_cache_hits_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* program_memory_cache_misses: Returns the number of instruction cache misses
+*                              of the default context.
+********************************************************************************/
+static inline uint32_t program_memory_cache_misses(void)
+{
+   return program_memory_cache_misses_ctx(&cpu_context_default);
+}
 
-#endif /* PROGRAM_MEMORY_H_ */
\ No newline at end of file
+#endif /* PROGRAM_MEMORY_H_ */
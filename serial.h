@@ -0,0 +1,38 @@
+/********************************************************************************
+* serial.h: Contains function declarations for the serial backend, which
+*           connects the UART peripheral (see uart.h) to a serial line of the
+*           target.
+*
+*           The backend is selected when linking; serial_avr.c drives the
+*           USART of the ATmega328P, while host/serial_host.c connects the
+*           UART to files or pipes on a host computer. The backend puts
+*           received bytes in the receive buffer of the UART and takes the
+*           bytes to transmit from its transmit buffer.
+*
+*           Each CPU context refers to its own state of the backend through
+*           its member serial. The AVR backend only has one USART and
+*           connects it to the context that was reset last.
+********************************************************************************/
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+/* Include directives: */
+#include "cpu.h"
+
+/********************************************************************************
+* serial_reset_ctx: Starts the serial backend of specified context. The ring
+*                   buffers of the UART must already be empty.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+void serial_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* serial_transmit_ctx: Notifies the serial backend of specified context that
+*                      a byte has been put in the transmit buffer.
+*
+*                      - context: Reference to the CPU context.
+********************************************************************************/
+void serial_transmit_ctx(struct cpu_context* context);
+
+#endif /* SERIAL_H_ */
@@ -0,0 +1,86 @@
+/********************************************************************************
+* serial_avr.c: Contains function definitions for the serial backend of the
+*               ATmega328P, where the UART is connected to USART0. Received
+*               bytes are put in the receive buffer by the receive complete
+*               interrupt, while the data register empty interrupt drains
+*               the transmit buffer and disables itself once it's empty.
+********************************************************************************/
+#include "cpu_context.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* Macro definitions: */
+#ifndef F_CPU
+#define F_CPU 16000000UL /* Clock frequency of the ATmega328P. */
+#endif
+
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 38400UL /* Baud rate of USART0, 8 data bits, no parity and 1 stop bit. */
+#endif
+
+/* Static variables: */
+static struct cpu_context* volatile serial_context; /* Context connected to USART0, 0 if none. */
+
+/********************************************************************************
+* ISR (USART_RX_vect): Puts the received byte in the receive buffer of the
+*                      connected context. The byte is dropped if the buffer
+*                      is full.
+********************************************************************************/
+ISR (USART_RX_vect)
+{
+	const uint8_t byte = UDR0;
+	if (serial_context) uart_ring_put(&serial_context->uart.rx, byte);
+}
+
+/********************************************************************************
+* ISR (USART_UDRE_vect): Writes the next byte of the transmit buffer of the
+*                        connected context to USART0, or disables the
+*                        interrupt if the buffer is empty.
+********************************************************************************/
+ISR (USART_UDRE_vect)
+{
+	uint8_t byte;
+
+	if (serial_context && uart_ring_get(&serial_context->uart.tx, &byte))
+	{
+		UDR0 = byte;
+	}
+	else
+	{
+		UCSR0B &= ~(1 << UDRIE0);
+	}
+}
+
+/********************************************************************************
+* serial_reset_ctx: Connects specified context to USART0 and starts it with
+*                   the receive complete interrupt enabled. USART0 is
+*                   stopped while the context is switched, so that no
+*                   interrupt uses a half-written reference.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+void serial_reset_ctx(struct cpu_context* context)
+{
+	UCSR0B = 0;
+	serial_context = context;
+
+	UBRR0 = (uint16_t)(F_CPU / (16 * SERIAL_BAUD) - 1);
+	UCSR0A = 0;
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+	UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+	sei();
+	return;
+}
+
+/********************************************************************************
+* serial_transmit_ctx: Enables the data register empty interrupt, which sends
+*                      the transmit buffer in the background.
+*
+*                      - context: Reference to the CPU context (unused).
+********************************************************************************/
+void serial_transmit_ctx(struct cpu_context* context)
+{
+	(void)context;
+	UCSR0B |= (1 << UDRIE0);
+	return;
+}
@@ -1,101 +1,118 @@
 /********************************************************************************
 * stack.c: Contains function definitions for implementation of 1 kB stack.
 ********************************************************************************/
-#include "stack.h"
-
-/* Static variables: */
-static uint32_t stack[STACK_ADDRESS_WIDTH]; /* 1 kB stack. */
-static uint16_t sp;      /* Stack pointer, points to last added value. */
-static bool stack_empty; /* Indicates if the stack is empty. */
+#include "cpu_context.h"
 
 /********************************************************************************
-* stack_reset: Clears content on the entire stack and sets the stack pointer
-*              to the top of the stack.
+* stack_reset_ctx: Clears content on the entire stack of specified context and
+*                  sets the stack pointer to the top of the stack.
+*
+*                  - context: Reference to the CPU context.
 ********************************************************************************/
-void stack_reset(void)
+void stack_reset_ctx(struct cpu_context* context)
 {
+   struct stack* self = &context->stack;
+
    for (uint16_t i = 0; i < STACK_ADDRESS_WIDTH; ++i)
    {
-      stack[i] = 0x00;
+      self->data[i] = 0x00;
    }
 
-   sp = STACK_ADDRESS_WIDTH - 1;
-   stack_empty = true;
+   self->sp = STACK_ADDRESS_WIDTH - 1;
+   self->empty = true;
+   self->dirty_low = 0;
    return;
 }
 
 /********************************************************************************
-* stack_push: Pushes 8 bit value to the stack, unless the stack is full.
-*             Success code 0 is returned after successful push, otherwise
-*             error code 1 is returned if the stack is already full.
+* stack_push_ctx: Pushes 32 bit value to the stack of specified context, unless
+*                 the stack is full. Success code 0 is returned after
+*                 successful push, otherwise error code 1 is returned if the
+*                 stack is already full.
 *
-*             - value: 8 bit value to push to the stack.
+*                 - context: Reference to the CPU context.
+*                 - value  : 32 bit value to push to the stack.
 ********************************************************************************/
-int stack_push(const uint32_t value)
+int stack_push_ctx(struct cpu_context* context,
+                   const uint32_t value)
 {
-   if (sp == 0)
+   struct stack* self = &context->stack;
+
+   if (self->sp == 0)
    {
       return 1;
    }
    else
    {
-      if (stack_empty)
+      if (self->empty)
       {
-         stack[sp] = value;
-         stack_empty = false;
+         self->data[self->sp] = value;
+         self->empty = false;
       }
       else
       {
-         stack[--sp] = value;
+         self->data[--self->sp] = value;
       }
+
+      if (self->sp < self->dirty_low) self->dirty_low = self->sp;
       return 0;
    }
 }
 
 /********************************************************************************
-* stack_pop: Returns 8 bit value popped from the stack. If the stack is empty,
-*            the value 0x00 is returned.
+* stack_pop_ctx: Returns 32 bit value popped from the stack of specified
+*                context. If the stack is empty, the value 0x00 is returned.
+*
+*                - context: Reference to the CPU context.
 ********************************************************************************/
-uint32_t stack_pop(void)
+uint32_t stack_pop_ctx(struct cpu_context* context)
 {
-   if (stack_empty)
+   struct stack* self = &context->stack;
+
+   if (self->empty)
    {
       return 0x00;
    }
    else
    {
-      if (sp < STACK_ADDRESS_WIDTH - 1)
+      if (self->sp < STACK_ADDRESS_WIDTH - 1)
       {
-         return stack[sp++];
+         return self->data[self->sp++];
       }
       else
       {
-         stack_empty = true;
-         return stack[sp];
+         self->empty = true;
+         return self->data[self->sp];
       }
    }
 }
 
 /********************************************************************************
-* stack_pointer: Returns the 16 bit address of the stack pointer.
+* stack_pointer_ctx: Returns the 16 bit address of the stack pointer of
+*                    specified context.
+*
+*                    - context: Reference to the CPU context.
 ********************************************************************************/
-uint16_t stack_pointer(void)
+uint16_t stack_pointer_ctx(const struct cpu_context* context)
 {
-   return sp;
+   return context->stack.sp;
 }
 
 /********************************************************************************
-* stack_last_added_value: Returns the last added value to the stack. If the
-*                         stack is empty, the value 0x00 is returned.
+* stack_last_added_value_ctx: Returns the last added value to the stack of
+*                             specified context. If the stack is empty, the
+*                             value 0x00 is returned.
+*
+*                             - context: Reference to the CPU context.
 ********************************************************************************/
-uint32_t stack_last_added_value(void)
+uint32_t stack_last_added_value_ctx(const struct cpu_context* context)
 {
-   if (stack_empty)
+   if (context->stack.empty)
    {
       return 0x00;
    }
    else
    {
-      return stack[sp];
+      return context->stack.data[context->stack.sp];
    }
-}
\ No newline at end of file
+}
@@ -9,39 +9,113 @@
 #include "cpu.h"
 
 /* Macro definitions: */
-#define STACK_ADDRESS_WIDTH 100 /* 1024 unique addresses on the stack. */
+#ifdef __AVR__
+#define STACK_ADDRESS_WIDTH 32  /* 32 unique addresses on the stack, to fit in SRAM. */
+#else
+#define STACK_ADDRESS_WIDTH 100 /* 100 unique addresses on the stack. */
+#endif /* __AVR__ */
 #define STACK_DATA_WIDTH    32    /* 32 bit storage capacity per address. */
 
 /********************************************************************************
-* stack_reset: Clears content on the entire stack and sets the stack pointer
-*              to the top of the stack.
+* stack: Stack of a CPU context.
 ********************************************************************************/
-void stack_reset(void);
+struct stack
+{
+   uint32_t data[STACK_ADDRESS_WIDTH]; /* Storage of the stack. */
+   uint16_t sp;                        /* Stack pointer, points to last added value. */
+   bool empty;                         /* Indicates if the stack is empty. */
+   uint16_t dirty_low;                 /* Lowest address written since last cleared. */
+};
 
 /********************************************************************************
-* stack_push: Pushes 8 bit value to the stack, unless the stack is full.
-*             Success code 0 is returned after successful push, otherwise
-*             error code 1 is returned if the stack is already full.
+* stack_reset_ctx: Clears content on the entire stack of specified context and
+*                  sets the stack pointer to the top of the stack.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+void stack_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* stack_push_ctx: Pushes 32 bit value to the stack of specified context, unless
+*                 the stack is full. Success code 0 is returned after
+*                 successful push, otherwise error code 1 is returned if the
+*                 stack is already full.
+* 
+*                 - context: Reference to the CPU context.
+*                 - value  : 32 bit value to push to the stack.
+********************************************************************************/
+int stack_push_ctx(struct cpu_context* context,
+                   const uint32_t value);
+
+/********************************************************************************
+* stack_pop_ctx: Returns 32 bit value popped from the stack of specified
+*                context. If the stack is empty, the value 0x00 is returned.
+*
+*                - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t stack_pop_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* stack_pointer_ctx: Returns the 16 bit address of the stack pointer of
+*                    specified context.
+*
+*                    - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t stack_pointer_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* stack_last_added_value_ctx: Returns the last added value to the stack of
+*                             specified context. If the stack is empty, the
+*                             value 0x00 is returned.
+*
+*                             - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t stack_last_added_value_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* stack_reset: Clears the stack of the default context, see stack_reset_ctx.
+********************************************************************************/
+static inline void stack_reset(void)
+{
+   stack_reset_ctx(&cpu_context_default);
+}
+
+/********************************************************************************
+* stack_push: Pushes 32 bit value to the stack of the default context, see
+*             stack_push_ctx.
 * 
-*             - value: 8 bit value to push to the stack.
+*             - value: 32 bit value to push to the stack.
 ********************************************************************************/
-int stack_push(const uint32_t value);
+static inline int stack_push(const uint32_t value)
+{
+   return stack_push_ctx(&cpu_context_default, value);
+}
 
 /********************************************************************************
-* stack_pop: Returns 8 bit value popped from the stack. If the stack is empty, 
-*            the value 0x00 is returned.
+* stack_pop: Returns 32 bit value popped from the stack of the default
+*            context, see stack_pop_ctx.
 ********************************************************************************/
-uint32_t stack_pop(void);
+static inline uint32_t stack_pop(void)
+{
+   return stack_pop_ctx(&cpu_context_default);
+}
 
 /********************************************************************************
-* stack_pointer: Returns the 16 bit address of the stack pointer.
+* stack_pointer: Returns the 16 bit address of the stack pointer of the
+*                default context.
 ********************************************************************************/
-uint16_t stack_pointer(void);
+static inline uint16_t stack_pointer(void)
+{
+   return stack_pointer_ctx(&cpu_context_default);
+}
 
 /********************************************************************************
-* stack_last_added_value: Returns the last added value to the stack. If the
-*                         stack is empty, the value 0x00 is returned.
+* stack_last_added_value: Returns the last added value to the stack of the
+*                         default context, see stack_last_added_value_ctx.
 ********************************************************************************/
-uint32_t stack_last_added_value(void);
+static inline uint32_t stack_last_added_value(void)
+{
+   return stack_last_added_value_ctx(&cpu_context_default);
+}
 
 #endif /* STACK_H_ */
\ No newline at end of file
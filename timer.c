@@ -0,0 +1,186 @@
+/********************************************************************************
+* timer.c: Contains function definitions for the timer peripheral.
+********************************************************************************/
+#include "cpu_context.h"
+
+/* Macro definitions: */
+#define TIMER_EVENT_OVF   0x01 /* The counter has wrapped from 0xFFFF. */
+#define TIMER_EVENT_COMPA 0x02 /* The counter has reached OCRA. */
+
+/* Static functions: */
+static uint16_t prescaler(const struct cpu_context* context);
+static uint16_t advance(const struct cpu_context* context,
+                        uint16_t count,
+                        uint64_t ticks,
+                        uint8_t* events);
+static uint32_t ticks_to_event(const struct cpu_context* context,
+                               const uint16_t count);
+
+/* Static variables: */
+static const uint16_t prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 }; /* Instructions per tick, 0 = stopped. */
+
+/********************************************************************************
+* timer_reset_ctx: Clears the counter of specified context. The timer is
+*                  stopped until it's started through TCCR.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+void timer_reset_ctx(struct cpu_context* context)
+{
+	context->timer.base = context->instructions;
+	context->timer.count = 0x00;
+	context->timer.deadline = UINT64_MAX;
+	return;
+}
+
+/********************************************************************************
+* timer_sync_ctx: Updates the counter of specified context to the current
+*                 number of retired instructions, requests interrupts for
+*                 all events that have occurred since the last update and
+*                 calculates the deadline of the next event. The base is
+*                 only moved by whole ticks, so that the prescaler keeps its
+*                 phase.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void timer_sync_ctx(struct cpu_context* context)
+{
+	struct timer* self = &context->timer;
+	const uint16_t instructions_per_tick = prescaler(context);
+
+	if (instructions_per_tick == 0)
+	{
+		self->base = context->instructions;
+		self->deadline = UINT64_MAX;
+	}
+	else
+	{
+		const uint64_t ticks = (context->instructions - self->base) / instructions_per_tick;
+		uint8_t events = 0;
+
+		self->count = advance(context, self->count, ticks, &events);
+		self->base += ticks * instructions_per_tick;
+		self->deadline = self->base + (uint64_t)(ticks_to_event(context, self->count)) * instructions_per_tick;
+
+		if (events & TIMER_EVENT_OVF) interrupt_request_ctx(context, INTERRUPT_TIMER_OVF);
+		if (events & TIMER_EVENT_COMPA) interrupt_request_ctx(context, INTERRUPT_TIMER_COMPA);
+	}
+	return;
+}
+
+/********************************************************************************
+* timer_write_ctx: Applies a write to specified timer register of specified
+*                  context. A new counter value is taken from TCNT, after
+*                  which the deadline is calculated with the new settings.
+*
+*                  - context: Reference to the CPU context.
+*                  - address: Address of the written timer register.
+********************************************************************************/
+void timer_write_ctx(struct cpu_context* context,
+                     const uint16_t address)
+{
+	if (address == TCNT)
+	{
+		context->timer.count = (uint16_t)(context->data_memory.data[TCNT] & TIMER_TOP);
+	}
+
+	timer_sync_ctx(context);
+	return;
+}
+
+/********************************************************************************
+* timer_count_ctx: Returns the current counter value of specified context,
+*                  calculated from the number of instructions retired since
+*                  the counter was last updated.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t timer_count_ctx(const struct cpu_context* context)
+{
+	const struct timer* self = &context->timer;
+	const uint16_t instructions_per_tick = prescaler(context);
+	uint8_t events = 0;
+
+	if (instructions_per_tick == 0) return self->count;
+	return advance(context, self->count, (context->instructions - self->base) / instructions_per_tick, &events);
+}
+
+/********************************************************************************
+* prescaler: Returns the number of retired instructions per tick selected by
+*            the clock select bits of TCCR, or 0 if the timer is stopped.
+*
+*            - context: Reference to the CPU context.
+********************************************************************************/
+static uint16_t prescaler(const struct cpu_context* context)
+{
+	return prescalers[context->data_memory.data[TCCR] & ((1 << CS0) | (1 << CS1) | (1 << CS2))];
+}
+
+/********************************************************************************
+* ticks_to_event: Returns the number of ticks until the counter next wraps or
+*                 reaches OCRA, starting from specified counter value. In CTC
+*                 mode the counter wraps after OCRA, unless it's already
+*                 above OCRA, in which case it counts up to 0xFFFF first.
+*
+*                 - context: Reference to the CPU context.
+*                 - count  : The counter value to start from.
+********************************************************************************/
+static uint32_t ticks_to_event(const struct cpu_context* context,
+                               const uint16_t count)
+{
+	const uint16_t ocra = (uint16_t)(context->data_memory.data[OCRA] & TIMER_TOP);
+	const bool ctc = read(context->data_memory.data[TCCR], CTC);
+	const uint32_t top = ctc && count <= ocra ? ocra : TIMER_TOP;
+	const uint32_t to_wrap = top - count + 1;
+	const uint32_t to_match = ocra > count ? (uint32_t)(ocra - count) : to_wrap + ocra;
+	return to_match < to_wrap ? to_match : to_wrap;
+}
+
+/********************************************************************************
+* advance: Returns the counter value reached after specified number of ticks
+*          from specified counter value and sets the events that occurred on
+*          the way. Whole counter periods are skipped in one step, since
+*          every event occurs once per period.
+*
+*          - context: Reference to the CPU context.
+*          - count  : The counter value to start from.
+*          - ticks  : Number of ticks to advance.
+*          - events : Reference to the occurred events (TIMER_EVENT_*).
+********************************************************************************/
+static uint16_t advance(const struct cpu_context* context,
+                        uint16_t count,
+                        uint64_t ticks,
+                        uint8_t* events)
+{
+	const uint16_t ocra = (uint16_t)(context->data_memory.data[OCRA] & TIMER_TOP);
+	const bool ctc = read(context->data_memory.data[TCCR], CTC);
+
+	while (ticks > 0)
+	{
+		const uint32_t top = ctc && count <= ocra ? ocra : TIMER_TOP;
+		const uint32_t to_wrap = top - count + 1;
+		const uint32_t to_match = ocra > count ? (uint32_t)(ocra - count) : to_wrap + ocra;
+		const uint32_t step = to_match < to_wrap ? to_match : to_wrap;
+
+		if (ticks < step)
+		{
+			count += (uint16_t)(ticks);
+			break;
+		}
+
+		if (step == to_match) *events |= TIMER_EVENT_COMPA;
+		if (step == to_wrap && top == TIMER_TOP) *events |= TIMER_EVENT_OVF;
+		count = step == to_wrap ? 0 : ocra;
+		ticks -= step;
+
+		const uint32_t period = (ctc ? (uint32_t)(ocra) : TIMER_TOP) + 1; /* The counter is now within the period. */
+
+		if (ticks >= period)
+		{
+			*events |= TIMER_EVENT_COMPA;
+			if (period == TIMER_TOP + 1) *events |= TIMER_EVENT_OVF;
+			ticks %= period;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,77 @@
+/********************************************************************************
+* timer.h: Contains function declarations and macro definitions for the timer
+*          peripheral, a 16-bit timer/counter clocked by retired instructions.
+*
+*          The timer is controlled through the I/O registers TCCR, TCNT and
+*          OCRA in data memory. The clock select bits CS0 - CS2 of TCCR
+*          select the prescaler (0 = stopped, 1 = 1, 2 = 8, 3 = 64, 4 = 256,
+*          5 = 1024 instructions per tick) and the CTC bit clears the counter
+*          on compare match instead of counting up to 0xFFFF. The timer
+*          requests a TIMER_OVF interrupt when the counter wraps from 0xFFFF
+*          and a TIMER_COMPA interrupt when the counter reaches OCRA.
+*
+*          The counter isn't ticked every instruction. Instead the number of
+*          retired instructions when the next event occurs is calculated in
+*          advance, hence the control unit only needs to compare the counter
+*          of retired instructions with this deadline. The counter value is
+*          calculated when TCNT is read and updated when the timer registers
+*          are written, which is done automatically for data memory accesses.
+********************************************************************************/
+#ifndef TIMER_H_
+#define TIMER_H_
+
+/* Include directives: */
+#include "cpu.h"
+
+/* Macro definitions: */
+#define TIMER_TOP 0xFFFF /* Highest counter value. */
+
+/********************************************************************************
+* timer: State of the timer peripheral of a CPU context.
+********************************************************************************/
+struct timer
+{
+	uint64_t base;     /* Retired instructions when the counter was last updated. */
+	uint64_t deadline; /* Retired instructions when the next event occurs. */
+	uint16_t count;    /* Counter value at base. */
+};
+
+/********************************************************************************
+* timer_reset_ctx: Clears the counter of specified context. The timer is
+*                  stopped until it's started through TCCR.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+void timer_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* timer_sync_ctx: Updates the counter of specified context to the current
+*                 number of retired instructions, requests interrupts for
+*                 all events that have occurred since the last update and
+*                 calculates the deadline of the next event.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void timer_sync_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* timer_write_ctx: Applies a write to specified timer register of specified
+*                  context, which has already been stored in data memory. The
+*                  timer must be synchronized with timer_sync_ctx before the
+*                  register is written, so that the counter is updated with
+*                  the previous settings.
+*
+*                  - context: Reference to the CPU context.
+*                  - address: Address of the written timer register.
+********************************************************************************/
+void timer_write_ctx(struct cpu_context* context,
+                     const uint16_t address);
+
+/********************************************************************************
+* timer_count_ctx: Returns the current counter value of specified context.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+uint16_t timer_count_ctx(const struct cpu_context* context);
+
+#endif /* TIMER_H_ */
@@ -0,0 +1,73 @@
+/********************************************************************************
+* uart.c: Contains function definitions for the UART peripheral.
+********************************************************************************/
+#include "cpu_context.h"
+
+/********************************************************************************
+* uart_reset_ctx: Empties both ring buffers of specified context. Must be
+*                 called before the serial backend is reset, since the
+*                 backend may use the buffers as soon as it's started.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void uart_reset_ctx(struct cpu_context* context)
+{
+	context->uart.rx.head = 0;
+	context->uart.rx.tail = 0;
+	context->uart.tx.head = 0;
+	context->uart.tx.tail = 0;
+	return;
+}
+
+/********************************************************************************
+* uart_status_ctx: Returns the value of the status register USR of specified
+*                  context, with RXC set while received bytes are waiting and
+*                  UDRE set while the transmit buffer has room.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t uart_status_ctx(const struct cpu_context* context)
+{
+	uint32_t status = 0x00;
+	if (uart_ring_count(&context->uart.rx)) set(status, RXC);
+	if (uart_ring_count(&context->uart.tx) < UART_BUFFER_SIZE) set(status, UDRE);
+	return status;
+}
+
+/********************************************************************************
+* uart_receive_ctx: Takes the next received byte of specified context, or
+*                   returns 0 if no byte is waiting. RXCF is cleared when the
+*                   last waiting byte has been taken, so that no interrupt is
+*                   generated for a buffer the program has already emptied.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+uint8_t uart_receive_ctx(struct cpu_context* context)
+{
+	uint8_t byte = 0x00;
+
+	uart_ring_get(&context->uart.rx, &byte);
+
+	if (!uart_ring_count(&context->uart.rx) && read(context->data_memory.data[IFR], RXCF))
+	{
+		data_memory_clear_bit_ctx(context, IFR, RXCF);
+	}
+	return byte;
+}
+
+/********************************************************************************
+* uart_transmit_ctx: Queues specified byte for transmission in specified
+*                    context and notifies the serial backend, which drains
+*                    the transmit buffer. The byte is dropped if the buffer
+*                    is full.
+*
+*                    - context: Reference to the CPU context.
+*                    - byte   : The byte to transmit.
+********************************************************************************/
+void uart_transmit_ctx(struct cpu_context* context,
+                       const uint8_t byte)
+{
+	uart_ring_put(&context->uart.tx, byte);
+	serial_transmit_ctx(context);
+	return;
+}
@@ -0,0 +1,148 @@
+/********************************************************************************
+* uart.h: Contains function declarations and definitions for the UART
+*         peripheral, a byte-oriented serial port for streaming data in and
+*         out of the program.
+*
+*         The UART is accessed through the I/O registers UDR and USR in data
+*         memory. Writing UDR queues a byte for transmission, while reading
+*         UDR takes the next received byte. USR holds the status bits RXC,
+*         which is set while received bytes are waiting, and UDRE, which is
+*         set while there's room for another byte to transmit. A UART_RX
+*         interrupt is requested while received bytes are waiting and RXCF
+*         isn't already set. Reading the last waiting byte clears RXCF.
+*
+*         Received and transmitted bytes pass through a lock-free ring
+*         buffer each, with the serial backend on the other end (see
+*         serial.h). Each buffer has a single producer and a single
+*         consumer, which only write the head and the tail respectively,
+*         so the backend can fill and drain them from an interrupt or
+*         another thread without locking.
+********************************************************************************/
+#ifndef UART_H_
+#define UART_H_
+
+/* Include directives: */
+#include "cpu.h"
+
+/********************************************************************************
+* UART_BUFFER_SIZE: Number of bytes in each ring buffer. Must be a power of 2
+*                   no greater than 128, since the indexes run freely over
+*                   the 8-bit range. Defaults to 16 on the AVR to save SRAM,
+*                   which still holds more than one byte per UART interrupt.
+*                   Can be overridden at build time.
+********************************************************************************/
+#ifndef UART_BUFFER_SIZE
+#ifdef __AVR__
+#define UART_BUFFER_SIZE 16
+#else
+#define UART_BUFFER_SIZE 64
+#endif
+#endif
+
+/********************************************************************************
+* uart_ring: Single-producer single-consumer ring buffer of bytes.
+********************************************************************************/
+struct uart_ring
+{
+	uint8_t data[UART_BUFFER_SIZE]; /* Buffered bytes. */
+	uint8_t head;                   /* Index of the next byte to put, only written by the producer. */
+	uint8_t tail;                   /* Index of the next byte to get, only written by the consumer. */
+};
+
+/********************************************************************************
+* uart: State of the UART peripheral of a CPU context.
+********************************************************************************/
+struct uart
+{
+	struct uart_ring rx; /* Received bytes, put by the serial backend and taken through UDR. */
+	struct uart_ring tx; /* Bytes to transmit, put through UDR and taken by the serial backend. */
+};
+
+/********************************************************************************
+* uart_reset_ctx: Empties both ring buffers of specified context.
+*
+*                 - context: Reference to the CPU context.
+********************************************************************************/
+void uart_reset_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* uart_status_ctx: Returns the value of the status register USR of specified
+*                  context.
+*
+*                  - context: Reference to the CPU context.
+********************************************************************************/
+uint32_t uart_status_ctx(const struct cpu_context* context);
+
+/********************************************************************************
+* uart_receive_ctx: Takes the next received byte of specified context, or
+*                   returns 0 if no byte is waiting. RXCF is cleared when the
+*                   last waiting byte has been taken.
+*
+*                   - context: Reference to the CPU context.
+********************************************************************************/
+uint8_t uart_receive_ctx(struct cpu_context* context);
+
+/********************************************************************************
+* uart_transmit_ctx: Queues specified byte for transmission in specified
+*                    context and notifies the serial backend. The byte is
+*                    dropped if the transmit buffer is full, i.e. if UDRE is
+*                    cleared.
+*
+*                    - context: Reference to the CPU context.
+*                    - byte   : The byte to transmit.
+********************************************************************************/
+void uart_transmit_ctx(struct cpu_context* context,
+                       const uint8_t byte);
+
+/********************************************************************************
+* uart_ring_count: Returns the number of bytes in specified ring buffer.
+*
+*                  - ring: Reference to the ring buffer.
+********************************************************************************/
+static inline uint8_t uart_ring_count(const struct uart_ring* ring)
+{
+	const uint8_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	return (uint8_t)(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail);
+}
+
+/********************************************************************************
+* uart_ring_put: Puts specified byte in specified ring buffer. Returns true if
+*                the byte was put, otherwise false if the buffer is full. Must
+*                only be called by the producer. The byte is stored before
+*                the head is released, so the consumer never sees it unset.
+*
+*                - ring: Reference to the ring buffer.
+*                - byte: The byte to put.
+********************************************************************************/
+static inline bool uart_ring_put(struct uart_ring* ring,
+                                 const uint8_t byte)
+{
+	const uint8_t head = ring->head;
+
+	if ((uint8_t)(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) == UART_BUFFER_SIZE) return false;
+	ring->data[head % UART_BUFFER_SIZE] = byte;
+	__atomic_store_n(&ring->head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+	return true;
+}
+
+/********************************************************************************
+* uart_ring_get: Gets the oldest byte from specified ring buffer. Returns true
+*                if a byte was stored at the referenced location, otherwise
+*                false if the buffer is empty. Must only be called by the
+*                consumer.
+*
+*                - ring: Reference to the ring buffer.
+*                - byte: Reference to the location of the byte.
+********************************************************************************/
+static inline bool uart_ring_get(struct uart_ring* ring,
+                                 uint8_t* byte)
+{
+	const uint8_t tail = ring->tail;
+
+	if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) return false;
+	*byte = ring->data[tail % UART_BUFFER_SIZE];
+	__atomic_store_n(&ring->tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+	return true;
+}
+
+#endif /* UART_H_ */